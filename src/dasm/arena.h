@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+#include "dasm/page_memory.h"
+
+namespace eagle::dasm
+{
+	/// @brief memory resource which forwards every request to an upstream resource and counts them
+	/// used underneath the analysis arena so the amount of real allocations an analysis causes can be measured
+	class counting_resource : public std::pmr::memory_resource
+	{
+	public:
+		explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+			: upstream(upstream)
+		{
+		}
+
+		/// @brief getter for the amount of allocations which reached the upstream resource
+		/// @return the allocation count
+		uint64_t allocations() const { return allocation_count; }
+
+		/// @brief getter for the total amount of bytes requested from the upstream resource
+		/// @return the byte count
+		uint64_t bytes() const { return byte_count; }
+
+	private:
+		std::pmr::memory_resource* upstream;
+
+		uint64_t allocation_count = 0;
+		uint64_t byte_count = 0;
+
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			allocation_count++;
+			byte_count += bytes;
+
+			return upstream->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override
+		{
+			upstream->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	/// @brief thread-safe memory resource which tracks the bytes currently allocated through it
+	/// shared by every analysis of a batch so admission can be limited by a global memory budget
+	class budget_resource : public std::pmr::memory_resource
+	{
+	public:
+		/// @param budget the amount of bytes the owner intends to stay below, allocations are never refused
+		/// @param upstream the resource every request is forwarded to, must be thread-safe
+		explicit budget_resource(size_t budget, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+			: budget(budget), upstream(upstream)
+		{
+		}
+
+		/// @brief getter for the budget passed on construction
+		size_t get_budget() const { return budget; }
+
+		/// @brief getter for the bytes allocated and not yet deallocated
+		size_t live_bytes() const { return live.load(std::memory_order_relaxed); }
+
+		/// @brief getter for the highest amount of live bytes seen
+		size_t peak_bytes() const { return peak.load(std::memory_order_relaxed); }
+
+		/// @brief checks if the live bytes exceed the budget
+		bool exhausted() const { return live_bytes() > budget; }
+
+	private:
+		size_t budget;
+		std::pmr::memory_resource* upstream;
+
+		std::atomic<size_t> live = 0;
+		std::atomic<size_t> peak = 0;
+
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			void* p = upstream->allocate(bytes, alignment);
+
+			const size_t now = live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+			size_t seen = peak.load(std::memory_order_relaxed);
+			while (now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed))
+			{
+			}
+
+			return p;
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override
+		{
+			upstream->deallocate(p, bytes, alignment);
+			live.fetch_sub(bytes, std::memory_order_relaxed);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	/// @brief monotonic arena owned by a single analysis, every block and instruction container of the analysis
+	/// allocates from it and all of the memory is released in one shot when the arena is released or destroyed
+	/// @note the arena is not thread safe, each thread taking part in an analysis needs its own arena
+	class analysis_arena
+	{
+	public:
+		/// @param initial_size size of the first chunk requested from the upstream resource
+		/// @param upstream the resource the arena grows from
+		explicit analysis_arena(size_t initial_size = 1 << 20,
+			std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+			: counter(upstream), monotonic(initial_size, &counter)
+		{
+		}
+
+		analysis_arena(const analysis_arena&) = delete;
+		analysis_arena& operator=(const analysis_arena&) = delete;
+
+		/// @brief getter for the resource containers of the analysis should be constructed with
+		/// @return the arena resource
+		std::pmr::memory_resource* resource() { return &monotonic; }
+
+		/// @brief releases every allocation made from the arena, all containers using it must be dead
+		void release() { monotonic.release(); }
+
+		/// @brief getter for the amount of chunks the arena had to request from upstream
+		/// @return the upstream allocation count
+		uint64_t upstream_allocations() const { return counter.allocations(); }
+
+		/// @brief getter for the amount of bytes the arena had to request from upstream
+		/// @return the upstream byte count
+		uint64_t upstream_bytes() const { return counter.bytes(); }
+
+	private:
+		counting_resource counter;
+		std::pmr::monotonic_buffer_resource monotonic;
+	};
+
+	/// @brief one analysis arena per worker thread, each backed by pages preferably placed on the numa node of the
+	/// thread which first asked for it, so blocks decoded by a thread stay on the memory closest to it
+	/// @note a slot must only be used by one thread at a time, such as the thread id passed by parallel_for
+	class node_local_arenas
+	{
+	public:
+		/// @param threads the amount of slots
+		/// @param pages the pages backing every arena
+		/// @param initial_size size of the first chunk of every arena, huge pages are only used for chunks of at least huge_page_size
+		explicit node_local_arenas(size_t threads, page_policy pages = page_policy::transparent_huge,
+			size_t initial_size = huge_page_size)
+			: pages(pages), initial_size(initial_size), slots(threads)
+		{
+		}
+
+		node_local_arenas(const node_local_arenas&) = delete;
+		node_local_arenas& operator=(const node_local_arenas&) = delete;
+
+		/// @brief getter for the arena of a slot, created on the node of the calling thread on first use
+		/// @param thread the slot
+		/// @return the arena
+		analysis_arena& arena(size_t thread)
+		{
+			std::unique_ptr<slot>& current = slots[thread];
+			if (!current)
+				current = std::make_unique<slot>(page_options { pages, current_numa_node() }, initial_size);
+
+			return current->arena;
+		}
+
+		/// @brief getter for the numa node a slot was placed on
+		/// @return the node, no_node if the slot was not used yet
+		int32_t node(size_t thread) const
+		{
+			return slots[thread] ? slots[thread]->pages.get_options().node : no_node;
+		}
+
+		/// @brief getter for the amount of slots
+		size_t size() const { return slots.size(); }
+
+		/// @brief releases the memory of every arena, all containers using them must be dead
+		void release()
+		{
+			for (std::unique_ptr<slot>& current : slots)
+			{
+				if (current)
+					current->arena.release();
+			}
+		}
+
+	private:
+		struct slot
+		{
+			page_resource pages;
+			analysis_arena arena;
+
+			slot(const page_options& options, size_t initial_size)
+				: pages(options), arena(initial_size, &pages)
+			{
+			}
+		};
+
+		page_policy pages;
+		size_t initial_size;
+		std::vector<std::unique_ptr<slot>> slots;
+	};
+}
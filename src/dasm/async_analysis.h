@@ -0,0 +1,304 @@
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <thread>
+
+#include "dasm/basic_block.h"
+#include "dasm/discovery_scheduler.h"
+#include "dasm/rva_set.h"
+#include "dasm/segment_dasm.h"
+#include "dasm/thread_pool.h"
+
+namespace eagle::dasm
+{
+	/// @brief snapshot of the counters of a running analysis
+	struct analysis_progress
+	{
+		uint64_t blocks;
+		uint64_t insts;
+		uint64_t bytes;
+		uint64_t functions;
+
+		/// @brief blocks which ran into bytes that did not decode
+		uint64_t invalid_blocks;
+
+		/// @brief rvas queued or being decoded
+		uint64_t pending;
+
+		bool finished;
+		bool cancelled;
+	};
+
+	/// @brief callbacks a running analysis streams its results through, both are invoked from pool threads
+	struct analysis_callbacks
+	{
+		/// @brief invoked with every block right after it is decoded
+		std::function<void(const basic_block&)> on_block;
+
+		/// @brief invoked once for every entry and direct call target when it is first discovered
+		std::function<void(uint32_t)> on_function;
+
+		/// @brief invoked after the result is published, the handle may already be destroyed while it runs
+		std::function<void()> on_finish;
+	};
+
+	/// @brief handle of a recursive descent running on a thread pool
+	/// the blocks are allocated from a pool owned by the handle, so the handle has to outlive the result.
+	/// destroying the handle cancels the analysis and waits for its workers, workers the thread pool dropped
+	/// without running them because it was destroyed first count as finished
+	class async_analysis
+	{
+	public:
+		/// @param pool the pool the workers are submitted to
+		/// @param data the bytes of the segment, must outlive the analysis
+		/// @param rva_begin the rva at which the first byte of the segment is mapped
+		/// @param entries the rvas discovery starts at
+		/// @param callbacks result streaming callbacks
+		/// @param resource upstream of the pool backing the blocks
+		/// @param workers amount of workers decoding in parallel, 0 uses the size of the pool
+		async_analysis(thread_pool& pool, std::span<const uint8_t> data, uint32_t rva_begin,
+			std::span<const uint32_t> entries, analysis_callbacks callbacks = {},
+			std::pmr::memory_resource* resource = std::pmr::get_default_resource(), size_t workers = 0)
+			: data(data), rva_begin(rva_begin), rva_end(rva_begin + static_cast<uint32_t>(data.size())),
+			  callbacks(std::move(callbacks)), block_resource(resource), blocks(&block_resource),
+			  discovered(rva_begin, rva_end), function_starts(rva_begin, rva_end),
+			  scheduler(discovered), result(promise.get_future().share())
+		{
+			// descent jumps around the segment, the hint is lifted by the worker publishing the result
+			advice.emplace(data, access_pattern::random, access_pattern::normal);
+
+			for (uint32_t entry : entries)
+			{
+				if (!in_segment(entry))
+					continue;
+
+				add_function(entry);
+				scheduler.push(entry, discovery_priority::entry);
+			}
+
+			if (workers == 0)
+				workers = pool.size();
+
+			running.store(workers, std::memory_order_relaxed);
+			for (size_t worker = 0; worker < workers; worker++)
+				pool.submit([ticket = std::make_shared<worker_ticket>(this)] { ticket->run(); });
+		}
+
+		async_analysis(const async_analysis&) = delete;
+		async_analysis& operator=(const async_analysis&) = delete;
+
+		~async_analysis()
+		{
+			cancel();
+			result.wait();
+
+			// the publishing worker still runs inside set_value when the future turns ready
+			while (!finished.load(std::memory_order_acquire))
+				std::this_thread::yield();
+		}
+
+		/// @brief moves an rva and the blocks its branches reach in front of everything else
+		/// requests arriving after the analysis finished are ignored
+		void request(uint32_t rva)
+		{
+			if (in_segment(rva) && !finished.load(std::memory_order_acquire))
+			{
+				scheduler.request(rva);
+				wake_workers();
+			}
+		}
+
+		/// @brief stops the workers after their current block, the result then holds what was decoded so far
+		void cancel() { stop.request_stop(); }
+
+		/// @brief getter for the current counters
+		analysis_progress progress() const
+		{
+			return {
+				block_count.load(std::memory_order_relaxed),
+				inst_count.load(std::memory_order_relaxed),
+				byte_count.load(std::memory_order_relaxed),
+				function_count.load(std::memory_order_relaxed),
+				invalid_count.load(std::memory_order_relaxed),
+				scheduler.pending(),
+				finished.load(std::memory_order_acquire),
+				stop.stop_requested(),
+			};
+		}
+
+		/// @brief getter for the future of the recovered blocks, ready once every worker stopped
+		std::shared_future<block_list> get_result() const { return result; }
+
+		/// @brief blocks until the analysis finished or was cancelled
+		void wait() const { result.wait(); }
+
+	private:
+		/// @brief a submitted worker, a task destroyed without running finishes its worker so the result is still published
+		class worker_ticket
+		{
+		public:
+			explicit worker_ticket(async_analysis* analysis)
+				: analysis(analysis)
+			{
+			}
+
+			worker_ticket(const worker_ticket&) = delete;
+			worker_ticket& operator=(const worker_ticket&) = delete;
+
+			~worker_ticket()
+			{
+				if (!ran)
+					analysis->finish_worker();
+			}
+
+			void run()
+			{
+				ran = true;
+				analysis->work();
+			}
+
+		private:
+			async_analysis* analysis;
+			bool ran = false;
+		};
+
+		std::span<const uint8_t> data;
+		uint32_t rva_begin;
+		uint32_t rva_end;
+		analysis_callbacks callbacks;
+
+		/// @brief random access hint of the segment while workers run, the segment is assumed to have normal advice before
+		std::optional<scoped_advice> advice;
+
+		std::pmr::synchronized_pool_resource block_resource;
+		std::mutex blocks_mutex;
+		block_list blocks;
+
+		rva_set discovered;
+		rva_set function_starts;
+		discovery_scheduler scheduler;
+
+		std::stop_source stop;
+		std::atomic<size_t> running = 0;
+		std::atomic<bool> finished = false;
+
+		/// @brief workers without a block to decode sleep until another worker queues successors or completes
+		std::mutex sleep_mutex;
+		std::condition_variable_any wake;
+		size_t sleeping = 0;
+
+		std::atomic<uint64_t> block_count = 0;
+		std::atomic<uint64_t> inst_count = 0;
+		std::atomic<uint64_t> byte_count = 0;
+		std::atomic<uint64_t> function_count = 0;
+		std::atomic<uint64_t> invalid_count = 0;
+
+		std::promise<block_list> promise;
+		std::shared_future<block_list> result;
+
+		bool in_segment(uint32_t rva) const { return rva >= rva_begin && rva < rva_end; }
+
+		void add_function(uint32_t rva)
+		{
+			if (!function_starts.insert(rva))
+				return;
+
+			function_count.fetch_add(1, std::memory_order_relaxed);
+			if (callbacks.on_function)
+				callbacks.on_function(rva);
+		}
+
+		/// @brief decodes until the scheduler is idle or the analysis is cancelled, the last worker out publishes the result
+		void work()
+		{
+			segment_dasm dasm(data, rva_begin);
+			dasm.set_resource(&block_resource);
+
+			const std::stop_token token = stop.get_token();
+			while (!token.stop_requested())
+			{
+				const std::optional<discovery_scheduler::item> next = scheduler.pop();
+				if (!next)
+				{
+					if (scheduler.idle())
+						break;
+
+					// another worker is decoding a block whose successors are not queued yet
+					std::unique_lock lock(sleep_mutex);
+					sleeping++;
+					wake.wait(lock, token, [&] { return scheduler.pending() != 0 || scheduler.idle(); });
+					sleeping--;
+					continue;
+				}
+
+				basic_block block = dasm.get_block(next->rva);
+				for (const call_site& call : block.calls)
+				{
+					if (call.kind == call_kind::direct && in_segment(call.target))
+						add_function(call.target);
+				}
+
+				scheduler.push_successors(block, next->priority, [&](uint32_t rva) { return in_segment(rva); });
+				dasm.prefetch_successors(block);
+
+				block_count.fetch_add(1, std::memory_order_relaxed);
+				inst_count.fetch_add(block.insts.size(), std::memory_order_relaxed);
+				byte_count.fetch_add(block.rva_end - block.rva_begin, std::memory_order_relaxed);
+				if (block.invalid())
+					invalid_count.fetch_add(1, std::memory_order_relaxed);
+
+				if (callbacks.on_block)
+					callbacks.on_block(block);
+
+				{
+					std::lock_guard lock(blocks_mutex);
+					blocks.push_back(std::move(block));
+				}
+
+				scheduler.complete();
+				wake_workers();
+			}
+
+			// pop drops stale copies without a complete, so the scheduler can turn idle without waking the sleepers
+			wake_workers();
+			finish_worker();
+		}
+
+		/// @brief wakes the sleeping workers after the scheduler changed, the lock orders the change before their next check
+		void wake_workers()
+		{
+			std::lock_guard lock(sleep_mutex);
+			if (sleeping != 0)
+				wake.notify_all();
+		}
+
+		/// @brief counts a worker as stopped, the last one publishes the result
+		void finish_worker()
+		{
+			if (running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				// nothing of the handle is touched once finished is set, so on_finish runs from a copy
+				const std::function<void()> on_finish = callbacks.on_finish;
+
+				// the caller may unmap the segment once the result is ready
+				advice.reset();
+				promise.set_value(std::move(blocks));
+				finished.store(true, std::memory_order_release);
+
+				if (on_finish)
+					on_finish();
+			}
+		}
+	};
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+
+#include <memory_resource>
+#include <vector>
+
+#include "codec/zydis_defs.h"
+#include "dasm/small_vector.h"
+
+namespace eagle::dasm
+{
+	/// @brief value of a branch slot which does not lead anywhere
+	constexpr uint32_t no_branch = 0xFFFFFFFF;
+
+	enum class call_kind : uint8_t
+	{
+		/// @brief relative call, the target is the called rva
+		direct,
+
+		/// @brief call through a rip relative pointer such as an iat or got entry, the target is the rva of the pointer
+		slot,
+
+		/// @brief call through a register or computed address, the target is unknown
+		indirect,
+	};
+
+	/// @brief outcome of decoding a single instruction, failures are reported as values so discovery never unwinds
+	enum class decode_status : uint8_t
+	{
+		ok,
+
+		/// @brief the bytes do not form an instruction
+		invalid,
+
+		/// @brief the instruction would continue past the end of the segment
+		truncated,
+
+		/// @brief the rva is not inside of the segment
+		out_of_range,
+	};
+
+	/// @brief registers an instruction reads and writes as reg_mask bits, see get_reg_mask
+	struct inst_regs
+	{
+		uint64_t use;
+		uint64_t def;
+	};
+
+	/// @brief call instruction found while decoding a block
+	struct call_site
+	{
+		uint32_t rva;
+		uint32_t target;
+		call_kind kind;
+	};
+
+	struct basic_block
+	{
+		using allocator_type = std::pmr::polymorphic_allocator<>;
+
+		uint32_t rva_begin = 0, rva_end = 0;
+		uint32_t branch_one = no_branch, branch_two = no_branch;
+
+		/// @brief why decoding stopped before a terminator, ok for complete blocks
+		decode_status status = decode_status::ok;
+
+		/// @brief set when an instruction of the block decodes from bytes another instruction stream owns
+		bool overlapping = false;
+
+		std::pmr::vector<codec::dec::inst> insts;
+
+		/// @brief calls of the block, rarely more than one so they stay inside of the block
+		small_vector<call_site, 2> calls;
+
+		/// @brief register effects of every instruction, parallel to insts, inline for blocks of up to 8 instructions
+		small_vector<inst_regs, 8> regs;
+
+		basic_block() = default;
+		basic_block(const basic_block&) = default;
+		basic_block(basic_block&&) = default;
+		basic_block& operator=(const basic_block&) = default;
+		basic_block& operator=(basic_block&&) = default;
+
+		/// @brief constructs an empty block whose containers allocate from the given allocator
+		explicit basic_block(const allocator_type& alloc)
+			: insts(alloc), calls(alloc), regs(alloc)
+		{
+		}
+
+		/// @brief allocator extended copy, used when blocks are placed into an arena backed block list
+		basic_block(const basic_block& other, const allocator_type& alloc)
+			: rva_begin(other.rva_begin), rva_end(other.rva_end),
+			  branch_one(other.branch_one), branch_two(other.branch_two), status(other.status),
+			  overlapping(other.overlapping),
+			  insts(other.insts, alloc), calls(other.calls, alloc), regs(other.regs, alloc)
+		{
+		}
+
+		/// @brief allocator extended move, used when blocks are placed into an arena backed block list
+		basic_block(basic_block&& other, const allocator_type& alloc)
+			: rva_begin(other.rva_begin), rva_end(other.rva_end),
+			  branch_one(other.branch_one), branch_two(other.branch_two), status(other.status),
+			  overlapping(other.overlapping),
+			  insts(std::move(other.insts), alloc), calls(std::move(other.calls), alloc),
+			  regs(std::move(other.regs), alloc)
+		{
+		}
+
+		allocator_type get_allocator() const { return insts.get_allocator(); }
+
+		/// @brief checks if decoding ran into bytes which are not an instruction
+		bool invalid() const { return status != decode_status::ok; }
+	};
+
+	/// @brief list of blocks recovered by an analysis, constructed over the analysis arena
+	using block_list = std::pmr::vector<basic_block>;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "dasm/arena.h"
+#include "dasm/async_analysis.h"
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/function_hash.h"
+#include "dasm/function_map.h"
+#include "dasm/thread_pool.h"
+
+namespace eagle::dasm
+{
+	/// @brief receivers for the results of one image, every function is invoked from pool threads
+	struct image_sink
+	{
+		/// @brief invoked with every block right after it is decoded
+		std::function<void(const basic_block&)> on_block;
+
+		/// @brief invoked once for every entry and direct call target when it is first discovered
+		std::function<void(uint32_t)> on_function;
+
+		/// @brief invoked for every function of the image before on_complete when batch_options::cache is set, with
+		/// the function's entry rva, its position independent hash and the stored result if the hash is cached
+		/// a receiver only analyzes functions without a stored result and passes their results to function_cache::insert
+		std::function<void(uint32_t, uint64_t, const std::optional<std::vector<uint8_t>>&)> on_function_hash;
+
+		/// @brief invoked with the recovered blocks once the image is done, the blocks are freed right after it returns
+		std::function<void(const block_list&, const analysis_progress&)> on_complete;
+	};
+
+	/// @brief an image queued for batch analysis
+	struct batch_image
+	{
+		/// @brief the bytes of the executable segment, must stay alive until on_complete returned
+		std::span<const uint8_t> data;
+
+		/// @brief the rva at which the first byte of the segment is mapped
+		uint32_t rva_begin = 0;
+
+		/// @brief the rvas discovery starts at
+		std::vector<uint32_t> entries;
+
+		/// @brief the preferred base of the image, used to blank absolute operands when functions are hashed
+		uint64_t image_base = 0;
+
+		/// @brief the size of the mapped image, 0 if absolute operands should not be blanked
+		uint32_t image_size = 0;
+
+		image_sink sink;
+	};
+
+	struct batch_options
+	{
+		/// @brief bytes all running images may use together before admission stops
+		size_t memory_budget = 4ull << 30;
+
+		/// @brief bytes reserved per byte of segment when an image is admitted, a rough upper bound for its blocks
+		size_t bytes_per_image_byte = 24;
+
+		/// @brief workers decoding one image in parallel, images themselves are the main unit of parallelism
+		size_t workers_per_image = 1;
+
+		/// @brief images running at the same time, 0 allows twice the pool size
+		size_t max_active = 0;
+
+		/// @brief results of functions seen in earlier images, consulted through image_sink::on_function_hash
+		/// functions are hashed once their image completed, so the cache spares the analyses after decoding only
+		function_cache* cache = nullptr;
+	};
+
+	/// @brief runs many images on one shared pool, submit blocks the caller while the memory budget or the
+	/// active image limit is exhausted so a producer can never queue more than the machine can hold
+	class batch_analysis
+	{
+	public:
+		explicit batch_analysis(thread_pool& pool, batch_options options = {})
+			: pool(pool), options(options), budget(options.memory_budget)
+		{
+			if (this->options.max_active == 0)
+				this->options.max_active = pool.size() * 2;
+		}
+
+		batch_analysis(const batch_analysis&) = delete;
+		batch_analysis& operator=(const batch_analysis&) = delete;
+
+		~batch_analysis()
+		{
+			wait();
+		}
+
+		/// @brief starts an image once enough budget is free, an image is always admitted when nothing else runs
+		/// @param image the image, its sink receives the results
+		void submit(batch_image image)
+		{
+			const size_t reservation = image.data.size() * options.bytes_per_image_byte;
+
+			std::unique_lock lock(mutex);
+			changed.wait(lock, [&]
+			{
+				if (active.empty())
+					return true;
+
+				return active.size() < options.max_active && reserved + reservation <= budget.get_budget() &&
+					!budget.exhausted();
+			});
+
+			reserved += reservation;
+			active.push_back(std::make_unique<active_image>());
+
+			const auto it = std::prev(active.end());
+			active_image& current = **it;
+			current.image = std::move(image);
+			current.reservation = reservation;
+
+			analysis_callbacks callbacks;
+			callbacks.on_block = current.image.sink.on_block;
+			callbacks.on_function = current.image.sink.on_function;
+
+			// the handle cannot be destroyed from its own worker, so completion is handed to a separate task
+			callbacks.on_finish = [this, it] { pool.submit([this, it] { complete(it); }); };
+
+			current.analysis = std::make_unique<async_analysis>(pool, current.image.data, current.image.rva_begin,
+				current.image.entries, std::move(callbacks), &budget, options.workers_per_image);
+		}
+
+		/// @brief blocks until every submitted image completed
+		void wait()
+		{
+			std::unique_lock lock(mutex);
+			changed.wait(lock, [&] { return active.empty(); });
+		}
+
+		/// @brief cancels every running image, their sinks receive the partial results
+		void cancel()
+		{
+			std::lock_guard lock(mutex);
+			for (const std::unique_ptr<active_image>& image : active)
+			{
+				// images already handed to complete leave an empty slot until they are erased
+				if (image && image->analysis)
+					image->analysis->cancel();
+			}
+		}
+
+		/// @brief getter for the amount of images which completed
+		uint64_t completed() const
+		{
+			std::lock_guard lock(mutex);
+			return completed_count;
+		}
+
+		/// @brief getter for the bytes the running images currently hold
+		size_t live_bytes() const { return budget.live_bytes(); }
+
+		/// @brief getter for the highest amount of bytes the images held at once
+		size_t peak_bytes() const { return budget.peak_bytes(); }
+
+	private:
+		struct active_image
+		{
+			batch_image image;
+			size_t reservation = 0;
+			std::unique_ptr<async_analysis> analysis;
+		};
+
+		using image_list = std::list<std::unique_ptr<active_image>>;
+
+		thread_pool& pool;
+		batch_options options;
+		budget_resource budget;
+
+		mutable std::mutex mutex;
+		std::condition_variable changed;
+		image_list active;
+		size_t reserved = 0;
+		uint64_t completed_count = 0;
+
+		void complete(image_list::iterator it)
+		{
+			std::unique_ptr<active_image> image;
+			{
+				// submit may still be constructing the handle when a tiny image already finished
+				std::lock_guard lock(mutex);
+				image = std::move(*it);
+			}
+
+			const analysis_progress progress = image->analysis->progress();
+			const block_list& blocks = image->analysis->get_result().get();
+			if (options.cache && image->image.sink.on_function_hash)
+				lookup_functions(image->image, blocks);
+
+			if (image->image.sink.on_complete)
+				image->image.sink.on_complete(blocks, progress);
+
+			const size_t reservation = image->reservation;
+			image.reset();
+
+			// notified under the lock, a waiting destructor may otherwise return and free this object before the call
+			std::lock_guard lock(mutex);
+			active.erase(it);
+			reserved -= reservation;
+			completed_count++;
+			changed.notify_all();
+		}
+
+		/// @brief partitions the blocks of a completed image into functions and hands each one with its cached result to the sink
+		void lookup_functions(const batch_image& image, const block_list& blocks) const
+		{
+			const block_index index(blocks);
+			const function_map functions(blocks, index, image.entries);
+			const function_hasher hasher(image.data, image.rva_begin, image.image_base, image.image_size);
+
+			// completion already runs as a pool task next to other images, the hashes are computed on this thread
+			const std::vector<uint64_t> hashes = hasher.hash_all(blocks, functions, 1);
+			for (uint32_t function = 0; function < functions.size(); function++)
+				image.sink.on_function_hash(functions.entry(function), hashes[function], options.cache->find(hashes[function]));
+		}
+	};
+}
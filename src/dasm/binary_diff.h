@@ -0,0 +1,500 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/call_graph.h"
+#include "dasm/function_map.h"
+#include "dasm/parallel.h"
+
+namespace eagle::dasm
+{
+	/// @brief one side of a diff, the referenced analysis results have to outlive the diff
+	struct diff_input
+	{
+		const block_list& blocks;
+		const block_index& index;
+		const function_map& functions;
+		const call_graph& calls;
+
+		/// @brief position independent hash of every function, as computed by function_hasher::hash_all
+		std::span<const uint64_t> hashes;
+	};
+
+	/// @brief the stage which paired two functions, earlier stages are more reliable
+	enum class match_kind : uint8_t
+	{
+		exact,
+		structural,
+		call_graph,
+		similarity,
+	};
+
+	struct function_match
+	{
+		uint32_t primary;
+		uint32_t secondary;
+		match_kind kind;
+
+		/// @brief instruction histogram similarity in [0, 1], 1 for exact matches
+		float similarity;
+	};
+
+	struct block_match
+	{
+		uint32_t primary;
+		uint32_t secondary;
+	};
+
+	struct diff_options
+	{
+		/// @brief lowest similarity the fallback stage accepts
+		float min_similarity = 0.6f;
+
+		/// @brief instruction counts of similarity candidates may differ by at most this factor
+		float size_ratio = 0.75f;
+
+		/// @brief secondary candidates the similarity stage looks at per primary function
+		uint32_t max_candidates = 256;
+	};
+
+	/// @brief matches the functions and blocks of two analyzed images
+	/// functions are paired by unique exact hashes first, then by unique structural hashes, then through the callers
+	/// and callees of matched pairs, and the rest by instruction histogram similarity. blocks are matched inside of
+	/// every function pair afterwards, features, similarity candidates and block matching run in parallel
+	class binary_diff
+	{
+	public:
+		/// @brief value returned for unmatched functions
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		binary_diff(const diff_input& primary, const diff_input& secondary, diff_options options = {}, size_t threads = 0)
+			: primary(primary), secondary(secondary), options(options)
+		{
+			if (threads == 0)
+				threads = parallel_threads();
+
+			left = extract(primary, threads);
+			right = extract(secondary, threads);
+			left_match.assign(primary.functions.size(), npos);
+			right_match.assign(secondary.functions.size(), npos);
+
+			match_unique(primary.hashes, secondary.hashes, match_kind::exact);
+			match_unique(structures(left), structures(right), match_kind::structural);
+
+			propagate(0);
+			const size_t before_similarity = matches.size();
+			match_similar(threads);
+			propagate(before_similarity);
+
+			match_blocks(threads);
+		}
+
+		/// @brief getter for the function pairs in the order they were matched
+		std::span<const function_match> functions() const { return matches; }
+
+		/// @brief getter for the block pairs of every matched function pair, ordered by the rva of the primary block
+		std::span<const block_match> blocks() const { return block_matches; }
+
+		/// @brief getter for the secondary function a primary function was matched with
+		uint32_t match_of_primary(uint32_t function) const { return left_match[function]; }
+
+		/// @brief getter for the primary function a secondary function was matched with
+		uint32_t match_of_secondary(uint32_t function) const { return right_match[function]; }
+
+		/// @brief collects the matched pairs whose code differs
+		std::vector<function_match> changed() const
+		{
+			std::vector<function_match> result;
+			for (const function_match& match : matches)
+			{
+				if (primary.hashes[match.primary] != secondary.hashes[match.secondary])
+					result.push_back(match);
+			}
+
+			return result;
+		}
+
+	private:
+		static constexpr size_t histogram_size = 64;
+
+		struct features
+		{
+			uint64_t structure;
+			uint32_t inst_count;
+			uint32_t block_count;
+			std::array<uint16_t, histogram_size> histogram;
+		};
+
+		diff_input primary;
+		diff_input secondary;
+		diff_options options;
+
+		std::vector<features> left;
+		std::vector<features> right;
+
+		std::vector<uint32_t> left_match;
+		std::vector<uint32_t> right_match;
+
+		std::vector<function_match> matches;
+		std::vector<block_match> block_matches;
+
+		static uint64_t mix(uint64_t h, uint64_t value)
+		{
+			h ^= value + 0x9E3779B97F4A7C15 + (h << 6) + (h >> 2);
+			return h;
+		}
+
+		/// @brief key of a block ignoring operands, the mnemonics and how many successors it has
+		static uint64_t block_key(const basic_block& block)
+		{
+			uint64_t h = mix(block.insts.size(), (block.branch_one != no_branch) + (block.branch_two != no_branch));
+			for (const codec::dec::inst& inst : block.insts)
+				h = mix(h, inst.info.mnemonic);
+
+			return h;
+		}
+
+		static std::vector<features> extract(const diff_input& side, size_t threads)
+		{
+			std::vector<features> result(side.functions.size());
+			parallel_for(side.functions.size(), [&](size_t function, size_t)
+			{
+				const std::span<const uint32_t> members = side.functions.blocks(static_cast<uint32_t>(function));
+
+				std::vector<uint32_t> ordered(members.begin(), members.end());
+				std::sort(ordered.begin(), ordered.end(), [&](uint32_t a, uint32_t b)
+				{
+					return side.blocks[a].rva_begin < side.blocks[b].rva_begin;
+				});
+
+				features& f = result[function];
+				f = {};
+				f.structure = ordered.size();
+				f.block_count = static_cast<uint32_t>(ordered.size());
+				for (uint32_t block : ordered)
+				{
+					const basic_block& b = side.blocks[block];
+					f.structure = mix(f.structure, block_key(b));
+					f.inst_count += static_cast<uint32_t>(b.insts.size());
+
+					for (const codec::dec::inst& inst : b.insts)
+					{
+						uint16_t& bucket = f.histogram[inst.info.mnemonic % histogram_size];
+						bucket = static_cast<uint16_t>(std::min<uint32_t>(bucket + 1, 0xFFFF));
+					}
+				}
+			}, threads);
+
+			return result;
+		}
+
+		void add_match(uint32_t a, uint32_t b, match_kind kind, float similarity)
+		{
+			left_match[a] = b;
+			right_match[b] = a;
+			matches.push_back({ a, b, kind, similarity });
+		}
+
+		static std::vector<uint64_t> structures(const std::vector<features>& side)
+		{
+			std::vector<uint64_t> keys(side.size());
+			for (size_t f = 0; f < side.size(); f++)
+				keys[f] = side[f].structure;
+
+			return keys;
+		}
+
+		/// @brief pairs unmatched functions whose key is unique on both sides
+		void match_unique(std::span<const uint64_t> left_key, std::span<const uint64_t> right_key, match_kind kind)
+		{
+			std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> left_keys;
+			std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> right_keys;
+
+			for (uint32_t f = 0; f < left_match.size(); f++)
+			{
+				if (left_match[f] == npos)
+				{
+					auto& [count, function] = left_keys[left_key[f]];
+					count++;
+					function = f;
+				}
+			}
+
+			for (uint32_t f = 0; f < right_match.size(); f++)
+			{
+				if (right_match[f] == npos)
+				{
+					auto& [count, function] = right_keys[right_key[f]];
+					count++;
+					function = f;
+				}
+			}
+
+			std::vector<std::pair<uint32_t, uint32_t>> pairs;
+			for (const auto& [k, l] : left_keys)
+			{
+				auto it = right_keys.find(k);
+				if (l.first == 1 && it != right_keys.end() && it->second.first == 1)
+					pairs.push_back({ l.second, it->second.second });
+			}
+
+			// the map order is arbitrary, sorting keeps the result deterministic
+			std::sort(pairs.begin(), pairs.end());
+			for (const auto& [a, b] : pairs)
+				add_match(a, b, kind, kind == match_kind::exact ? 1.0f : similarity(left[a], right[b]));
+		}
+
+		/// @brief unmatched neighbors of a matched pair are paired when they are the only candidates on both sides
+		/// or when their structural hash is unique among the neighbors, new pairs are propagated further
+		void propagate(size_t first)
+		{
+			const uint32_t left_count = static_cast<uint32_t>(primary.functions.size());
+			const uint32_t right_count = static_cast<uint32_t>(secondary.functions.size());
+
+			auto unmatched = [](std::span<const uint32_t> nodes, uint32_t count, const std::vector<uint32_t>& match)
+			{
+				std::vector<uint32_t> result;
+				for (uint32_t node : nodes)
+				{
+					if (node < count && match[node] == npos)
+						result.push_back(node);
+				}
+
+				std::sort(result.begin(), result.end());
+				result.erase(std::unique(result.begin(), result.end()), result.end());
+				return result;
+			};
+
+			for (size_t i = first; i < matches.size(); i++)
+			{
+				const uint32_t a = matches[i].primary;
+				const uint32_t b = matches[i].secondary;
+
+				for (bool callees : { true, false })
+				{
+					const std::vector<uint32_t> l = unmatched(
+						callees ? primary.calls.callees(a) : primary.calls.callers(a), left_count, left_match);
+					const std::vector<uint32_t> r = unmatched(
+						callees ? secondary.calls.callees(b) : secondary.calls.callers(b), right_count, right_match);
+
+					if (l.empty() || r.empty())
+						continue;
+
+					if (l.size() == 1 && r.size() == 1)
+					{
+						add_match(l[0], r[0], match_kind::call_graph, similarity(left[l[0]], right[r[0]]));
+						continue;
+					}
+
+					for (uint32_t x : l)
+					{
+						uint32_t found = npos;
+						uint32_t hits = 0;
+						for (uint32_t y : r)
+						{
+							if (right_match[y] == npos && left[x].structure == right[y].structure)
+							{
+								found = y;
+								hits++;
+							}
+						}
+
+						const bool unique_left = std::count_if(l.begin(), l.end(), [&](uint32_t other)
+						{
+							return left[other].structure == left[x].structure;
+						}) == 1;
+
+						if (hits == 1 && unique_left)
+							add_match(x, found, match_kind::call_graph, similarity(left[x], right[found]));
+					}
+				}
+			}
+		}
+
+		static float similarity(const features& a, const features& b)
+		{
+			uint32_t shared = 0;
+			uint32_t total = 0;
+			for (size_t i = 0; i < histogram_size; i++)
+			{
+				shared += std::min(a.histogram[i], b.histogram[i]);
+				total += std::max(a.histogram[i], b.histogram[i]);
+			}
+
+			const float blocks = static_cast<float>(std::min(a.block_count, b.block_count) + 1) /
+				static_cast<float>(std::max(a.block_count, b.block_count) + 1);
+
+			return total == 0 ? blocks : 0.8f * static_cast<float>(shared) / static_cast<float>(total) + 0.2f * blocks;
+		}
+
+		/// @brief every unmatched primary function picks its most similar unmatched secondary function of a similar
+		/// size in parallel, the candidates are then accepted best first so every function is paired at most once
+		void match_similar(size_t threads)
+		{
+			std::vector<uint32_t> pool;
+			for (uint32_t f = 0; f < right_match.size(); f++)
+			{
+				if (right_match[f] == npos)
+					pool.push_back(f);
+			}
+
+			std::sort(pool.begin(), pool.end(), [&](uint32_t x, uint32_t y)
+			{
+				return right[x].inst_count < right[y].inst_count;
+			});
+
+			std::vector<uint32_t> queries;
+			for (uint32_t f = 0; f < left_match.size(); f++)
+			{
+				if (left_match[f] == npos)
+					queries.push_back(f);
+			}
+
+			std::vector<function_match> candidates(queries.size(), { npos, npos, match_kind::similarity, 0.0f });
+			parallel_for(queries.size(), [&](size_t i, size_t)
+			{
+				const features& query = left[queries[i]];
+				const uint32_t low = static_cast<uint32_t>(query.inst_count * options.size_ratio);
+				const uint32_t high = static_cast<uint32_t>(query.inst_count / options.size_ratio) + 1;
+
+				auto it = std::lower_bound(pool.begin(), pool.end(), low, [&](uint32_t f, uint32_t value)
+				{
+					return right[f].inst_count < value;
+				});
+
+				for (uint32_t seen = 0; it != pool.end() && right[*it].inst_count <= high && seen < options.max_candidates; ++it, seen++)
+				{
+					const float score = similarity(query, right[*it]);
+					if (score >= options.min_similarity && score > candidates[i].similarity)
+						candidates[i] = { queries[i], *it, match_kind::similarity, score };
+				}
+			}, threads);
+
+			std::erase_if(candidates, [](const function_match& m) { return m.primary == npos; });
+			std::stable_sort(candidates.begin(), candidates.end(), [](const function_match& x, const function_match& y)
+			{
+				return x.similarity > y.similarity;
+			});
+
+			for (const function_match& candidate : candidates)
+			{
+				if (right_match[candidate.secondary] == npos)
+					add_match(candidate.primary, candidate.secondary, match_kind::similarity, candidate.similarity);
+			}
+		}
+
+		/// @brief pairs the blocks of every function pair by unique block keys and then along matched successors
+		void match_blocks(size_t threads)
+		{
+			std::vector<std::vector<block_match>> collected(threads);
+			parallel_for(matches.size(), [&](size_t i, size_t thread)
+			{
+				const std::span<const uint32_t> l = primary.functions.blocks(matches[i].primary);
+				const std::span<const uint32_t> r = secondary.functions.blocks(matches[i].secondary);
+
+				std::unordered_map<uint32_t, uint32_t> paired;
+				std::unordered_map<uint32_t, uint32_t> paired_right;
+				auto pair = [&](uint32_t a, uint32_t b)
+				{
+					if (paired.contains(a) || paired_right.contains(b))
+						return false;
+
+					paired.emplace(a, b);
+					paired_right.emplace(b, a);
+					collected[thread].push_back({ a, b });
+					return true;
+				};
+
+				// entries always correspond
+				std::vector<std::pair<uint32_t, uint32_t>> work;
+				if (!l.empty() && !r.empty() && pair(l[0], r[0]))
+					work.push_back({ l[0], r[0] });
+
+				std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> left_keys;
+				std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> right_keys;
+				for (uint32_t block : l)
+				{
+					auto& [count, id] = left_keys[block_key(primary.blocks[block])];
+					count++;
+					id = block;
+				}
+
+				for (uint32_t block : r)
+				{
+					auto& [count, id] = right_keys[block_key(secondary.blocks[block])];
+					count++;
+					id = block;
+				}
+
+				std::vector<std::pair<uint32_t, uint32_t>> anchors;
+				for (uint32_t block : l)
+				{
+					const auto& own = left_keys[block_key(primary.blocks[block])];
+					auto it = right_keys.find(block_key(primary.blocks[block]));
+					if (own.first == 1 && it != right_keys.end() && it->second.first == 1)
+						anchors.push_back({ block, it->second.second });
+				}
+
+				// the block order of a function follows discovery, which differs between runs, pairing in address
+				// order keeps the result deterministic
+				std::sort(anchors.begin(), anchors.end(), [&](const auto& x, const auto& y)
+				{
+					return primary.blocks[x.first].rva_begin < primary.blocks[y.first].rva_begin;
+				});
+
+				for (const auto& [a, b] : anchors)
+				{
+					if (pair(a, b))
+						work.push_back({ a, b });
+				}
+
+				// successors in the same branch slot with the same key follow their matched predecessor
+				while (!work.empty())
+				{
+					const auto [a, b] = work.back();
+					work.pop_back();
+
+					const basic_block& x = primary.blocks[a];
+					const basic_block& y = secondary.blocks[b];
+					const uint32_t left_targets[] = { x.branch_one, x.branch_two };
+					const uint32_t right_targets[] = { y.branch_one, y.branch_two };
+					for (size_t slot = 0; slot < 2; slot++)
+					{
+						if (left_targets[slot] == no_branch || right_targets[slot] == no_branch)
+							continue;
+
+						const uint32_t s = primary.index.find(left_targets[slot]);
+						const uint32_t t = secondary.index.find(right_targets[slot]);
+						if (s == block_index::npos || t == block_index::npos)
+							continue;
+
+						if (primary.functions.owner(s) != matches[i].primary ||
+							secondary.functions.owner(t) != matches[i].secondary)
+							continue;
+
+						if (block_key(primary.blocks[s]) == block_key(secondary.blocks[t]) && pair(s, t))
+							work.push_back({ s, t });
+					}
+				}
+			}, threads);
+
+			for (std::vector<block_match>& list : collected)
+				block_matches.insert(block_matches.end(), list.begin(), list.end());
+
+			// which thread matched which pair varies between runs
+			std::sort(block_matches.begin(), block_matches.end(), [&](const block_match& x, const block_match& y)
+			{
+				return primary.blocks[x.primary].rva_begin < primary.blocks[y.primary].rva_begin;
+			});
+		}
+	};
+}
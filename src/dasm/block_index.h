@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "dasm/basic_block.h"
+
+namespace eagle::dasm
+{
+	/// @brief sorted lookup from rvas to the position of blocks in a block list
+	class block_index
+	{
+	public:
+		/// @brief value returned when no block matches
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		explicit block_index(const block_list& blocks)
+		{
+			entries.reserve(blocks.size());
+			for (uint32_t i = 0; i < blocks.size(); i++)
+				entries.push_back({ blocks[i].rva_begin, blocks[i].rva_end, i, 0 });
+
+			std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b)
+			{
+				return a.rva_begin < b.rva_begin;
+			});
+
+			uint32_t max_end = 0;
+			for (entry& e : entries)
+			{
+				max_end = std::max(max_end, e.rva_end);
+				e.max_end = max_end;
+			}
+		}
+
+		/// @brief finds the block which starts at an rva
+		/// @param rva the first rva of the block
+		/// @return the position of the block, npos if none starts there
+		uint32_t find(uint32_t rva) const
+		{
+			auto it = std::lower_bound(entries.begin(), entries.end(), rva, [](const entry& e, uint32_t value)
+			{
+				return e.rva_begin < value;
+			});
+
+			if (it == entries.end() || it->rva_begin != rva)
+				return npos;
+
+			return it->block;
+		}
+
+		/// @brief finds the block whose bytes contain an rva
+		/// @param rva any rva inside of the block
+		/// @return the position of the containing block with the highest start, npos if no block contains it
+		uint32_t containing(uint32_t rva) const
+		{
+			uint32_t result = npos;
+			for_each_containing(rva, [&](uint32_t block)
+			{
+				result = block;
+				return false;
+			});
+
+			return result;
+		}
+
+		/// @brief calls fn with every block whose bytes contain an rva, more than one block contains it when
+		/// instruction streams overlap or descent entered a block in its middle
+		/// @param rva any rva inside of the blocks
+		/// @param fn callable taking the position of the block, returning false stops the walk
+		template <typename function>
+		void for_each_containing(uint32_t rva, function&& fn) const
+		{
+			auto it = std::upper_bound(entries.begin(), entries.end(), rva, [](uint32_t value, const entry& e)
+			{
+				return value < e.rva_begin;
+			});
+
+			// max_end bounds every block at or before a position, once it drops to rva no earlier block can reach it
+			while (it != entries.begin())
+			{
+				--it;
+				if (it->max_end <= rva)
+					break;
+
+				if (rva < it->rva_end && !fn(it->block))
+					break;
+			}
+		}
+
+		/// @brief getter for the amount of indexed blocks
+		size_t size() const { return entries.size(); }
+
+	private:
+		struct entry
+		{
+			uint32_t rva_begin;
+			uint32_t rva_end;
+			uint32_t block;
+
+			/// @brief highest end of this and every earlier entry
+			uint32_t max_end;
+		};
+
+		std::vector<entry> entries;
+	};
+
+	/// @brief calls fn with the position of every recovered successor of a block
+	/// @param block the block whose branches are followed
+	/// @param index index of the block list the successors are looked up in
+	/// @param fn callable taking the position of the successor
+	template <typename function>
+	void for_each_successor(const basic_block& block, const block_index& index, function&& fn)
+	{
+		for (uint32_t branch : { block.branch_one, block.branch_two })
+		{
+			if (branch == no_branch)
+				continue;
+
+			const uint32_t successor = index.find(branch);
+			if (successor != block_index::npos)
+				fn(successor);
+		}
+	}
+}
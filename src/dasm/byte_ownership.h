@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "dasm/basic_block.h"
+
+namespace eagle::dasm
+{
+	/// @brief instruction which decodes from bytes another instruction already owns, for example after a jump into
+	/// the middle of an instruction
+	struct inst_overlap
+	{
+		uint32_t rva;
+		uint8_t length;
+
+		/// @brief the start of the owning instruction at the first conflicting byte
+		uint32_t owner;
+	};
+
+	/// @brief records which instruction owns every byte of a segment so overlapping instruction streams can coexist
+	/// the first instruction claiming a byte owns it, later instructions decoding from the same bytes with a different
+	/// start are kept as overlaps instead of being dropped. one byte of state per segment byte, claims are lock-free
+	class byte_ownership
+	{
+	public:
+		/// @brief value returned for bytes no instruction owns
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		/// @brief outcome of claiming the bytes of an instruction
+		enum class claim_result : uint8_t
+		{
+			/// @brief every byte was free
+			claimed,
+
+			/// @brief the same instruction was claimed before
+			existing,
+
+			/// @brief at least one byte belongs to a different instruction
+			overlap,
+		};
+
+		byte_ownership(uint32_t rva_begin, uint32_t rva_end)
+			: rva_begin(rva_begin), rva_end(rva_end), states(std::make_unique<std::atomic<uint8_t>[]>(rva_end - rva_begin))
+		{
+		}
+
+		/// @brief claims the bytes of an instruction, the instruction which claims the start byte first takes every free
+		/// byte of its body, an instruction starting inside of another one owns none of its bytes
+		/// @param rva the first byte of the instruction
+		/// @param length the length of the instruction
+		/// @return how the bytes related to previously claimed instructions
+		claim_result claim(uint32_t rva, uint8_t length)
+		{
+			if (!contains(rva))
+				return claim_result::claimed;
+
+			// the start byte decides ownership, so claims of the same instruction never both win and nothing is released
+			uint8_t state = 0;
+			const bool won = states[rva - rva_begin].compare_exchange_strong(state, length, std::memory_order_acq_rel);
+			if (!won && state != length)
+				return record_overlap(rva, length, start_of(rva, state));
+
+			uint32_t owner = npos;
+			for (uint8_t i = 1; i < length && contains(rva + i); i++)
+			{
+				const uint8_t wanted = static_cast<uint8_t>(body | i);
+
+				// only the winner takes body bytes, a repeated claim checks them and skips those the winner has yet to take
+				state = 0;
+				if (won)
+					states[rva + i - rva_begin].compare_exchange_strong(state, wanted, std::memory_order_acq_rel);
+				else
+					state = states[rva + i - rva_begin].load(std::memory_order_acquire);
+
+				if (state != 0 && state != wanted && owner == npos)
+					owner = start_of(rva + i, state);
+			}
+
+			if (owner != npos)
+				return record_overlap(rva, length, owner);
+
+			return won ? claim_result::claimed : claim_result::existing;
+		}
+
+		/// @brief claims every instruction of a block
+		/// @return true if any instruction of the block overlaps another instruction stream
+		bool claim(const basic_block& block)
+		{
+			bool overlapping = false;
+
+			uint32_t rva = block.rva_begin;
+			for (const codec::dec::inst& inst : block.insts)
+			{
+				overlapping |= claim(rva, inst.info.length) == claim_result::overlap;
+				rva += inst.info.length;
+			}
+
+			return overlapping;
+		}
+
+		/// @brief finds the instruction which owns a byte
+		/// @return the start of the owning instruction, npos if the byte is not owned
+		uint32_t owner(uint32_t rva) const
+		{
+			if (!contains(rva))
+				return npos;
+
+			const uint8_t state = states[rva - rva_begin].load(std::memory_order_acquire);
+			return state == 0 ? npos : start_of(rva, state);
+		}
+
+		/// @brief checks if an instruction of the owning stream starts at an rva
+		bool is_inst_start(uint32_t rva) const
+		{
+			if (!contains(rva))
+				return false;
+
+			const uint8_t state = states[rva - rva_begin].load(std::memory_order_acquire);
+			return state != 0 && !(state & body);
+		}
+
+		/// @brief getter for the instructions which overlap the owning stream, sorted by rva
+		std::vector<inst_overlap> overlaps() const
+		{
+			std::vector<inst_overlap> result;
+			{
+				std::lock_guard lock(overlaps_mutex);
+				result = overlap_list;
+			}
+
+			// an instruction is recorded once per claim, repeated claims are merged
+			std::sort(result.begin(), result.end(), [](const inst_overlap& a, const inst_overlap& b)
+			{
+				return std::tie(a.rva, a.length, a.owner) < std::tie(b.rva, b.length, b.owner);
+			});
+
+			result.erase(std::unique(result.begin(), result.end(), [](const inst_overlap& a, const inst_overlap& b)
+			{
+				return a.rva == b.rva && a.length == b.length && a.owner == b.owner;
+			}), result.end());
+
+			return result;
+		}
+
+	private:
+		// a start byte stores the instruction length, a body byte stores the flag and its distance to the start
+		static constexpr uint8_t body = 0x80;
+		static constexpr uint8_t length_mask = 0x7F;
+
+		uint32_t rva_begin;
+		uint32_t rva_end;
+		std::unique_ptr<std::atomic<uint8_t>[]> states;
+
+		mutable std::mutex overlaps_mutex;
+		std::vector<inst_overlap> overlap_list;
+
+		bool contains(uint32_t rva) const { return rva >= rva_begin && rva < rva_end; }
+
+		claim_result record_overlap(uint32_t rva, uint8_t length, uint32_t owner)
+		{
+			std::lock_guard lock(overlaps_mutex);
+			overlap_list.push_back({ rva, length, owner });
+			return claim_result::overlap;
+		}
+
+		static uint32_t start_of(uint32_t rva, uint8_t state)
+		{
+			return state & body ? rva - (state & length_mask) : rva;
+		}
+	};
+}
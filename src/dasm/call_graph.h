@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/function_map.h"
+#include "dasm/parallel.h"
+
+namespace eagle::dasm
+{
+	/// @brief caller and callee relationships between functions stored in compressed sparse row form
+	/// nodes [0, function count) are the functions of the function map, the nodes after them are the
+	/// iat / got slots called through rip relative pointers
+	class call_graph
+	{
+	public:
+		/// @brief value returned when no node matches
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		/// @brief collects the call edges of every block in parallel and builds the graph
+		/// @param blocks the recovered blocks
+		/// @param functions the function partition of the blocks
+		/// @param threads amount of threads, 0 uses parallel_threads()
+		call_graph(const block_list& blocks, const function_map& functions, size_t threads = 0)
+			: function_count(static_cast<uint32_t>(functions.size()))
+		{
+			if (threads == 0)
+				threads = parallel_threads();
+
+			// every thread collects into its own list, nothing is shared until the merge
+			std::vector<std::vector<raw_edge>> collected(threads);
+			parallel_for(blocks.size(), [&](size_t block, size_t thread)
+			{
+				const uint32_t caller = functions.owner(static_cast<uint32_t>(block));
+				if (caller == function_map::npos)
+					return;
+
+				for (const call_site& call : blocks[block].calls)
+				{
+					if (call.kind != call_kind::indirect)
+						collected[thread].push_back({ caller, call.target, call.kind });
+				}
+			}, threads);
+
+			// slots become nodes after the functions
+			for (const std::vector<raw_edge>& list : collected)
+			{
+				for (const raw_edge& edge : list)
+				{
+					if (edge.kind == call_kind::slot)
+						slot_rvas.push_back(edge.target);
+				}
+			}
+
+			std::sort(slot_rvas.begin(), slot_rvas.end());
+			slot_rvas.erase(std::unique(slot_rvas.begin(), slot_rvas.end()), slot_rvas.end());
+
+			// each thread copies its edges into its own range of the merged list, the ranges come from a prefix sum
+			std::vector<size_t> starts(threads + 1, 0);
+			for (size_t thread = 0; thread < threads; thread++)
+				starts[thread + 1] = starts[thread] + collected[thread].size();
+
+			std::vector<edge> edges(starts[threads]);
+			parallel_for(threads, [&](size_t thread, size_t)
+			{
+				size_t out = starts[thread];
+				for (const raw_edge& raw : collected[thread])
+				{
+					const uint32_t callee = raw.kind == call_kind::slot
+						? function_count + slot_index(raw.target)
+						: functions.find(raw.target);
+
+					edges[out++] = { raw.caller, callee };
+				}
+			}, threads);
+
+			std::erase_if(edges, [](const edge& e) { return e.callee == npos; });
+			std::sort(edges.begin(), edges.end(), [](const edge& a, const edge& b)
+			{
+				return a.caller != b.caller ? a.caller < b.caller : a.callee < b.callee;
+			});
+
+			edges.erase(std::unique(edges.begin(), edges.end(), [](const edge& a, const edge& b)
+			{
+				return a.caller == b.caller && a.callee == b.callee;
+			}), edges.end());
+
+			build_csr(edges);
+		}
+
+		/// @brief getter for the amount of nodes, functions and slots
+		size_t size() const { return function_count + slot_rvas.size(); }
+
+		/// @brief checks if a node is an iat / got slot rather than a function
+		bool is_slot(uint32_t node) const { return node >= function_count; }
+
+		/// @brief getter for the rva of a slot node
+		uint32_t slot_rva(uint32_t node) const { return slot_rvas[node - function_count]; }
+
+		/// @brief getter for the nodes a function calls
+		std::span<const uint32_t> callees(uint32_t node) const
+		{
+			return std::span(callee_list).subspan(callee_offsets[node], callee_offsets[node + 1] - callee_offsets[node]);
+		}
+
+		/// @brief getter for the functions which call a node
+		std::span<const uint32_t> callers(uint32_t node) const
+		{
+			return std::span(caller_list).subspan(caller_offsets[node], caller_offsets[node + 1] - caller_offsets[node]);
+		}
+
+		/// @brief getter for the amount of unique caller to callee edges
+		size_t edge_count() const { return callee_list.size(); }
+
+	private:
+		struct raw_edge
+		{
+			uint32_t caller;
+			uint32_t target;
+			call_kind kind;
+		};
+
+		struct edge
+		{
+			uint32_t caller;
+			uint32_t callee;
+		};
+
+		uint32_t function_count;
+		std::vector<uint32_t> slot_rvas;
+
+		std::vector<uint32_t> callee_offsets;
+		std::vector<uint32_t> callee_list;
+
+		std::vector<uint32_t> caller_offsets;
+		std::vector<uint32_t> caller_list;
+
+		uint32_t slot_index(uint32_t rva) const
+		{
+			return static_cast<uint32_t>(std::lower_bound(slot_rvas.begin(), slot_rvas.end(), rva) - slot_rvas.begin());
+		}
+
+		/// @brief builds both directions from edges sorted by caller
+		void build_csr(const std::vector<edge>& edges)
+		{
+			const size_t nodes = size();
+
+			callee_offsets.assign(nodes + 1, 0);
+			caller_offsets.assign(nodes + 1, 0);
+			for (const edge& e : edges)
+			{
+				callee_offsets[e.caller + 1]++;
+				caller_offsets[e.callee + 1]++;
+			}
+
+			for (size_t node = 0; node < nodes; node++)
+			{
+				callee_offsets[node + 1] += callee_offsets[node];
+				caller_offsets[node + 1] += caller_offsets[node];
+			}
+
+			callee_list.resize(edges.size());
+			for (size_t i = 0; i < edges.size(); i++)
+				callee_list[i] = edges[i].callee;
+
+			// callers are placed with a counting sort, they stay ascending because edges are sorted by caller
+			caller_list.resize(edges.size());
+			std::vector<uint32_t> cursor(caller_offsets.begin(), caller_offsets.end() - 1);
+			for (const edge& e : edges)
+				caller_list[cursor[e.callee]++] = e.caller;
+		}
+	};
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+#include <memory_resource>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/small_vector.h"
+
+namespace eagle::dasm
+{
+	/// @brief in-memory form of a decoded instruction which only keeps where it is and what kind it is,
+	/// the full instruction is decoded again from the image bytes when it is needed
+	struct compact_inst
+	{
+		/// @brief largest offset an instruction can have from the start of its block
+		static constexpr uint32_t max_offset = 0xFFFF;
+
+		uint16_t offset;
+		uint8_t length;
+		uint8_t reserved;
+		uint16_t flags;
+	};
+
+	static_assert(sizeof(compact_inst) == 6, "compact_inst must stay 6 bytes");
+
+	/// @brief basic block whose instructions are stored as compact_inst
+	/// blocks spanning more than compact_inst::max_offset bytes are split with a fallthrough into branch_one
+	struct compact_block
+	{
+		using allocator_type = std::pmr::polymorphic_allocator<>;
+
+		uint32_t rva_begin = 0, rva_end = 0;
+		uint32_t branch_one = no_branch, branch_two = no_branch;
+
+		/// @brief why decoding stopped before a terminator, ok for complete blocks
+		decode_status status = decode_status::ok;
+
+		/// @brief the instructions, blocks of up to 8 instructions keep them inline
+		small_vector<compact_inst, 8> insts;
+
+		compact_block() = default;
+		compact_block(const compact_block&) = default;
+		compact_block(compact_block&&) = default;
+		compact_block& operator=(const compact_block&) = default;
+		compact_block& operator=(compact_block&&) = default;
+
+		explicit compact_block(const allocator_type& alloc)
+			: insts(alloc)
+		{
+		}
+
+		compact_block(const compact_block& other, const allocator_type& alloc)
+			: rva_begin(other.rva_begin), rva_end(other.rva_end),
+			  branch_one(other.branch_one), branch_two(other.branch_two), status(other.status),
+			  insts(other.insts, alloc)
+		{
+		}
+
+		compact_block(compact_block&& other, const allocator_type& alloc)
+			: rva_begin(other.rva_begin), rva_end(other.rva_end),
+			  branch_one(other.branch_one), branch_two(other.branch_two), status(other.status),
+			  insts(std::move(other.insts), alloc)
+		{
+		}
+
+		allocator_type get_allocator() const { return insts.get_allocator(); }
+
+		/// @brief getter for the rva of an instruction in this block
+		/// @param inst an instruction of this block
+		/// @return the rva the instruction is located at
+		uint32_t inst_rva(const compact_inst& inst) const
+		{
+			return rva_begin + inst.offset;
+		}
+	};
+
+	/// @brief list of compact blocks recovered by an analysis, constructed over the analysis arena
+	using compact_block_list = std::pmr::vector<compact_block>;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include <functional>
+#include <optional>
+#include <span>
+
+#include "dasm/basic_block.h"
+#include "dasm/discovery_scheduler.h"
+#include "dasm/rva_set.h"
+#include "dasm/segment_dasm.h"
+
+namespace eagle::dasm
+{
+	/// @brief decodes queued rvas in priority order until the scheduler runs dry, queueing branch and direct call targets
+	/// @param dasm the dasm of the segment, its resource backs the created blocks
+	/// @param scheduler the queue of rvas, may be fed with new entries or requests between calls
+	/// @param blocks list the newly discovered blocks are appended to
+	/// @param on_block optional callback invoked with every block right after it is decoded
+	inline void recursive_descent(segment_dasm& dasm, discovery_scheduler& scheduler, block_list& blocks,
+		const std::function<void(const basic_block&)>& on_block = nullptr)
+	{
+		auto in_segment = [&](uint32_t rva) { return dasm.contains(rva); };
+
+		// descent jumps around the segment, readahead of the neighbouring pages would mostly be wasted
+		const scoped_advice advice = dasm.advise_scoped(access_pattern::random);
+
+		while (const std::optional<discovery_scheduler::item> next = scheduler.pop())
+		{
+			basic_block block = dasm.get_block(next->rva);
+			scheduler.push_successors(block, next->priority, in_segment);
+			dasm.prefetch_successors(block);
+
+			if (on_block)
+				on_block(block);
+
+			blocks.push_back(std::move(block));
+			scheduler.complete();
+		}
+	}
+
+	/// @brief disassembles every block reachable through direct branches and direct calls from the entry rvas
+	/// @param dasm the dasm of the segment, its resource backs the created blocks
+	/// @param entries the rvas discovery starts at
+	/// @param discovered rvas which were already queued, blocks starting at these are not disassembled again
+	/// @param blocks list the newly discovered blocks are appended to
+	/// @param on_block optional callback invoked with every block right after it is decoded
+	inline void recursive_descent(segment_dasm& dasm, std::span<const uint32_t> entries,
+		rva_set& discovered, block_list& blocks,
+		const std::function<void(const basic_block&)>& on_block = nullptr)
+	{
+		discovery_scheduler scheduler(discovered);
+		for (uint32_t entry : entries)
+		{
+			if (dasm.contains(entry))
+				scheduler.push(entry, discovery_priority::entry);
+		}
+
+		recursive_descent(dasm, scheduler, blocks, on_block);
+	}
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/rva_set.h"
+
+namespace eagle::dasm
+{
+	/// @brief urgency of a discovery target, lower values are decoded first
+	enum class discovery_priority : uint8_t
+	{
+		request,
+		entry,
+		exported,
+		call,
+
+		/// @brief code pointer found in data, such as a vtable slot or a function pointer table entry
+		pointer,
+
+		branch,
+		speculative,
+	};
+
+	/// @brief thread-safe queue of rvas waiting to be decoded, ordered by priority and fifo within a priority
+	/// branch targets inherit the priority of the block they leave so a requested function is finished before
+	/// anything else, call targets are never more urgent than call. an rva which is still waiting when it is pushed
+	/// again at a more urgent priority is moved up
+	class discovery_scheduler
+	{
+	public:
+		/// @brief rva waiting to be decoded
+		struct item
+		{
+			uint32_t rva;
+			discovery_priority priority;
+		};
+
+		/// @param discovered rvas which were already queued, shared with other schedulers of the same image
+		explicit discovery_scheduler(rva_set& discovered)
+			: discovered(discovered)
+		{
+		}
+
+		/// @brief queues an rva unless it was discovered before, an rva still waiting at a lower priority is moved up
+		/// @return true if the rva was queued
+		bool push(uint32_t rva, discovery_priority priority)
+		{
+			std::lock_guard lock(mutex);
+			return enqueue(rva, priority);
+		}
+
+		/// @brief queues many rvas at once, the queue lock is taken a single time
+		/// @param rvas the rvas, ones discovered before are skipped unless they are still waiting at a lower priority
+		/// @param priority the priority of every rva
+		/// @return the amount of rvas which were queued
+		size_t push_all(std::span<const uint32_t> rvas, discovery_priority priority)
+		{
+			std::lock_guard lock(mutex);
+
+			size_t count = 0;
+			for (uint32_t rva : rvas)
+				count += enqueue(rva, priority);
+
+			return count;
+		}
+
+		/// @brief queues an rva at request priority even if it is already waiting at a lower priority
+		/// the blocks it reaches through branches inherit the request priority as they are discovered
+		void request(uint32_t rva)
+		{
+			push(rva, discovery_priority::request);
+		}
+
+		/// @brief takes the most urgent rva which was not decoded yet, complete() has to be called once it is processed
+		/// @return the item, std::nullopt if nothing is waiting
+		std::optional<item> pop()
+		{
+			std::lock_guard lock(mutex);
+			for (size_t level = 0; level < levels.size(); level++)
+			{
+				std::deque<uint32_t>& queue = levels[level];
+				while (!queue.empty())
+				{
+					const uint32_t rva = queue.front();
+					queue.pop_front();
+
+					// an rva which was moved up leaves its earlier copy behind, only the copy at its current level is taken
+					auto it = waiting.find(rva);
+					if (it != waiting.end() && it->second == level)
+					{
+						waiting.erase(it);
+						return item { rva, static_cast<discovery_priority>(level) };
+					}
+
+					outstanding.fetch_sub(1, std::memory_order_acq_rel);
+				}
+			}
+
+			return std::nullopt;
+		}
+
+		/// @brief queues the branch and direct call targets of a decoded block
+		/// @param block the decoded block
+		/// @param priority the priority the block was decoded at
+		/// @param accept filter the targets have to pass, usually the segment bounds
+		template <typename filter>
+		void push_successors(const basic_block& block, discovery_priority priority, filter&& accept)
+		{
+			for (uint32_t branch : { block.branch_one, block.branch_two })
+			{
+				if (branch != no_branch && accept(branch))
+					push(branch, priority);
+			}
+
+			const discovery_priority call_priority = std::max(priority, discovery_priority::call);
+			for (const call_site& call : block.calls)
+			{
+				if (call.kind == call_kind::direct && accept(call.target))
+					push(call.target, call_priority);
+			}
+		}
+
+		/// @brief marks a popped item as processed, call it after its successors were pushed
+		void complete()
+		{
+			outstanding.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		/// @brief checks if nothing is queued and no popped item is still being processed
+		/// successors are pushed before their item completes, so an idle scheduler cannot receive new work from a worker
+		bool idle() const
+		{
+			return outstanding.load(std::memory_order_acquire) == 0;
+		}
+
+		/// @brief getter for the amount of queued entries, including the earlier copies of rvas which were moved up
+		size_t pending() const
+		{
+			std::lock_guard lock(mutex);
+
+			size_t count = 0;
+			for (const std::deque<uint32_t>& queue : levels)
+				count += queue.size();
+
+			return count;
+		}
+
+	private:
+		rva_set& discovered;
+
+		std::atomic<size_t> outstanding = 0;
+
+		mutable std::mutex mutex;
+		std::array<std::deque<uint32_t>, static_cast<size_t>(discovery_priority::speculative) + 1> levels;
+
+		/// @brief the level every queued rva is taken at, only holds rvas which were not popped yet
+		std::unordered_map<uint32_t, uint8_t> waiting;
+
+		/// @brief queues a newly discovered rva or moves a waiting one to a more urgent level, the mutex has to be held
+		/// rvas which were decoded already or were queued by another scheduler sharing discovered are dropped
+		/// @return true if the rva was queued
+		bool enqueue(uint32_t rva, discovery_priority priority)
+		{
+			if (rva == no_branch)
+				return false;
+
+			const uint8_t level = static_cast<uint8_t>(priority);
+			if (discovered.insert(rva))
+			{
+				waiting.emplace(rva, level);
+			}
+			else
+			{
+				auto it = waiting.find(rva);
+				if (it == waiting.end() || it->second <= level)
+					return false;
+
+				it->second = level;
+			}
+
+			outstanding.fetch_add(1, std::memory_order_relaxed);
+			levels[level].push_back(rva);
+			return true;
+		}
+	};
+}
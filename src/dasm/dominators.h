@@ -0,0 +1,354 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/function_cfg.h"
+#include "dasm/function_map.h"
+#include "dasm/parallel.h"
+
+namespace eagle::dasm
+{
+	/// @brief dominator tree of a function graph computed with the cooper, harvey and kennedy iteration
+	/// all ids are local block ids of the function_cfg, blocks not reachable from the entry have no dominator
+	class dominator_tree
+	{
+	public:
+		/// @brief value returned for the entry and unreachable blocks
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		explicit dominator_tree(const function_cfg& cfg)
+			: order(cfg.reverse_postorder()), idoms(cfg.size(), npos), order_index(cfg.size(), npos)
+		{
+			for (uint32_t position = 0; position < order.size(); position++)
+				order_index[order[position]] = position;
+
+			if (order.empty())
+				return;
+
+			// the iteration treats the entry as its own dominator, it is reset to npos at the end
+			idoms[0] = 0;
+
+			bool changed = true;
+			while (changed)
+			{
+				changed = false;
+				for (size_t position = 1; position < order.size(); position++)
+				{
+					const uint32_t block = order[position];
+
+					uint32_t idom = npos;
+					for (uint32_t pred : cfg.predecessors(block))
+					{
+						if (idoms[pred] == npos)
+							continue;
+
+						idom = idom == npos ? pred : intersect(pred, idom);
+					}
+
+					if (idom != idoms[block])
+					{
+						idoms[block] = idom;
+						changed = true;
+					}
+				}
+			}
+
+			idoms[0] = npos;
+			number_tree();
+		}
+
+		/// @brief getter for the immediate dominator of a block
+		uint32_t idom(uint32_t local) const { return idoms[local]; }
+
+		/// @brief checks if a block is reachable from the function entry
+		bool reachable(uint32_t local) const { return order_index[local] != npos; }
+
+		/// @brief checks if every path from the entry to b passes through a, a block dominates itself
+		bool dominates(uint32_t a, uint32_t b) const
+		{
+			if (!reachable(a) || !reachable(b))
+				return false;
+
+			return tree_enter[a] <= tree_enter[b] && tree_exit[b] <= tree_exit[a];
+		}
+
+		/// @brief getter for the blocks a block immediately dominates
+		std::span<const uint32_t> children(uint32_t local) const
+		{
+			return std::span(child_list).subspan(child_offsets[local], child_offsets[local + 1] - child_offsets[local]);
+		}
+
+		/// @brief getter for the reverse post-order the tree was computed in
+		std::span<const uint32_t> reverse_postorder() const { return order; }
+
+	private:
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> idoms;
+		std::vector<uint32_t> order_index;
+
+		std::vector<uint32_t> child_offsets;
+		std::vector<uint32_t> child_list;
+
+		std::vector<uint32_t> tree_enter;
+		std::vector<uint32_t> tree_exit;
+
+		/// @brief walks both fingers up the partial tree until they meet at the common dominator
+		uint32_t intersect(uint32_t a, uint32_t b) const
+		{
+			while (a != b)
+			{
+				while (order_index[a] > order_index[b])
+					a = idoms[a];
+				while (order_index[b] > order_index[a])
+					b = idoms[b];
+			}
+
+			return a;
+		}
+
+		/// @brief builds the child lists and dfs numbers over the tree so dominance queries are constant time
+		void number_tree()
+		{
+			const size_t count = idoms.size();
+
+			child_offsets.assign(count + 1, 0);
+			for (uint32_t block = 0; block < count; block++)
+			{
+				if (idoms[block] != npos)
+					child_offsets[idoms[block] + 1]++;
+			}
+
+			for (size_t block = 0; block < count; block++)
+				child_offsets[block + 1] += child_offsets[block];
+
+			child_list.resize(child_offsets.back());
+			std::vector<uint32_t> cursor(child_offsets.begin(), child_offsets.end() - 1);
+			for (uint32_t block : order)
+			{
+				if (idoms[block] != npos)
+					child_list[cursor[idoms[block]]++] = block;
+			}
+
+			tree_enter.assign(count, 0);
+			tree_exit.assign(count, 0);
+
+			uint32_t clock = 0;
+			std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+			tree_enter[0] = clock++;
+			while (!stack.empty())
+			{
+				auto& [block, next] = stack.back();
+				const std::span<const uint32_t> kids = children(block);
+				if (next < kids.size())
+				{
+					const uint32_t child = kids[next++];
+					tree_enter[child] = clock++;
+					stack.push_back({ child, 0 });
+					continue;
+				}
+
+				tree_exit[block] = clock++;
+				stack.pop_back();
+			}
+		}
+	};
+
+	/// @brief natural loops of a function graph, loops sharing a header are merged into one
+	/// retreating edges whose target does not dominate the source belong to irreducible regions and form no loop
+	class loop_forest
+	{
+	public:
+		/// @brief value returned for blocks outside of every loop and for top level loops
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		loop_forest(const function_cfg& cfg, const dominator_tree& dominators)
+			: innermost(cfg.size(), npos)
+		{
+			// every back edge adds its latch to the loop of its header
+			std::vector<std::pair<uint32_t, uint32_t>> back_edges;
+			for (uint32_t block = 0; block < cfg.size(); block++)
+			{
+				for (uint32_t successor : cfg.successors(block))
+				{
+					if (dominators.dominates(successor, block))
+						back_edges.push_back({ successor, block });
+				}
+			}
+
+			std::sort(back_edges.begin(), back_edges.end());
+
+			// the body of a loop is everything reaching a latch backwards without passing the header
+			std::vector<std::vector<uint32_t>> bodies;
+			std::vector<uint32_t> mark(cfg.size(), npos);
+			for (size_t i = 0; i < back_edges.size();)
+			{
+				const uint32_t loop = static_cast<uint32_t>(headers.size());
+				const uint32_t header = back_edges[i].first;
+				headers.push_back(header);
+
+				std::vector<uint32_t> body = { header };
+				std::vector<uint32_t> stack;
+				mark[header] = loop;
+				for (; i < back_edges.size() && back_edges[i].first == header; i++)
+				{
+					if (mark[back_edges[i].second] != loop)
+					{
+						mark[back_edges[i].second] = loop;
+						stack.push_back(back_edges[i].second);
+					}
+				}
+
+				while (!stack.empty())
+				{
+					const uint32_t block = stack.back();
+					stack.pop_back();
+					body.push_back(block);
+
+					for (uint32_t pred : cfg.predecessors(block))
+					{
+						if (mark[pred] != loop && dominators.reachable(pred))
+						{
+							mark[pred] = loop;
+							stack.push_back(pred);
+						}
+					}
+				}
+
+				std::sort(body.begin(), body.end());
+				bodies.push_back(std::move(body));
+			}
+
+			// natural loops are nested or disjoint, so visiting the largest first leaves every block with its innermost
+			// loop and every header still pointing at the enclosing loop when its own loop is visited
+			std::vector<uint32_t> by_size(headers.size());
+			for (uint32_t loop = 0; loop < by_size.size(); loop++)
+				by_size[loop] = loop;
+
+			std::stable_sort(by_size.begin(), by_size.end(), [&](uint32_t a, uint32_t b)
+			{
+				return bodies[a].size() > bodies[b].size();
+			});
+
+			parents.assign(headers.size(), npos);
+			depths.assign(headers.size(), 1);
+			for (uint32_t loop : by_size)
+			{
+				parents[loop] = innermost[headers[loop]];
+				if (parents[loop] != npos)
+					depths[loop] = depths[parents[loop]] + 1;
+
+				for (uint32_t block : bodies[loop])
+					innermost[block] = loop;
+			}
+
+			body_offsets.assign(headers.size() + 1, 0);
+			for (uint32_t loop = 0; loop < headers.size(); loop++)
+				body_offsets[loop + 1] = body_offsets[loop] + static_cast<uint32_t>(bodies[loop].size());
+
+			body_list.reserve(body_offsets.back());
+			for (const std::vector<uint32_t>& body : bodies)
+				body_list.insert(body_list.end(), body.begin(), body.end());
+		}
+
+		/// @brief getter for the amount of loops
+		size_t size() const { return headers.size(); }
+
+		/// @brief getter for the local header block of a loop
+		uint32_t header(uint32_t loop) const { return headers[loop]; }
+
+		/// @brief getter for the enclosing loop of a loop, npos for top level loops
+		uint32_t parent(uint32_t loop) const { return parents[loop]; }
+
+		/// @brief getter for the nesting depth of a loop, top level loops are at depth 1
+		uint32_t depth(uint32_t loop) const { return depths[loop]; }
+
+		/// @brief getter for the sorted local blocks of a loop including nested loops
+		std::span<const uint32_t> blocks(uint32_t loop) const
+		{
+			return std::span(body_list).subspan(body_offsets[loop], body_offsets[loop + 1] - body_offsets[loop]);
+		}
+
+		/// @brief getter for the innermost loop containing a block
+		uint32_t loop_of(uint32_t local) const { return innermost[local]; }
+
+		/// @brief getter for the loop nesting depth of a block, 0 outside of every loop
+		uint32_t block_depth(uint32_t local) const
+		{
+			return innermost[local] == npos ? 0 : depths[innermost[local]];
+		}
+
+	private:
+		std::vector<uint32_t> headers;
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> depths;
+		std::vector<uint32_t> innermost;
+
+		std::vector<uint32_t> body_offsets;
+		std::vector<uint32_t> body_list;
+	};
+
+	/// @brief dominators and loop nesting for every function, computed in parallel and flattened onto block list positions
+	class loop_nesting
+	{
+	public:
+		/// @brief value returned for blocks without a dominator or loop
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		/// @param blocks the recovered blocks
+		/// @param index index over the same blocks
+		/// @param functions the function partition of the blocks
+		/// @param threads amount of threads, 0 uses parallel_threads()
+		loop_nesting(const block_list& blocks, const block_index& index, const function_map& functions, size_t threads = 0)
+			: idoms(blocks.size(), npos), headers(blocks.size(), npos), depths(blocks.size(), 0), loops(functions.size(), 0)
+		{
+			// functions own disjoint blocks so every thread writes its own slots without synchronization
+			parallel_for(functions.size(), [&](size_t function, size_t)
+			{
+				const function_cfg cfg(blocks, index, functions, static_cast<uint32_t>(function));
+				const dominator_tree dominators(cfg);
+				const loop_forest forest(cfg, dominators);
+
+				for (uint32_t local = 0; local < cfg.size(); local++)
+				{
+					const uint32_t block = cfg.block(local);
+					if (dominators.idom(local) != dominator_tree::npos)
+						idoms[block] = cfg.block(dominators.idom(local));
+
+					const uint32_t loop = forest.loop_of(local);
+					if (loop != loop_forest::npos)
+					{
+						headers[block] = cfg.block(forest.header(loop));
+						depths[block] = forest.depth(loop);
+					}
+				}
+
+				loops[function] = static_cast<uint32_t>(forest.size());
+			}, threads);
+		}
+
+		/// @brief getter for the immediate dominator of a block, npos for function entries and unreachable blocks
+		uint32_t idom(uint32_t block) const { return idoms[block]; }
+
+		/// @brief getter for the header of the innermost loop containing a block
+		uint32_t loop_header(uint32_t block) const { return headers[block]; }
+
+		/// @brief getter for the loop nesting depth of a block, 0 outside of every loop
+		uint32_t loop_depth(uint32_t block) const { return depths[block]; }
+
+		/// @brief getter for the amount of loops in a function
+		uint32_t loop_count(uint32_t function) const { return loops[function]; }
+
+	private:
+		std::vector<uint32_t> idoms;
+		std::vector<uint32_t> headers;
+		std::vector<uint32_t> depths;
+		std::vector<uint32_t> loops;
+	};
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/function_map.h"
+
+namespace eagle::dasm
+{
+	/// @brief block graph of a single function with dense local block ids, the entry block is id 0
+	/// edges leaving the function, such as tail calls, are not part of the graph
+	class function_cfg
+	{
+	public:
+		/// @param blocks the recovered blocks
+		/// @param index index over the same blocks
+		/// @param functions the function partition of the blocks
+		/// @param function the function whose graph is built
+		function_cfg(const block_list& blocks, const block_index& index, const function_map& functions, uint32_t function)
+		{
+			const std::span<const uint32_t> members = functions.blocks(function);
+			globals.assign(members.begin(), members.end());
+
+			// local ids are looked up through a sorted copy instead of a map
+			std::vector<std::pair<uint32_t, uint32_t>> to_local;
+			to_local.reserve(globals.size());
+			for (uint32_t local = 0; local < globals.size(); local++)
+				to_local.push_back({ globals[local], local });
+
+			std::sort(to_local.begin(), to_local.end());
+
+			auto local_of = [&](uint32_t global)
+			{
+				auto it = std::lower_bound(to_local.begin(), to_local.end(), std::pair<uint32_t, uint32_t>(global, 0));
+				return it != to_local.end() && it->first == global ? it->second : block_index::npos;
+			};
+
+			std::vector<std::pair<uint32_t, uint32_t>> edges;
+			for (uint32_t local = 0; local < globals.size(); local++)
+			{
+				for_each_successor(blocks[globals[local]], index, [&](uint32_t successor)
+				{
+					const uint32_t target = local_of(successor);
+					if (target != block_index::npos)
+						edges.push_back({ local, target });
+				});
+			}
+
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			build_csr(edges, succ_offsets, succ_list, false);
+			build_csr(edges, pred_offsets, pred_list, true);
+		}
+
+		/// @brief getter for the amount of blocks in the function
+		size_t size() const { return globals.size(); }
+
+		/// @brief getter for the position of a local block in the block list
+		uint32_t block(uint32_t local) const { return globals[local]; }
+
+		/// @brief getter for the local successors of a block
+		std::span<const uint32_t> successors(uint32_t local) const
+		{
+			return std::span(succ_list).subspan(succ_offsets[local], succ_offsets[local + 1] - succ_offsets[local]);
+		}
+
+		/// @brief getter for the local predecessors of a block
+		std::span<const uint32_t> predecessors(uint32_t local) const
+		{
+			return std::span(pred_list).subspan(pred_offsets[local], pred_offsets[local + 1] - pred_offsets[local]);
+		}
+
+		/// @brief reverse post-order of the blocks reachable from the entry
+		std::vector<uint32_t> reverse_postorder() const
+		{
+			std::vector<uint32_t> order;
+			order.reserve(size());
+			if (size() == 0)
+				return order;
+
+			std::vector<bool> visited(size(), false);
+			std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+			visited[0] = true;
+
+			while (!stack.empty())
+			{
+				auto& [local, next] = stack.back();
+				const std::span<const uint32_t> succs = successors(local);
+				if (next < succs.size())
+				{
+					const uint32_t successor = succs[next++];
+					if (!visited[successor])
+					{
+						visited[successor] = true;
+						stack.push_back({ successor, 0 });
+					}
+
+					continue;
+				}
+
+				order.push_back(local);
+				stack.pop_back();
+			}
+
+			std::reverse(order.begin(), order.end());
+			return order;
+		}
+
+	private:
+		std::vector<uint32_t> globals;
+
+		std::vector<uint32_t> succ_offsets;
+		std::vector<uint32_t> succ_list;
+
+		std::vector<uint32_t> pred_offsets;
+		std::vector<uint32_t> pred_list;
+
+		void build_csr(const std::vector<std::pair<uint32_t, uint32_t>>& edges, std::vector<uint32_t>& offsets,
+			std::vector<uint32_t>& list, bool reverse) const
+		{
+			offsets.assign(size() + 1, 0);
+			for (const auto& [from, to] : edges)
+				offsets[(reverse ? to : from) + 1]++;
+
+			for (size_t local = 0; local < size(); local++)
+				offsets[local + 1] += offsets[local];
+
+			list.resize(edges.size());
+			std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (const auto& [from, to] : edges)
+				list[cursor[reverse ? to : from]++] = reverse ? from : to;
+		}
+	};
+}
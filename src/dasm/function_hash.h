@@ -0,0 +1,302 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <istream>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/function_map.h"
+#include "dasm/parallel.h"
+#include "dasm/stream_io.h"
+
+namespace eagle::dasm
+{
+	/// @brief hashes the bytes of functions with every address dependent field blanked out, so the same code
+	/// linked into different images at different addresses hashes the same
+	/// relative branch and call operands, rip relative displacements and absolute operands pointing into the image
+	/// are zeroed, branches staying inside of the function mix in their offset from the entry instead
+	class function_hasher
+	{
+	public:
+		/// @param data the bytes of the segment the blocks were decoded from
+		/// @param rva_begin the rva at which the first byte of the segment is mapped
+		/// @param image_base the preferred base of the image
+		/// @param image_size the size of the mapped image, absolute operands inside of it are treated as relocated
+		function_hasher(std::span<const uint8_t> data, uint32_t rva_begin, uint64_t image_base, uint32_t image_size)
+			: data(data), rva_begin(rva_begin), image_base(image_base), image_size(image_size)
+		{
+		}
+
+		/// @brief hashes a single function
+		/// @param blocks the recovered blocks
+		/// @param functions the function partition of the blocks
+		/// @param function the function to hash
+		/// @return the position independent hash
+		uint64_t hash(const block_list& blocks, const function_map& functions, uint32_t function) const
+		{
+			const std::span<const uint32_t> members = functions.blocks(function);
+			const uint32_t entry = functions.entry(function);
+
+			// blocks are hashed in address order, the order discovery found them in differs between images
+			std::vector<uint32_t> ordered(members.begin(), members.end());
+			std::sort(ordered.begin(), ordered.end(), [&](uint32_t a, uint32_t b)
+			{
+				return blocks[a].rva_begin < blocks[b].rva_begin;
+			});
+
+			uint32_t low = entry;
+			uint32_t high = entry;
+			for (uint32_t block : ordered)
+			{
+				low = std::min(low, blocks[block].rva_begin);
+				high = std::max(high, blocks[block].rva_end);
+			}
+
+			uint64_t h = offset_basis;
+			for (uint32_t block : ordered)
+			{
+				const basic_block& b = blocks[block];
+				h = mix(h, b.rva_begin - entry);
+
+				uint32_t rva = b.rva_begin;
+				for (const codec::dec::inst& inst : b.insts)
+				{
+					h = hash_inst(h, inst, rva, entry, low, high);
+					rva += inst.info.length;
+				}
+			}
+
+			return h;
+		}
+
+		/// @brief hashes every function in parallel
+		/// @return the hashes indexed by function
+		std::vector<uint64_t> hash_all(const block_list& blocks, const function_map& functions, size_t threads = 0) const
+		{
+			std::vector<uint64_t> hashes(functions.size());
+			parallel_for(functions.size(), [&](size_t function, size_t)
+			{
+				hashes[function] = hash(blocks, functions, static_cast<uint32_t>(function));
+			}, threads);
+
+			return hashes;
+		}
+
+	private:
+		static constexpr uint64_t offset_basis = 0xCBF29CE484222325;
+		static constexpr uint64_t prime = 0x100000001B3;
+
+		std::span<const uint8_t> data;
+		uint32_t rva_begin;
+		uint64_t image_base;
+		uint32_t image_size;
+
+		static uint64_t mix(uint64_t h, uint32_t value)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				h = (h ^ ((value >> (i * 8)) & 0xFF)) * prime;
+
+			return h;
+		}
+
+		bool in_image(uint64_t address) const
+		{
+			return address >= image_base && address - image_base < image_size;
+		}
+
+		uint64_t hash_inst(uint64_t h, const codec::dec::inst& inst, uint32_t rva, uint32_t entry, uint32_t low, uint32_t high) const
+		{
+			const uint8_t length = inst.info.length;
+			if (rva < rva_begin || rva - rva_begin + length > data.size())
+				return mix(h, inst.info.mnemonic);
+
+			std::array<uint8_t, 16> bytes = {};
+			std::memcpy(bytes.data(), data.data() + (rva - rva_begin), length);
+
+			auto blank = [&](uint8_t offset, uint8_t size)
+			{
+				if (size != 0 && offset + size / 8 <= length)
+					std::memset(bytes.data() + offset, 0, size / 8);
+			};
+
+			const uint32_t next_rva = rva + length;
+
+			bool absolute_disp = false;
+			for (uint8_t i = 0; i < inst.info.operand_count_visible; i++)
+			{
+				const codec::dec::operand& op = inst.operands[i];
+				if (op.type != ZYDIS_OPERAND_TYPE_MEMORY || !op.mem.disp.has_displacement)
+					continue;
+
+				// a displacement added to a base or index register is a stack or struct offset, never an address
+				const bool absolute = op.mem.base == ZYDIS_REGISTER_NONE && op.mem.index == ZYDIS_REGISTER_NONE;
+				if (op.mem.base == ZYDIS_REGISTER_RIP || (absolute && in_image(static_cast<uint64_t>(op.mem.disp.value))))
+					absolute_disp = true;
+			}
+
+			if (absolute_disp)
+				blank(inst.info.raw.disp.offset, inst.info.raw.disp.size);
+
+			for (const auto& imm : inst.info.raw.imm)
+			{
+				if (imm.size == 0)
+					continue;
+
+				if (imm.is_relative)
+				{
+					blank(imm.offset, imm.size);
+
+					// branches inside of the function keep their shape through the target offset
+					const uint32_t target = next_rva + static_cast<uint32_t>(imm.value.s);
+					h = mix(h, target >= low && target < high ? target - entry : 0xFFFFFFFF);
+				}
+				else if (in_image(imm.value.u))
+				{
+					blank(imm.offset, imm.size);
+				}
+			}
+
+			for (uint8_t i = 0; i < length; i++)
+				h = (h ^ bytes[i]) * prime;
+
+			return h;
+		}
+	};
+
+	/// @brief persistent map from function hashes to serialized analysis results, shared by every image of a batch
+	/// through batch_options::cache
+	/// lookups may run concurrently with each other, inserts take an exclusive lock
+	class function_cache
+	{
+	public:
+		function_cache() = default;
+
+		function_cache(function_cache&& other) noexcept
+		{
+			std::unique_lock lock(other.mutex);
+			entries = std::move(other.entries);
+			pool = std::move(other.pool);
+		}
+
+		/// @brief finds the stored result of a function
+		/// @param hash the position independent hash of the function
+		/// @return a copy of the stored bytes, nullopt if the function was not seen before
+		std::optional<std::vector<uint8_t>> find(uint64_t hash) const
+		{
+			std::shared_lock lock(mutex);
+
+			auto it = entries.find(hash);
+			if (it == entries.end())
+				return std::nullopt;
+
+			const auto first = pool.begin() + it->second.offset;
+			return std::vector<uint8_t>(first, first + it->second.size);
+		}
+
+		/// @brief stores the result of a function unless a result for its hash exists already
+		/// @return true if the result was stored
+		bool insert(uint64_t hash, std::span<const uint8_t> payload)
+		{
+			std::unique_lock lock(mutex);
+			if (entries.contains(hash))
+				return false;
+
+			entries.emplace(hash, entry { pool.size(), payload.size() });
+			pool.insert(pool.end(), payload.begin(), payload.end());
+			return true;
+		}
+
+		/// @brief getter for the amount of stored functions
+		size_t size() const
+		{
+			std::shared_lock lock(mutex);
+			return entries.size();
+		}
+
+		/// @brief writes the cache in its binary form
+		/// @param out the stream the cache is written to
+		/// @return true if the stream accepted all of the data
+		bool save(std::ostream& out) const
+		{
+			std::shared_lock lock(mutex);
+
+			std::vector<uint64_t> records;
+			records.reserve(entries.size() * 3);
+			for (const auto& [hash, e] : entries)
+				records.insert(records.end(), { hash, e.offset, e.size });
+
+			write_values(out, std::vector<uint64_t> { magic, version, entries.size(), pool.size() });
+			write_values(out, records);
+			write_values(out, pool);
+			return out.good();
+		}
+
+		/// @brief reads a cache written by save
+		/// @param in the stream the cache is read from
+		/// @return the cache, nullopt if the data is not a valid cache
+		static std::optional<function_cache> load(std::istream& in)
+		{
+			std::vector<uint64_t> header;
+			if (!read_values(in, header, 4) || header[0] != magic || header[1] != version)
+				return std::nullopt;
+
+			const uint64_t entry_count = header[2];
+			const uint64_t pool_size = header[3];
+
+			// counts of a corrupt header are rejected before anything is sized by them
+			constexpr uint64_t record_size = 3 * sizeof(uint64_t);
+			if (entry_count > UINT64_MAX / record_size)
+				return std::nullopt;
+
+			const std::optional<uint64_t> left = remaining_bytes(in);
+			if (left && (*left < entry_count * record_size || *left - entry_count * record_size < pool_size))
+				return std::nullopt;
+
+			std::vector<uint64_t> records;
+			if (!read_values(in, records, entry_count * 3))
+				return std::nullopt;
+
+			function_cache cache;
+			cache.entries.reserve(entry_count);
+			for (uint64_t i = 0; i < entry_count; i++)
+			{
+				const uint64_t hash = records[i * 3];
+				const uint64_t offset = records[i * 3 + 1];
+				const uint64_t size = records[i * 3 + 2];
+				if (size > pool_size || offset > pool_size - size)
+					return std::nullopt;
+
+				cache.entries.emplace(hash, entry { offset, size });
+			}
+
+			if (!read_values(in, cache.pool, pool_size))
+				return std::nullopt;
+
+			return cache;
+		}
+
+	private:
+		static constexpr uint64_t magic = 0x48534846; // FHSH
+		static constexpr uint64_t version = 1;
+
+		struct entry
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		mutable std::shared_mutex mutex;
+		std::unordered_map<uint64_t, entry> entries;
+		std::vector<uint8_t> pool;
+	};
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+
+namespace eagle::dasm
+{
+	/// @brief partitions recovered blocks into functions
+	/// functions start at the entry rvas and at every direct call target, a function owns the blocks reachable
+	/// from its entry through branches which no other function owns yet
+	class function_map
+	{
+	public:
+		/// @brief value returned when no function matches
+		static constexpr uint32_t npos = block_index::npos;
+
+		/// @param blocks the recovered blocks
+		/// @param index index over the same blocks
+		/// @param entries known function entries such as the image entry point and exports
+		function_map(const block_list& blocks, const block_index& index, std::span<const uint32_t> entries)
+		{
+			entry_rvas.assign(entries.begin(), entries.end());
+			for (const basic_block& block : blocks)
+			{
+				for (const call_site& call : block.calls)
+				{
+					if (call.kind == call_kind::direct)
+						entry_rvas.push_back(call.target);
+				}
+			}
+
+			std::sort(entry_rvas.begin(), entry_rvas.end());
+			entry_rvas.erase(std::unique(entry_rvas.begin(), entry_rvas.end()), entry_rvas.end());
+			std::erase_if(entry_rvas, [&](uint32_t rva) { return index.find(rva) == block_index::npos; });
+
+			// entry blocks are claimed first so walks stop at the boundary of other functions
+			owners.assign(blocks.size(), npos);
+			for (uint32_t function = 0; function < entry_rvas.size(); function++)
+				owners[index.find(entry_rvas[function])] = function;
+
+			std::vector<uint32_t> stack;
+			offsets.reserve(entry_rvas.size() + 1);
+			for (uint32_t function = 0; function < entry_rvas.size(); function++)
+			{
+				offsets.push_back(static_cast<uint32_t>(members.size()));
+
+				stack.push_back(index.find(entry_rvas[function]));
+				while (!stack.empty())
+				{
+					const uint32_t block = stack.back();
+					stack.pop_back();
+
+					members.push_back(block);
+					for_each_successor(blocks[block], index, [&](uint32_t successor)
+					{
+						if (owners[successor] != npos)
+							return;
+
+						owners[successor] = function;
+						stack.push_back(successor);
+					});
+				}
+			}
+
+			offsets.push_back(static_cast<uint32_t>(members.size()));
+		}
+
+		/// @brief getter for the amount of functions
+		size_t size() const { return entry_rvas.size(); }
+
+		/// @brief getter for the entry rva of a function
+		uint32_t entry(uint32_t function) const { return entry_rvas[function]; }
+
+		/// @brief getter for the entry rvas of all functions in ascending order
+		std::span<const uint32_t> entries() const { return entry_rvas; }
+
+		/// @brief getter for the blocks of a function, the entry block comes first
+		/// @return positions of the blocks in the block list
+		std::span<const uint32_t> blocks(uint32_t function) const
+		{
+			return std::span(members).subspan(offsets[function], offsets[function + 1] - offsets[function]);
+		}
+
+		/// @brief getter for the function which owns a block
+		/// @return the function, npos if no function reaches the block
+		uint32_t owner(uint32_t block) const { return owners[block]; }
+
+		/// @brief finds the function which starts at an rva
+		/// @return the function, npos if no function starts there
+		uint32_t find(uint32_t rva) const
+		{
+			auto it = std::lower_bound(entry_rvas.begin(), entry_rvas.end(), rva);
+			if (it == entry_rvas.end() || *it != rva)
+				return npos;
+
+			return static_cast<uint32_t>(it - entry_rvas.begin());
+		}
+
+	private:
+		std::vector<uint32_t> entry_rvas;
+		std::vector<uint32_t> owners;
+
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> members;
+	};
+}
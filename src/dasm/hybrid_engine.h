@@ -0,0 +1,446 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/byte_ownership.h"
+#include "dasm/discovery.h"
+#include "dasm/discovery_scheduler.h"
+#include "dasm/inst_util.h"
+#include "dasm/parallel.h"
+#include "dasm/rva_set.h"
+#include "dasm/segment_dasm.h"
+
+namespace eagle::dasm
+{
+	/// @brief range of bytes [rva_begin, rva_end) which no recovered block covers
+	struct code_gap
+	{
+		uint32_t rva_begin;
+		uint32_t rva_end;
+	};
+
+	/// @brief bitmap with one bit per byte of a segment, set for every byte a recovered block covers
+	class coverage_map
+	{
+	public:
+		coverage_map(uint32_t rva_begin, uint32_t rva_end)
+			: rva_begin(rva_begin), rva_end(rva_end), bits((rva_end - rva_begin + 63) / 64)
+		{
+		}
+
+		/// @brief marks the bytes of [begin, end) as covered
+		void mark(uint32_t begin, uint32_t end)
+		{
+			begin = std::max(begin, rva_begin);
+			end = std::min(end, rva_end);
+			for (uint32_t rva = begin; rva < end; rva++)
+				bits[(rva - rva_begin) / 64] |= 1ull << ((rva - rva_begin) % 64);
+		}
+
+		/// @brief checks if a byte is covered
+		bool covered(uint32_t rva) const
+		{
+			return bits[(rva - rva_begin) / 64] & (1ull << ((rva - rva_begin) % 64));
+		}
+
+		/// @brief getter for the amount of covered bytes
+		uint64_t covered_bytes() const
+		{
+			uint64_t count = 0;
+			for (uint64_t word : bits)
+				count += std::popcount(word);
+
+			return count;
+		}
+
+		/// @brief collects every uncovered range
+		/// @param min_size ranges smaller than this are skipped
+		/// @return the gaps in ascending order
+		std::vector<code_gap> gaps(uint32_t min_size) const
+		{
+			std::vector<code_gap> result;
+
+			uint32_t rva = rva_begin;
+			while (rva < rva_end)
+			{
+				if (covered(rva))
+				{
+					rva++;
+					continue;
+				}
+
+				code_gap gap{ rva, rva };
+				while (gap.rva_end < rva_end && !covered(gap.rva_end))
+					gap.rva_end++;
+
+				if (gap.rva_end - gap.rva_begin >= min_size)
+					result.push_back(gap);
+
+				rva = gap.rva_end;
+			}
+
+			return result;
+		}
+
+	private:
+		uint32_t rva_begin;
+		uint32_t rva_end;
+
+		std::vector<uint64_t> bits;
+	};
+
+	struct hybrid_options
+	{
+		/// @brief gaps smaller than this are treated as alignment and never swept
+		uint32_t min_gap = 4;
+
+		/// @brief rejected candidates move on to the next rva with this alignment
+		uint32_t candidate_alignment = 16;
+
+		/// @brief amount of instructions swept to judge a candidate
+		uint32_t sweep_insts = 64;
+
+		/// @brief highest allowed ratio of undecodable or junk instructions in a sweep
+		float max_invalid_density = 0.05f;
+
+		/// @brief score a candidate needs to be accepted as code
+		int32_t accept_score = 4;
+
+		/// @brief upper bound of sweep and descent rounds, a guard for reaching a fixed point since every round
+		/// queues every accepted candidate of every gap and stops once a round recovers nothing new
+		uint32_t max_passes = 8;
+	};
+
+	/// @brief discovers code by recursive descent first and then linearly sweeps the uncovered gaps in parallel,
+	/// candidates in the gaps are accepted or rejected by heuristics and accepted ones are descended again
+	class hybrid_engine
+	{
+	public:
+		/// @param data the bytes of the segment
+		/// @param rva_begin the rva at which the first byte of the segment is mapped
+		/// @param resource the resource backing the recovered blocks
+		/// @param options the gap filling heuristics
+		hybrid_engine(std::span<const uint8_t> data, uint32_t rva_begin,
+			std::pmr::memory_resource* resource, hybrid_options options = {})
+			: data(data), rva_begin(rva_begin), resource(resource), options(options),
+			  coverage(rva_begin, rva_begin + static_cast<uint32_t>(data.size())),
+			  ownership(std::in_place, rva_begin, rva_begin + static_cast<uint32_t>(data.size()))
+		{
+		}
+
+		/// @brief adds targets of code pointers found in data, see pointer_scanner, descended after the entries
+		/// the targets are used by the next run only
+		/// @param targets the pointed to rvas, targets outside of the segment are ignored
+		void add_pointer_targets(std::span<const uint32_t> targets)
+		{
+			pointer_targets.insert(pointer_targets.end(), targets.begin(), targets.end());
+		}
+
+		/// @brief recovers the blocks of the segment
+		/// @param entries the known entry rvas
+		/// @param on_block optional callback invoked with every block right after it is decoded
+		/// @return every recovered block
+		block_list run(std::span<const uint32_t> entries,
+			const std::function<void(const basic_block&)>& on_block = nullptr)
+		{
+			segment_dasm dasm(data, rva_begin);
+			dasm.set_resource(resource);
+			dasm.enable_timing();
+
+			// every run starts from nothing covered or owned, the maps of the previous run are dropped
+			coverage = coverage_map(dasm.get_rva_begin(), dasm.get_rva_end());
+			ownership.emplace(dasm.get_rva_begin(), dasm.get_rva_end());
+
+			block_list blocks(resource);
+			rva_set discovered(dasm.get_rva_begin(), dasm.get_rva_end());
+			discovery_scheduler scheduler(discovered);
+			for (uint32_t entry : entries)
+			{
+				if (dasm.contains(entry))
+					scheduler.push(entry, discovery_priority::entry);
+			}
+
+			// code pointers from data reach what branches cannot, every function they find is one gap less to sweep
+			std::vector<uint32_t> targets = std::exchange(pointer_targets, {});
+			std::erase_if(targets, [&](uint32_t rva) { return !dasm.contains(rva); });
+			scheduler.push_all(targets, discovery_priority::pointer);
+
+			recursive_descent(dasm, scheduler, blocks, on_block);
+
+			size_t marked_blocks = 0;
+			for (uint32_t pass = 0; pass < options.max_passes; pass++)
+			{
+				marked_blocks = mark_blocks(blocks, marked_blocks);
+
+				std::vector<code_gap> gaps = coverage.gaps(options.min_gap);
+				if (gaps.empty())
+					break;
+
+				// every gap is swept whole by its own dasm, results are written to the slot of the gap
+				std::vector<std::vector<uint32_t>> accepted(gaps.size());
+				parallel_for(gaps.size(), [&](size_t i, size_t)
+				{
+					segment_dasm gap_dasm(data, rva_begin);
+					accepted[i] = find_code(gap_dasm, gaps[i]);
+				});
+
+				// gap candidates are guesses, anything requested meanwhile still goes first
+				size_t candidates = 0;
+				for (const std::vector<uint32_t>& gap_candidates : accepted)
+				{
+					scheduler.push_all(gap_candidates, discovery_priority::speculative);
+					candidates += gap_candidates.size();
+				}
+
+				if (candidates == 0)
+					break;
+
+				const size_t block_count = blocks.size();
+				recursive_descent(dasm, scheduler, blocks, on_block);
+
+				if (blocks.size() == block_count)
+					break;
+			}
+
+			mark_blocks(blocks, marked_blocks);
+
+			counters = dasm.get_counters();
+			return blocks;
+		}
+
+		/// @brief getter for the coverage of the last run
+		/// @return the coverage map
+		const coverage_map& get_coverage() const { return coverage; }
+
+		/// @brief getter for the byte ownership of the last run, lists the instructions which overlap another stream
+		/// @return the ownership map
+		const byte_ownership& get_ownership() const { return *ownership; }
+
+		/// @brief getter for the decode counters of the descent in the last run
+		/// @return the counters, gap sweeps are not included
+		const decode_counters& get_counters() const { return counters; }
+
+	private:
+		std::span<const uint8_t> data;
+		uint32_t rva_begin;
+
+		std::pmr::memory_resource* resource;
+		hybrid_options options;
+
+		coverage_map coverage;
+
+		// byte_ownership holds a mutex and cannot be assigned, it is rebuilt in place instead
+		std::optional<byte_ownership> ownership;
+		decode_counters counters;
+		std::vector<uint32_t> pointer_targets;
+
+		/// @brief marks the coverage of every block from first on and claims the bytes of its instructions
+		/// blocks found by descent are claimed before the speculative ones, so the descended stream owns shared bytes
+		/// @return the amount of blocks marked so far
+		size_t mark_blocks(block_list& blocks, size_t first)
+		{
+			for (; first < blocks.size(); first++)
+			{
+				basic_block& block = blocks[first];
+				coverage.mark(block.rva_begin, block.rva_end);
+				block.overlapping = ownership->claim(block);
+			}
+
+			return first;
+		}
+
+		/// @brief sweeps a whole gap and collects every candidate which is accepted as code
+		/// accepted candidates are skipped up to the end of their code, rejected ones up to the next aligned rva
+		/// @return the rvas of the accepted candidates in ascending order
+		std::vector<uint32_t> find_code(segment_dasm& dasm, const code_gap& gap) const
+		{
+			std::vector<uint32_t> accepted;
+
+			uint32_t rva = gap.rva_begin;
+			while (rva < gap.rva_end)
+			{
+				rva = skip_padding(dasm, rva, gap.rva_end);
+				if (gap.rva_end - rva < options.min_gap)
+					break;
+
+				if (score_candidate(dasm, rva, gap.rva_end) >= options.accept_score)
+				{
+					accepted.push_back(rva);
+					rva = code_end(dasm, rva, gap.rva_end);
+					continue;
+				}
+
+				const uint32_t align = options.candidate_alignment;
+				rva = (rva + align) / align * align;
+			}
+
+			return accepted;
+		}
+
+		/// @brief linearly sweeps an accepted candidate up to where its code likely ends, which is a block end
+		/// followed by padding or by another prologue, or the first byte which does not decode
+		/// @return the rva after the code of the candidate, always past rva
+		uint32_t code_end(segment_dasm& dasm, uint32_t rva, uint32_t rva_end) const
+		{
+			uint32_t current = rva;
+			while (current < rva_end)
+			{
+				auto [inst, size, status] = dasm.decode_at(current);
+				if (status != decode_status::ok || current + size > rva_end)
+					break;
+
+				current += size;
+				if (!is_block_end(get_inst_flags(inst)) || current == rva_end)
+					continue;
+
+				if (skip_padding(dasm, current, rva_end) != current || score_prologue(current, rva_end) > 0)
+					break;
+			}
+
+			return std::max(current, rva + 1);
+		}
+
+		/// @brief skips int3, nop, zero and multi byte nop padding
+		/// @return the first rva after the padding
+		uint32_t skip_padding(segment_dasm& dasm, uint32_t rva, uint32_t rva_end) const
+		{
+			while (rva < rva_end)
+			{
+				const uint8_t byte = byte_at(rva);
+				if (byte == 0xCC || byte == 0x90 || byte == 0x00)
+				{
+					rva++;
+					continue;
+				}
+
+				// multi byte nops are 0f 1f with optional 66 prefixes
+				uint32_t opcode = rva;
+				while (opcode < rva_end && byte_at(opcode) == 0x66)
+					opcode++;
+
+				if (opcode + 1 < rva_end && byte_at(opcode) == 0x0F && byte_at(opcode + 1) == 0x1F)
+				{
+					auto [inst, size, status] = dasm.decode_at(rva);
+					if (status == decode_status::ok)
+					{
+						rva += size;
+						continue;
+					}
+				}
+
+				break;
+			}
+
+			return rva;
+		}
+
+		/// @brief scores common function prologues at an rva
+		int32_t score_prologue(uint32_t rva, uint32_t rva_end) const
+		{
+			struct prologue
+			{
+				std::array<uint8_t, 4> bytes;
+				uint8_t length;
+				int32_t score;
+			};
+
+			static constexpr prologue prologues[] = {
+				{ { 0x55, 0x48, 0x89, 0xE5 }, 4, 4 }, // push rbp; mov rbp, rsp
+				{ { 0x55, 0x48, 0x8B, 0xEC }, 4, 4 }, // push rbp; mov rbp, rsp
+				{ { 0x48, 0x89, 0x5C, 0x24 }, 4, 4 }, // mov [rsp+x], rbx
+				{ { 0x48, 0x89, 0x4C, 0x24 }, 4, 4 }, // mov [rsp+x], rcx
+				{ { 0x48, 0x83, 0xEC, 0x00 }, 3, 4 }, // sub rsp, imm8
+				{ { 0x48, 0x81, 0xEC, 0x00 }, 3, 4 }, // sub rsp, imm32
+				{ { 0x4C, 0x8B, 0xDC, 0x00 }, 3, 4 }, // mov r11, rsp
+				{ { 0x48, 0x8B, 0xC4, 0x00 }, 3, 4 }, // mov rax, rsp
+				{ { 0x40, 0x53, 0x00, 0x00 }, 2, 3 }, // push rbx
+				{ { 0xF3, 0x0F, 0x1E, 0xFA }, 4, 4 }, // endbr64
+				{ { 0x41, 0x57, 0x00, 0x00 }, 2, 2 }, // push r15
+				{ { 0x41, 0x56, 0x00, 0x00 }, 2, 2 }, // push r14
+				{ { 0x55, 0x00, 0x00, 0x00 }, 1, 1 }, // push rbp
+				{ { 0x53, 0x00, 0x00, 0x00 }, 1, 1 }, // push rbx
+			};
+
+			for (const prologue& candidate : prologues)
+			{
+				if (rva_end - rva < candidate.length)
+					continue;
+
+				bool matches = true;
+				for (uint8_t i = 0; i < candidate.length && matches; i++)
+					matches = byte_at(rva + i) == candidate.bytes[i];
+
+				if (matches)
+					return candidate.score;
+			}
+
+			return 0;
+		}
+
+		/// @brief linearly sweeps from a candidate and scores how much it looks like code
+		/// @return the score, negative if the candidate is rejected outright
+		int32_t score_candidate(segment_dasm& dasm, uint32_t rva, uint32_t rva_end) const
+		{
+			int32_t score = score_prologue(rva, rva_end);
+
+			uint32_t decoded = 0;
+			uint32_t invalid = 0;
+			bool ended = false;
+
+			uint32_t current = rva;
+			while (current < rva_end && decoded + invalid < options.sweep_insts)
+			{
+				auto [inst, size, status] = dasm.decode_at(current);
+				if (status != decode_status::ok)
+				{
+					invalid++;
+					current++;
+					continue;
+				}
+
+				// code running into bytes recovered by descent is not a real instruction stream
+				if (current + size > rva_end)
+					return -1;
+
+				// 00 00 decodes as add [rax], al and is the typical disguise of data
+				if (size == 2 && byte_at(current) == 0x00 && byte_at(current + 1) == 0x00)
+					invalid++;
+				else
+					decoded++;
+
+				current += size;
+				if (is_block_end(get_inst_flags(inst)))
+				{
+					ended = true;
+					break;
+				}
+			}
+
+			const uint32_t total = decoded + invalid;
+			if (total == 0 || static_cast<float>(invalid) / total > options.max_invalid_density)
+				return -1;
+
+			if (ended)
+				score += 2;
+
+			score += static_cast<int32_t>(std::min<uint32_t>(decoded / 4, 2));
+			return score;
+		}
+
+		uint8_t byte_at(uint32_t rva) const
+		{
+			return data[rva - rva_begin];
+		}
+	};
+}
@@ -0,0 +1,671 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "codec/zydis_defs.h"
+#include "dasm/basic_block.h"
+#include "dasm/parallel.h"
+
+namespace eagle::dasm
+{
+	/// @brief location at which an instruction query matched
+	struct query_match
+	{
+		uint32_t block;
+		uint32_t inst;
+		uint32_t rva;
+		uint32_t query;
+
+		/// @brief values bound to the captures of the query, in order of first appearance
+		std::array<uint64_t, 4> captures;
+	};
+
+	/// @brief runs instruction sequence patterns over decoded blocks
+	///
+	/// a pattern is a list of instructions separated by ';', each written as a mnemonic or '*' followed by
+	/// comma separated operands. operands are '*', 'reg', 'mem', 'imm', a register name, a number, a capture
+	/// or a memory operand '[base+index*scale+disp]' whose parts are again '*', a register, a number or a capture.
+	/// a second register term without a scale is the index with scale 1, omitted index and displacement parts must
+	/// be absent in the instruction. captures are identifiers starting with an upper case letter, the first use
+	/// binds them and later uses must match the same value, "mov R, [rip+X]; call R" finds calls through a register
+	/// loaded from memory. a rip relative displacement binds the referenced rva
+	///
+	/// queries are compiled into one automaton, a trie of steps whose common prefixes are shared between queries.
+	/// a block is matched in a single pass which advances every partial match by one instruction at a time
+	class inst_query
+	{
+	public:
+		/// @brief compiles and adds a pattern
+		/// @param pattern the pattern text
+		/// @return the id of the query, nullopt if the pattern is malformed
+		std::optional<uint32_t> add(std::string_view pattern)
+		{
+			query compiled;
+			std::vector<std::string> capture_names;
+
+			while (!pattern.empty())
+			{
+				const size_t split = std::min(pattern.find(';'), pattern.size());
+				const std::string_view statement = trim(pattern.substr(0, split));
+				pattern.remove_prefix(std::min(split + 1, pattern.size()));
+
+				if (statement.empty())
+					continue;
+
+				std::optional<step> parsed = parse_step(statement, capture_names);
+				if (!parsed)
+					return std::nullopt;
+
+				compiled.steps.push_back(*parsed);
+			}
+
+			if (compiled.steps.empty() || capture_names.size() > 4)
+				return std::nullopt;
+
+			uint32_t current = 0;
+			for (const step& s : compiled.steps)
+				current = find_or_add_state(current, s);
+
+			const uint32_t id = query_count++;
+			states[current].accepts.push_back(id);
+			return id;
+		}
+
+		/// @brief runs every query over every block in parallel
+		/// @param blocks the blocks to search
+		/// @param threads amount of threads, 0 uses parallel_threads()
+		/// @return the matches sorted by rva
+		std::vector<query_match> run(const block_list& blocks, size_t threads = 0) const
+		{
+			if (threads == 0)
+				threads = parallel_threads();
+
+			std::vector<std::vector<query_match>> found(threads);
+			parallel_for(blocks.size(), [&](size_t block, size_t thread)
+			{
+				run_block(blocks[block], static_cast<uint32_t>(block), found[thread]);
+			}, threads);
+
+			std::vector<query_match> matches;
+			for (const std::vector<query_match>& list : found)
+				matches.insert(matches.end(), list.begin(), list.end());
+
+			std::sort(matches.begin(), matches.end(), [](const query_match& a, const query_match& b)
+			{
+				return a.rva != b.rva ? a.rva < b.rva : a.query < b.query;
+			});
+
+			return matches;
+		}
+
+		/// @brief runs every query over a single block
+		/// @param block the block to search
+		/// @param block_id value stored as the block of the matches
+		/// @param matches list the matches are appended to
+		void run_block(const basic_block& block, uint32_t block_id, std::vector<query_match>& matches) const
+		{
+			std::vector<partial_match> active;
+			std::vector<partial_match> next;
+
+			uint32_t rva = block.rva_begin;
+			for (uint32_t i = 0; i < block.insts.size(); i++)
+			{
+				const codec::dec::inst& inst = block.insts[i];
+
+				// every instruction may start a match, it enters the automaton at the root
+				active.push_back({ 0, i, rva, {} });
+
+				next.clear();
+				for (const partial_match& partial : active)
+				{
+					const state& from = states[partial.state];
+					auto advance = [&](uint32_t to)
+					{
+						bindings bound = partial.bound;
+						if (!match_step(states[to].pattern, inst, rva, bound))
+							return;
+
+						for (uint32_t id : states[to].accepts)
+							matches.push_back({ block_id, partial.first, partial.rva, id, bound.values });
+
+						if (!states[to].by_mnemonic.empty() || !states[to].any_mnemonic.empty())
+							next.push_back({ to, partial.first, partial.rva, bound });
+					};
+
+					// only transitions whose step accepts the mnemonic are tried
+					auto by_mnemonic = from.by_mnemonic.find(inst.info.mnemonic);
+					if (by_mnemonic != from.by_mnemonic.end())
+					{
+						for (uint32_t to : by_mnemonic->second)
+							advance(to);
+					}
+
+					for (uint32_t to : from.any_mnemonic)
+						advance(to);
+				}
+
+				std::swap(active, next);
+				rva += inst.info.length;
+			}
+		}
+
+		/// @brief getter for the amount of queries
+		size_t size() const { return query_count; }
+
+	private:
+		enum class operand_kind : uint8_t
+		{
+			any,
+			any_reg,
+			any_mem,
+			any_imm,
+			reg,
+			imm,
+			mem,
+			capture,
+		};
+
+		enum class part_kind : uint8_t
+		{
+			any,
+			none,
+			reg,
+			value,
+			capture,
+		};
+
+		/// @brief base, index, scale or displacement of a memory operand pattern
+		struct part
+		{
+			part_kind kind = part_kind::any;
+			uint64_t value = 0;
+			uint8_t capture = 0;
+
+			bool operator==(const part&) const = default;
+		};
+
+		struct operand_pattern
+		{
+			operand_kind kind = operand_kind::any;
+			uint64_t value = 0;
+			uint8_t capture = 0;
+
+			part base;
+			part index;
+			part scale;
+			part disp;
+
+			bool operator==(const operand_pattern&) const = default;
+		};
+
+		struct step
+		{
+			bool any_mnemonic = false;
+			codec::mnemonic mnemonic{};
+
+			bool any_operands = true;
+			std::vector<operand_pattern> operands;
+
+			bool operator==(const step&) const = default;
+		};
+
+		struct query
+		{
+			std::vector<step> steps;
+		};
+
+		/// @brief state of the automaton, reached by matching the step of the state after the steps of its parents
+		struct state
+		{
+			step pattern;
+
+			/// @brief queries whose last step is this state
+			std::vector<uint32_t> accepts;
+
+			/// @brief following states whose step requires a mnemonic
+			std::unordered_map<uint16_t, std::vector<uint32_t>> by_mnemonic;
+
+			/// @brief following states whose step accepts any mnemonic
+			std::vector<uint32_t> any_mnemonic;
+		};
+
+		struct bindings
+		{
+			std::array<uint64_t, 4> values{};
+			uint8_t bound = 0;
+
+			bool bind(uint8_t capture, uint64_t value)
+			{
+				if (bound & (1 << capture))
+					return values[capture] == value;
+
+				bound |= 1 << capture;
+				values[capture] = value;
+				return true;
+			}
+		};
+
+		/// @brief match in progress, bound to the captures seen so far
+		struct partial_match
+		{
+			uint32_t state;
+			uint32_t first;
+			uint32_t rva;
+			bindings bound;
+		};
+
+		/// @brief the automaton, state 0 is the root which every match starts from
+		std::vector<state> states = std::vector<state>(1);
+		uint32_t query_count = 0;
+
+		/// @brief follows the transition for a step out of a state, adding the state it leads to if no query had the step yet
+		/// @return the state after the step
+		uint32_t find_or_add_state(uint32_t from, const step& pattern)
+		{
+			std::vector<uint32_t>& candidates = pattern.any_mnemonic
+				? states[from].any_mnemonic
+				: states[from].by_mnemonic[pattern.mnemonic];
+
+			for (uint32_t to : candidates)
+			{
+				if (states[to].pattern == pattern)
+					return to;
+			}
+
+			const uint32_t to = static_cast<uint32_t>(states.size());
+			candidates.push_back(to);
+
+			// candidates refers into states, the new state is only added once it is no longer used
+			states.push_back({ pattern, {}, {}, {} });
+			return to;
+		}
+
+		static bool match_step(const step& pattern, const codec::dec::inst& inst, uint32_t rva, bindings& bound)
+		{
+			if (!pattern.any_mnemonic && inst.info.mnemonic != pattern.mnemonic)
+				return false;
+
+			if (pattern.any_operands)
+				return true;
+
+			if (pattern.operands.size() != inst.info.operand_count_visible)
+				return false;
+
+			for (size_t i = 0; i < pattern.operands.size(); i++)
+			{
+				if (!match_operand(pattern.operands[i], inst, inst.operands[i], rva, bound))
+					return false;
+			}
+
+			return true;
+		}
+
+		static bool match_part(const part& pattern, uint64_t value, bindings& bound)
+		{
+			switch (pattern.kind)
+			{
+				case part_kind::any:
+					return true;
+				case part_kind::none:
+					return value == 0;
+				case part_kind::reg:
+				case part_kind::value:
+					return value == pattern.value;
+				case part_kind::capture:
+					return bound.bind(pattern.capture, value);
+			}
+
+			return false;
+		}
+
+		static bool match_operand(const operand_pattern& pattern, const codec::dec::inst& inst,
+			const codec::dec::operand& op, uint32_t rva, bindings& bound)
+		{
+			switch (pattern.kind)
+			{
+				case operand_kind::any:
+					return true;
+				case operand_kind::any_reg:
+					return op.type == ZYDIS_OPERAND_TYPE_REGISTER;
+				case operand_kind::any_mem:
+					return op.type == ZYDIS_OPERAND_TYPE_MEMORY;
+				case operand_kind::any_imm:
+					return op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE;
+				case operand_kind::reg:
+					return op.type == ZYDIS_OPERAND_TYPE_REGISTER && op.reg.value == pattern.value;
+				case operand_kind::imm:
+					return op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && op.imm.value.u == pattern.value;
+				case operand_kind::capture:
+					return bound.bind(pattern.capture, operand_key(op));
+				case operand_kind::mem:
+				{
+					if (op.type != ZYDIS_OPERAND_TYPE_MEMORY)
+						return false;
+
+					// rip relative displacements are matched as the rva they reference
+					uint64_t disp = static_cast<uint64_t>(op.mem.disp.value);
+					if (op.mem.base == ZYDIS_REGISTER_RIP)
+						disp = static_cast<uint32_t>(rva + inst.info.length + op.mem.disp.value);
+
+					return match_part(pattern.base, op.mem.base, bound) && match_part(pattern.index, op.mem.index, bound) &&
+						match_part(pattern.scale, op.mem.scale, bound) && match_part(pattern.disp, disp, bound);
+				}
+			}
+
+			return false;
+		}
+
+		/// @brief value an operand binds to a capture, tagged with its type so a register never equals an immediate
+		static uint64_t operand_key(const codec::dec::operand& op)
+		{
+			switch (op.type)
+			{
+				case ZYDIS_OPERAND_TYPE_REGISTER:
+					return 1ull << 62 | op.reg.value;
+				case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+					return op.imm.value.u & ~(3ull << 62);
+				case ZYDIS_OPERAND_TYPE_MEMORY:
+					return 2ull << 62 | static_cast<uint64_t>(op.mem.base) << 48 | static_cast<uint64_t>(op.mem.index) << 32 |
+						static_cast<uint32_t>(op.mem.disp.value);
+				default:
+					return 3ull << 62;
+			}
+		}
+
+		static std::string_view trim(std::string_view text)
+		{
+			const size_t begin = text.find_first_not_of(" \t");
+			if (begin == std::string_view::npos)
+				return {};
+
+			const size_t end = text.find_last_not_of(" \t");
+			return text.substr(begin, end - begin + 1);
+		}
+
+		static std::string lower(std::string_view text)
+		{
+			std::string result(text);
+			for (char& c : result)
+				c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+			return result;
+		}
+
+		static std::optional<codec::mnemonic> find_mnemonic(std::string_view name)
+		{
+			static const std::unordered_map<std::string, codec::mnemonic> table = []
+			{
+				std::unordered_map<std::string, codec::mnemonic> result;
+				for (uint32_t i = 1; i <= ZYDIS_MNEMONIC_MAX_VALUE; i++)
+				{
+					const auto mnemonic = static_cast<codec::mnemonic>(i);
+					if (const char* string = ZydisMnemonicGetString(mnemonic))
+						result.emplace(string, mnemonic);
+				}
+
+				return result;
+			}();
+
+			auto it = table.find(lower(name));
+			if (it == table.end())
+				return std::nullopt;
+
+			return it->second;
+		}
+
+		static std::optional<codec::reg> find_register(std::string_view name)
+		{
+			static const std::unordered_map<std::string, codec::reg> table = []
+			{
+				std::unordered_map<std::string, codec::reg> result;
+				for (uint32_t i = 1; i <= ZYDIS_REGISTER_MAX_VALUE; i++)
+				{
+					const auto reg = static_cast<codec::reg>(i);
+					if (const char* string = ZydisRegisterGetString(reg))
+						result.emplace(string, reg);
+				}
+
+				return result;
+			}();
+
+			auto it = table.find(lower(name));
+			if (it == table.end())
+				return std::nullopt;
+
+			return it->second;
+		}
+
+		static std::optional<uint64_t> parse_number(std::string_view text)
+		{
+			int base = 10;
+			if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+			{
+				text.remove_prefix(2);
+				base = 16;
+			}
+
+			uint64_t value = 0;
+			auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+			if (error != std::errc() || end != text.data() + text.size())
+				return std::nullopt;
+
+			return value;
+		}
+
+		static bool is_capture(std::string_view text)
+		{
+			return !text.empty() && std::isupper(static_cast<unsigned char>(text[0]));
+		}
+
+		static uint8_t capture_slot(std::string_view name, std::vector<std::string>& names)
+		{
+			auto it = std::find(names.begin(), names.end(), name);
+			if (it != names.end())
+				return static_cast<uint8_t>(it - names.begin());
+
+			names.emplace_back(name);
+			return static_cast<uint8_t>(names.size() - 1);
+		}
+
+		static std::optional<part> parse_part(std::string_view text, std::vector<std::string>& names)
+		{
+			part result;
+			if (text == "*")
+				return result;
+
+			if (is_capture(text))
+			{
+				result.kind = part_kind::capture;
+				result.capture = capture_slot(text, names);
+				return result;
+			}
+
+			if (std::optional<codec::reg> reg = find_register(text))
+			{
+				result.kind = part_kind::reg;
+				result.value = *reg;
+				return result;
+			}
+
+			if (std::optional<uint64_t> value = parse_number(text))
+			{
+				result.kind = part_kind::value;
+				result.value = *value;
+				return result;
+			}
+
+			return std::nullopt;
+		}
+
+		/// @brief parses the terms of a memory operand between its brackets
+		static std::optional<operand_pattern> parse_memory(std::string_view inner, std::vector<std::string>& names)
+		{
+			operand_pattern result;
+			result.kind = operand_kind::mem;
+			result.index.kind = part_kind::none;
+			result.disp.kind = part_kind::none;
+
+			bool has_base = false;
+			bool has_index = false;
+			bool has_disp = false;
+
+			while (true)
+			{
+				const size_t plus = inner.find('+');
+				const std::string_view term = trim(inner.substr(0, plus));
+				if (term.empty())
+					return std::nullopt;
+
+				// index*scale, a lone '*' is a wildcard term
+				const size_t star = term.size() > 1 ? term.find('*') : std::string_view::npos;
+				if (star != std::string_view::npos)
+				{
+					std::optional<part> index = parse_part(trim(term.substr(0, star)), names);
+					std::optional<part> scale = parse_part(trim(term.substr(star + 1)), names);
+					if (has_index || !index || !scale)
+						return std::nullopt;
+
+					result.index = *index;
+					result.scale = *scale;
+					has_index = true;
+				}
+				else
+				{
+					std::optional<part> value = parse_part(term, names);
+					if (!value)
+						return std::nullopt;
+
+					if (!has_base)
+					{
+						result.base = *value;
+						has_base = true;
+					}
+					else if (!has_index && !has_disp && value->kind == part_kind::reg)
+					{
+						result.index = *value;
+						result.scale = { part_kind::value, 1 };
+						has_index = true;
+					}
+					else if (!has_disp)
+					{
+						result.disp = *value;
+						has_disp = true;
+					}
+					else
+					{
+						return std::nullopt;
+					}
+				}
+
+				if (plus == std::string_view::npos)
+					break;
+
+				inner.remove_prefix(plus + 1);
+			}
+
+			return result;
+		}
+
+		static std::optional<operand_pattern> parse_operand(std::string_view text, std::vector<std::string>& names)
+		{
+			operand_pattern result;
+			if (text.empty())
+				return std::nullopt;
+
+			if (text == "*")
+				return result;
+
+			if (text == "reg" || text == "mem" || text == "imm")
+			{
+				result.kind = text == "reg" ? operand_kind::any_reg : text == "mem" ? operand_kind::any_mem : operand_kind::any_imm;
+				return result;
+			}
+
+			if (text.front() == '[' && text.back() == ']')
+			{
+				std::optional<operand_pattern> memory = parse_memory(trim(text.substr(1, text.size() - 2)), names);
+				if (!memory)
+					return std::nullopt;
+
+				result = *memory;
+				return result;
+			}
+
+			if (is_capture(text))
+			{
+				result.kind = operand_kind::capture;
+				result.capture = capture_slot(text, names);
+				return result;
+			}
+
+			if (std::optional<codec::reg> reg = find_register(text))
+			{
+				result.kind = operand_kind::reg;
+				result.value = *reg;
+				return result;
+			}
+
+			if (std::optional<uint64_t> value = parse_number(text))
+			{
+				result.kind = operand_kind::imm;
+				result.value = *value;
+				return result;
+			}
+
+			return std::nullopt;
+		}
+
+		static std::optional<step> parse_step(std::string_view statement, std::vector<std::string>& names)
+		{
+			step result;
+
+			const size_t split = std::min(statement.find_first_of(" \t"), statement.size());
+			const std::string_view mnemonic = statement.substr(0, split);
+			std::string_view operands = trim(statement.substr(split));
+
+			if (mnemonic == "*")
+			{
+				result.any_mnemonic = true;
+			}
+			else
+			{
+				std::optional<codec::mnemonic> found = find_mnemonic(mnemonic);
+				if (!found)
+					return std::nullopt;
+
+				result.mnemonic = *found;
+			}
+
+			if (operands.empty())
+				return result;
+
+			// a leading, trailing or doubled comma leaves an empty operand which parse_operand rejects
+			result.any_operands = false;
+			while (true)
+			{
+				const size_t comma = operands.find(',');
+				std::optional<operand_pattern> operand = parse_operand(trim(operands.substr(0, comma)), names);
+				if (!operand)
+					return std::nullopt;
+
+				result.operands.push_back(*operand);
+				if (comma == std::string_view::npos)
+					break;
+
+				operands.remove_prefix(comma + 1);
+			}
+
+			return result;
+		}
+	};
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstdint>
+
+#include "codec/zydis_defs.h"
+#include "dasm/basic_block.h"
+
+namespace eagle::dasm
+{
+	/// @brief summary bits of a decoded instruction, small enough to be stored next to every instruction
+	enum inst_flags : uint16_t
+	{
+		inst_flag_none = 0,
+		inst_flag_cond_branch = 1 << 0,
+		inst_flag_uncond_branch = 1 << 1,
+		inst_flag_call = 1 << 2,
+		inst_flag_ret = 1 << 3,
+		inst_flag_interrupt = 1 << 4,
+		inst_flag_relative = 1 << 5,
+		inst_flag_memory = 1 << 6,
+		inst_flag_rip_relative = 1 << 7,
+	};
+
+	/// @brief computes the summary flags of a decoded instruction
+	/// @param inst the decoded instruction
+	/// @return mask of inst_flags
+	inline uint16_t get_inst_flags(const codec::dec::inst& inst)
+	{
+		uint16_t flags = inst_flag_none;
+		switch (inst.info.meta.category)
+		{
+			case ZYDIS_CATEGORY_COND_BR:
+				flags |= inst_flag_cond_branch;
+				break;
+			case ZYDIS_CATEGORY_UNCOND_BR:
+				flags |= inst_flag_uncond_branch;
+				break;
+			case ZYDIS_CATEGORY_CALL:
+				flags |= inst_flag_call;
+				break;
+			case ZYDIS_CATEGORY_RET:
+				flags |= inst_flag_ret;
+				break;
+			case ZYDIS_CATEGORY_INTERRUPT:
+				flags |= inst_flag_interrupt;
+				break;
+			default:
+				break;
+		}
+
+		if (inst.info.attributes & ZYDIS_ATTRIB_IS_RELATIVE)
+			flags |= inst_flag_relative;
+
+		for (uint8_t i = 0; i < inst.info.operand_count; i++)
+		{
+			const codec::dec::operand& op = inst.operands[i];
+			if (op.type != ZYDIS_OPERAND_TYPE_MEMORY)
+				continue;
+
+			flags |= inst_flag_memory;
+			if (op.mem.base == ZYDIS_REGISTER_RIP)
+				flags |= inst_flag_rip_relative;
+		}
+
+		return flags;
+	}
+
+	/// @brief checks if an instruction ends a basic block
+	/// @param flags the inst_flags of the instruction
+	/// @return true for jumps, conditional jumps and returns
+	inline bool is_block_end(uint16_t flags)
+	{
+		return flags & (inst_flag_cond_branch | inst_flag_uncond_branch | inst_flag_ret);
+	}
+
+	/// @brief resolves where a call instruction goes
+	/// @param inst the decoded call instruction
+	/// @param rva the rva of the instruction
+	/// @return the call site, relative calls are direct and rip relative memory calls go through a slot
+	inline call_site get_call_site(const codec::dec::inst& inst, uint32_t rva)
+	{
+		call_site site{ rva, no_branch, call_kind::indirect };
+
+		const uint32_t next_rva = rva + inst.info.length;
+		for (uint8_t i = 0; i < inst.info.operand_count_visible; i++)
+		{
+			const codec::dec::operand& op = inst.operands[i];
+			if (op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && op.imm.is_relative)
+			{
+				site.target = next_rva + static_cast<uint32_t>(op.imm.value.s);
+				site.kind = call_kind::direct;
+			}
+			else if (op.type == ZYDIS_OPERAND_TYPE_MEMORY && op.mem.base == ZYDIS_REGISTER_RIP &&
+				op.mem.index == ZYDIS_REGISTER_NONE)
+			{
+				site.target = next_rva + static_cast<uint32_t>(op.mem.disp.value);
+				site.kind = call_kind::slot;
+			}
+		}
+
+		return site;
+	}
+
+	enum class ref_kind : uint8_t
+	{
+		/// @brief target of a relative jump or conditional jump
+		branch,
+
+		/// @brief target of a relative call
+		call,
+
+		/// @brief rip relative memory operand or address computation
+		rip_relative,
+
+		/// @brief absolute memory displacement without base or index register
+		displacement,
+
+		/// @brief absolute immediate pointing into the image, such as the address of a string pushed as an argument
+		immediate,
+	};
+
+	/// @brief calls fn(target, kind) for every address an instruction refers to
+	/// @param inst the decoded instruction
+	/// @param rva the rva of the instruction
+	/// @param image_base the preferred base of the image, absolute displacements are rebased with it
+	/// @param image_size immediates inside of [image_base, image_base + image_size) are references, 0 ignores immediates
+	/// @param fn callable taking the target rva and the ref_kind
+	template <typename function>
+	void for_each_reference(const codec::dec::inst& inst, uint32_t rva, uint64_t image_base, uint32_t image_size,
+		function&& fn)
+	{
+		const uint32_t next_rva = rva + inst.info.length;
+		const bool is_call = inst.info.meta.category == ZYDIS_CATEGORY_CALL;
+
+		for (uint8_t i = 0; i < inst.info.operand_count_visible; i++)
+		{
+			const codec::dec::operand& op = inst.operands[i];
+			if (op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && op.imm.is_relative)
+			{
+				fn(next_rva + static_cast<uint32_t>(op.imm.value.s), is_call ? ref_kind::call : ref_kind::branch);
+			}
+			else if (op.type == ZYDIS_OPERAND_TYPE_MEMORY)
+			{
+				if (op.mem.base == ZYDIS_REGISTER_RIP)
+				{
+					fn(next_rva + static_cast<uint32_t>(op.mem.disp.value), ref_kind::rip_relative);
+				}
+				else if (op.mem.base == ZYDIS_REGISTER_NONE && op.mem.index == ZYDIS_REGISTER_NONE)
+				{
+					const uint64_t address = static_cast<uint64_t>(op.mem.disp.value);
+					if (address >= image_base && address - image_base <= 0xFFFFFFFF)
+						fn(static_cast<uint32_t>(address - image_base), ref_kind::displacement);
+				}
+			}
+			else if (op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && image_size != 0)
+			{
+				// small constants collide with a zero based image, only values inside of the image count
+				const uint64_t address = op.imm.value.u;
+				if (address >= image_base && address - image_base < image_size)
+					fn(static_cast<uint32_t>(address - image_base), ref_kind::immediate);
+			}
+		}
+	}
+
+	/// @brief bits of the register masks, general purpose registers are bits 0-15 in encoding order,
+	/// the flags are bit 16 and vector registers 0-31 are bits 32-63
+	enum reg_mask : uint64_t
+	{
+		reg_mask_none = 0,
+		reg_mask_gpr = 0xFFFF,
+		reg_mask_flags = 1ull << 16,
+		reg_mask_vector = 0xFFFFFFFFull << 32,
+	};
+
+	/// @brief maps a register to its bit in the register masks, partial registers map to their full register
+	/// @param reg the register
+	/// @return the bit of the register, 0 for registers which are not tracked such as rip or segments
+	inline uint64_t get_reg_mask(codec::reg reg)
+	{
+		if (reg == ZYDIS_REGISTER_NONE)
+			return 0;
+
+		const codec::reg full = ZydisRegisterGetLargestEnclosing(ZYDIS_MACHINE_MODE_LONG_64, reg);
+		switch (ZydisRegisterGetClass(full))
+		{
+			case ZYDIS_REGCLASS_GPR64:
+				return 1ull << ZydisRegisterGetId(full);
+			case ZYDIS_REGCLASS_XMM:
+			case ZYDIS_REGCLASS_YMM:
+			case ZYDIS_REGCLASS_ZMM:
+				return 1ull << (32 + ZydisRegisterGetId(full));
+			case ZYDIS_REGCLASS_FLAGS:
+				return reg_mask_flags;
+			default:
+				return 0;
+		}
+	}
+
+	/// @brief computes the registers an instruction reads and writes, including hidden operands and flags
+	/// writes of 8 and 16 bit registers keep the rest of the register alive and count as a read as well
+	/// @param inst the decoded instruction
+	/// @return the use and def masks
+	inline inst_regs get_inst_regs(const codec::dec::inst& inst)
+	{
+		inst_regs regs{ 0, 0 };
+		for (uint8_t i = 0; i < inst.info.operand_count; i++)
+		{
+			const codec::dec::operand& op = inst.operands[i];
+			if (op.type == ZYDIS_OPERAND_TYPE_REGISTER)
+			{
+				const uint64_t mask = get_reg_mask(op.reg.value);
+				if (op.actions & ZYDIS_OPERAND_ACTION_MASK_READ)
+					regs.use |= mask;
+
+				if (op.actions & ZYDIS_OPERAND_ACTION_WRITE)
+				{
+					const bool partial = (mask & reg_mask_gpr) && op.size < 32;
+					if (partial)
+						regs.use |= mask;
+
+					regs.def |= mask;
+				}
+			}
+			else if (op.type == ZYDIS_OPERAND_TYPE_MEMORY)
+			{
+				regs.use |= get_reg_mask(op.mem.base) | get_reg_mask(op.mem.index);
+			}
+		}
+
+		if (inst.info.cpu_flags)
+		{
+			if (inst.info.cpu_flags->tested)
+				regs.use |= reg_mask_flags;
+
+			// flags are tracked as a single register, it only dies if every status flag (cf pf af zf sf of) is written
+			constexpr ZydisCPUFlags status_flags = 0x8D5;
+
+			const ZydisAccessedFlags& flags = *inst.info.cpu_flags;
+			if (((flags.modified | flags.set_0 | flags.set_1 | flags.undefined) & status_flags) == status_flags)
+				regs.def |= reg_mask_flags;
+		}
+
+		return regs;
+	}
+}
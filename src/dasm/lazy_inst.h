@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <memory_resource>
+#include <vector>
+
+#include "codec/zydis_defs.h"
+#include "dasm/basic_block.h"
+#include "dasm/inst_util.h"
+#include "dasm/small_vector.h"
+
+namespace eagle::dasm
+{
+	/// @brief instruction whose header was decoded eagerly while its operands are decoded on first access
+	/// the decoder context saved with the header holds the prefix, opcode and modrm state, so materializing the
+	/// operands does not decode the instruction bytes again. the header is a fraction of a full codec::dec::inst
+	class lazy_inst
+	{
+	public:
+		using allocator_type = std::pmr::polymorphic_allocator<>;
+
+		/// @brief the decoded header, mnemonic, length, category, attributes and raw fields are valid
+		ZydisDecodedInstruction info = {};
+
+		lazy_inst() = default;
+
+		explicit lazy_inst(const allocator_type& alloc)
+			: resource(alloc.resource())
+		{
+		}
+
+		/// @param info the decoded header
+		/// @param context the decoder state ZydisDecoderDecodeInstruction left behind for this instruction
+		/// @param alloc the resource the operands are allocated from once they are decoded
+		lazy_inst(const ZydisDecodedInstruction& info, const ZydisDecoderContext& context, const allocator_type& alloc = {})
+			: info(info), context(context), resource(alloc.resource())
+		{
+		}
+
+		// copies decode their own operands again, the cache belongs to a single instruction
+		lazy_inst(const lazy_inst& other, const allocator_type& alloc = {})
+			: info(other.info), context(other.context), resource(alloc.resource())
+		{
+		}
+
+		lazy_inst(lazy_inst&& other) noexcept
+			: info(other.info), context(other.context), resource(other.resource),
+			  cached(other.cached.exchange(nullptr, std::memory_order_acq_rel))
+		{
+		}
+
+		// the cache only moves between instructions of the same resource, others decode again
+		lazy_inst(lazy_inst&& other, const allocator_type& alloc)
+			: info(other.info), context(other.context), resource(alloc.resource())
+		{
+			if (resource->is_equal(*other.resource))
+				cached.store(other.cached.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_relaxed);
+		}
+
+		lazy_inst& operator=(const lazy_inst& other)
+		{
+			if (this != &other)
+			{
+				release();
+				info = other.info;
+				context = other.context;
+			}
+
+			return *this;
+		}
+
+		lazy_inst& operator=(lazy_inst&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				info = other.info;
+				context = other.context;
+
+				if (resource->is_equal(*other.resource))
+					cached.store(other.cached.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_release);
+			}
+
+			return *this;
+		}
+
+		~lazy_inst()
+		{
+			release();
+		}
+
+		/// @brief getter for the operands, the first call decodes them and later calls return the cached ones
+		/// concurrent first calls may decode twice, only one result is kept
+		/// @return info.operand_count operands, nullptr if the codec rejects the saved state
+		const codec::dec::operand* operands() const
+		{
+			if (const codec::dec::operand* existing = cached.load(std::memory_order_acquire))
+				return existing;
+
+			// only the operands the instruction has are stored, arena resources make the free a no-op
+			auto* decoded = static_cast<codec::dec::operand*>(resource->allocate(cache_bytes(), alignof(codec::dec::operand)));
+			if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(&decoder(), &context, &info, decoded, info.operand_count)))
+			{
+				resource->deallocate(decoded, cache_bytes(), alignof(codec::dec::operand));
+				return nullptr;
+			}
+
+			codec::dec::operand* expected = nullptr;
+			if (!cached.compare_exchange_strong(expected, decoded, std::memory_order_acq_rel))
+			{
+				resource->deallocate(decoded, cache_bytes(), alignof(codec::dec::operand));
+				return expected;
+			}
+
+			return decoded;
+		}
+
+		/// @brief checks if the operands were decoded already
+		bool materialized() const { return cached.load(std::memory_order_acquire) != nullptr; }
+
+		/// @brief builds the full instruction for consumers of codec::dec::inst
+		/// @param rva the rva of the instruction, stored as its runtime address
+		/// @return the instruction with every operand, the formatted text is left empty
+		codec::dec::inst materialize(uint32_t rva) const
+		{
+			codec::dec::inst inst = {};
+			inst.runtime_address = rva;
+			inst.info = info;
+
+			if (const codec::dec::operand* ops = operands())
+			{
+				for (uint8_t i = 0; i < info.operand_count; i++)
+					inst.operands[i] = ops[i];
+			}
+
+			return inst;
+		}
+
+		/// @brief decoder shared by every lazy instruction, operand decoding only reads it
+		static const ZydisDecoder& decoder()
+		{
+			static const ZydisDecoder instance = []
+			{
+				ZydisDecoder result;
+				ZydisDecoderInit(&result, ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_STACK_WIDTH_64);
+				return result;
+			}();
+
+			return instance;
+		}
+
+	private:
+		ZydisDecoderContext context = {};
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+		mutable std::atomic<codec::dec::operand*> cached = nullptr;
+
+		/// @brief getter for the size of the operand cache, instructions without operands still get one slot
+		size_t cache_bytes() const
+		{
+			return std::max<size_t>(info.operand_count, 1) * sizeof(codec::dec::operand);
+		}
+
+		void release()
+		{
+			if (codec::dec::operand* existing = cached.exchange(nullptr, std::memory_order_acq_rel))
+				resource->deallocate(existing, cache_bytes(), alignof(codec::dec::operand));
+		}
+	};
+
+	/// @brief computes the control flow part of the inst_flags from the header alone
+	/// @param info the decoded header
+	/// @return mask of inst_flags, the memory flags are never set since they depend on operands
+	inline uint16_t get_header_flags(const ZydisDecodedInstruction& info)
+	{
+		uint16_t flags = inst_flag_none;
+		switch (info.meta.category)
+		{
+			case ZYDIS_CATEGORY_COND_BR:
+				flags |= inst_flag_cond_branch;
+				break;
+			case ZYDIS_CATEGORY_UNCOND_BR:
+				flags |= inst_flag_uncond_branch;
+				break;
+			case ZYDIS_CATEGORY_CALL:
+				flags |= inst_flag_call;
+				break;
+			case ZYDIS_CATEGORY_RET:
+				flags |= inst_flag_ret;
+				break;
+			case ZYDIS_CATEGORY_INTERRUPT:
+				flags |= inst_flag_interrupt;
+				break;
+			default:
+				break;
+		}
+
+		if (info.attributes & ZYDIS_ATTRIB_IS_RELATIVE)
+			flags |= inst_flag_relative;
+
+		return flags;
+	}
+
+	/// @brief basic block whose instructions are lazy_inst, for consumers which mostly read mnemonics and lengths
+	/// call sites are resolved while decoding, which materializes the operands of call instructions only
+	struct lazy_block
+	{
+		using allocator_type = std::pmr::polymorphic_allocator<>;
+
+		uint32_t rva_begin = 0, rva_end = 0;
+		uint32_t branch_one = no_branch, branch_two = no_branch;
+
+		/// @brief why decoding stopped before a terminator, ok for complete blocks
+		decode_status status = decode_status::ok;
+
+		std::pmr::vector<lazy_inst> insts;
+		small_vector<call_site, 2> calls;
+
+		lazy_block() = default;
+		lazy_block(const lazy_block&) = default;
+		lazy_block(lazy_block&&) = default;
+		lazy_block& operator=(const lazy_block&) = default;
+		lazy_block& operator=(lazy_block&&) = default;
+
+		explicit lazy_block(const allocator_type& alloc)
+			: insts(alloc), calls(alloc)
+		{
+		}
+
+		lazy_block(const lazy_block& other, const allocator_type& alloc)
+			: rva_begin(other.rva_begin), rva_end(other.rva_end),
+			  branch_one(other.branch_one), branch_two(other.branch_two), status(other.status),
+			  insts(other.insts, alloc), calls(other.calls, alloc)
+		{
+		}
+
+		lazy_block(lazy_block&& other, const allocator_type& alloc)
+			: rva_begin(other.rva_begin), rva_end(other.rva_end),
+			  branch_one(other.branch_one), branch_two(other.branch_two), status(other.status),
+			  insts(std::move(other.insts), alloc), calls(std::move(other.calls), alloc)
+		{
+		}
+
+		allocator_type get_allocator() const { return insts.get_allocator(); }
+	};
+
+	/// @brief list of lazy blocks recovered by an analysis, constructed over the analysis arena
+	using lazy_block_list = std::pmr::vector<lazy_block>;
+}
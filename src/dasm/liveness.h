@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstdint>
+
+#include <deque>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/inst_util.h"
+
+namespace eagle::dasm
+{
+	/// @brief calling convention assumptions liveness needs where the block graph ends
+	struct liveness_abi
+	{
+		/// @brief registers a call reads, the arguments and the stack pointer
+		uint64_t call_uses;
+
+		/// @brief registers a call destroys
+		uint64_t call_clobbers;
+
+		/// @brief registers still live when a function returns, the return value and callee saved registers
+		uint64_t exit_live;
+
+		static constexpr uint64_t gpr(uint32_t id) { return 1ull << id; }
+		static constexpr uint64_t vector(uint32_t id) { return 1ull << (32 + id); }
+
+		static constexpr uint64_t vector_range(uint32_t first, uint32_t last)
+		{
+			uint64_t mask = 0;
+			for (uint32_t id = first; id <= last; id++)
+				mask |= vector(id);
+
+			return mask;
+		}
+
+		/// @brief microsoft x64 calling convention
+		static constexpr liveness_abi win64()
+		{
+			// rax 0, rcx 1, rdx 2, rbx 3, rsp 4, rbp 5, rsi 6, rdi 7, r8-r15 8-15
+			return {
+				gpr(1) | gpr(2) | gpr(8) | gpr(9) | gpr(4) | vector_range(0, 3),
+				gpr(0) | gpr(1) | gpr(2) | gpr(8) | gpr(9) | gpr(10) | gpr(11) | vector_range(0, 5) | reg_mask_flags,
+				gpr(0) | gpr(3) | gpr(4) | gpr(5) | gpr(6) | gpr(7) | gpr(12) | gpr(13) | gpr(14) | gpr(15) |
+					vector(0) | vector_range(6, 15),
+			};
+		}
+
+		/// @brief system v amd64 calling convention
+		static constexpr liveness_abi sysv()
+		{
+			return {
+				gpr(7) | gpr(6) | gpr(2) | gpr(1) | gpr(8) | gpr(9) | gpr(4) | vector_range(0, 7),
+				gpr(0) | gpr(1) | gpr(2) | gpr(6) | gpr(7) | gpr(8) | gpr(9) | gpr(10) | gpr(11) |
+					vector_range(0, 31) | reg_mask_flags,
+				gpr(0) | gpr(2) | gpr(3) | gpr(4) | gpr(5) | gpr(12) | gpr(13) | gpr(14) | gpr(15) | vector_range(0, 1),
+			};
+		}
+	};
+
+	/// @brief backward register liveness over the block graph using the cached per instruction register masks
+	class liveness
+	{
+	public:
+		/// @param blocks the recovered blocks, must outlive the liveness
+		/// @param index index over the same blocks, must outlive the liveness
+		/// @param abi assumptions for calls and returns
+		liveness(const block_list& blocks, const block_index& index, liveness_abi abi = liveness_abi::win64())
+			: blocks(blocks), index(index), abi(abi)
+		{
+			const size_t count = blocks.size();
+			gen.resize(count);
+			kill.resize(count);
+			exit_out.resize(count);
+			live_ins.assign(count, 0);
+			live_outs.assign(count, 0);
+
+			// predecessors in csr form for the worklist
+			std::vector<uint32_t> pred_offsets(count + 1, 0);
+			for (uint32_t block = 0; block < count; block++)
+			{
+				summarize(block);
+				for_each_successor(blocks[block], index, [&](uint32_t successor) { pred_offsets[successor + 1]++; });
+			}
+
+			for (size_t block = 0; block < count; block++)
+				pred_offsets[block + 1] += pred_offsets[block];
+
+			std::vector<uint32_t> preds(pred_offsets.back());
+			std::vector<uint32_t> cursor(pred_offsets.begin(), pred_offsets.end() - 1);
+			for (uint32_t block = 0; block < count; block++)
+				for_each_successor(blocks[block], index, [&](uint32_t successor) { preds[cursor[successor]++] = block; });
+
+			// successors are visited before their predecessors so most blocks settle on the first visit
+			std::deque<uint32_t> worklist;
+			std::vector<bool> queued(count, true);
+			for (uint32_t block : postorder())
+				worklist.push_back(block);
+
+			while (!worklist.empty())
+			{
+				const uint32_t block = worklist.front();
+				worklist.pop_front();
+				queued[block] = false;
+				solver_steps++;
+
+				uint64_t out = exit_out[block];
+				for_each_successor(blocks[block], index, [&](uint32_t successor) { out |= live_ins[successor]; });
+
+				live_outs[block] = out;
+				const uint64_t in = gen[block] | (out & ~kill[block]);
+				if (in == live_ins[block])
+					continue;
+
+				live_ins[block] = in;
+				for (uint32_t i = pred_offsets[block]; i < pred_offsets[block + 1]; i++)
+				{
+					if (!queued[preds[i]])
+					{
+						queued[preds[i]] = true;
+						worklist.push_back(preds[i]);
+					}
+				}
+			}
+		}
+
+		/// @brief getter for the registers live at the start of a block
+		uint64_t live_in(uint32_t block) const { return live_ins[block]; }
+
+		/// @brief getter for the registers live at the end of a block
+		uint64_t live_out(uint32_t block) const { return live_outs[block]; }
+
+		/// @brief computes the registers live right before an instruction
+		/// @param rva the rva of the instruction
+		/// @return the live register mask, every register if the rva is not inside of a recovered instruction
+		uint64_t live_at(uint32_t rva) const
+		{
+			const uint32_t block = index.containing(rva);
+			if (block == block_index::npos)
+				return ~0ull;
+
+			const basic_block& b = blocks[block];
+
+			uint32_t position = 0;
+			for (uint32_t current = b.rva_begin; position < b.insts.size() && current != rva; position++)
+				current += b.insts[position].info.length;
+
+			if (position == b.insts.size())
+				return ~0ull;
+
+			uint64_t live = live_outs[block];
+			for (size_t i = b.insts.size(); i-- > position;)
+			{
+				const inst_regs regs = effect(b, i);
+				live = regs.use | (live & ~regs.def);
+			}
+
+			return live;
+		}
+
+		/// @brief computes the general purpose registers which can be used freely right before an instruction
+		/// @param rva the rva of the instruction
+		/// @return mask of dead general purpose registers, rsp is never free
+		uint64_t free_at(uint32_t rva) const
+		{
+			return ~live_at(rva) & reg_mask_gpr & ~liveness_abi::gpr(4);
+		}
+
+		/// @brief getter for the amount of blocks the solver processed until it converged
+		uint64_t steps() const { return solver_steps; }
+
+	private:
+		const block_list& blocks;
+		const block_index& index;
+		liveness_abi abi;
+
+		std::vector<uint64_t> gen;
+		std::vector<uint64_t> kill;
+		std::vector<uint64_t> exit_out;
+
+		std::vector<uint64_t> live_ins;
+		std::vector<uint64_t> live_outs;
+
+		uint64_t solver_steps = 0;
+
+		/// @brief register effect of an instruction with the calling convention applied to calls
+		inst_regs effect(const basic_block& block, size_t i) const
+		{
+			inst_regs regs = block.regs[i];
+			if (block.insts[i].info.meta.category == ZYDIS_CATEGORY_CALL)
+			{
+				regs.use |= abi.call_uses;
+				regs.def |= abi.call_clobbers;
+			}
+
+			return regs;
+		}
+
+		/// @brief folds the instructions of a block into one transfer function and finds what leaves the graph
+		void summarize(uint32_t block)
+		{
+			const basic_block& b = blocks[block];
+
+			uint64_t block_gen = 0;
+			uint64_t block_kill = 0;
+			for (size_t i = b.insts.size(); i-- > 0;)
+			{
+				const inst_regs regs = effect(b, i);
+				block_gen = regs.use | (block_gen & ~regs.def);
+				block_kill |= regs.def;
+			}
+
+			gen[block] = block_gen;
+			kill[block] = block_kill;
+
+			// returns keep the abi exit registers alive, unknown or unrecovered targets keep everything alive
+			uint64_t out = 0;
+			bool unresolved = b.branch_one == no_branch && b.branch_two == no_branch;
+			for (uint32_t branch : { b.branch_one, b.branch_two })
+			{
+				if (branch != no_branch && index.find(branch) == block_index::npos)
+					unresolved = true;
+			}
+
+			if (!b.insts.empty() && b.insts.back().info.meta.category == ZYDIS_CATEGORY_RET)
+				out = abi.exit_live;
+			else if (unresolved)
+				out = ~0ull;
+
+			exit_out[block] = out;
+		}
+
+		/// @brief postorder of the block graph over every block
+		std::vector<uint32_t> postorder() const
+		{
+			const size_t count = blocks.size();
+
+			std::vector<uint32_t> order;
+			order.reserve(count);
+
+			std::vector<bool> visited(count, false);
+			std::vector<std::pair<uint32_t, uint8_t>> stack;
+			for (uint32_t root = 0; root < count; root++)
+			{
+				if (visited[root])
+					continue;
+
+				visited[root] = true;
+				stack.push_back({ root, 0 });
+				while (!stack.empty())
+				{
+					auto& [block, next] = stack.back();
+					const uint32_t branches[] = { blocks[block].branch_one, blocks[block].branch_two };
+
+					if (next < 2)
+					{
+						const uint32_t branch = branches[next++];
+						const uint32_t successor = branch == no_branch ? block_index::npos : index.find(branch);
+						if (successor != block_index::npos && !visited[successor])
+						{
+							visited[successor] = true;
+							stack.push_back({ successor, 0 });
+						}
+
+						continue;
+					}
+
+					order.push_back(block);
+					stack.pop_back();
+				}
+			}
+
+			return order;
+		}
+	};
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+#include "dasm/page_memory.h"
+
+namespace eagle::dasm
+{
+	/// @brief how a range of the image is about to be read, passed to the kernel as a readahead hint
+	enum class access_pattern : uint8_t
+	{
+		/// @brief default readahead
+		normal,
+
+		/// @brief read front to back once, such as a linear sweep, readahead is increased
+		sequential,
+
+		/// @brief read in no particular order, such as recursive descent, readahead is disabled
+		random,
+
+		/// @brief read soon, the kernel starts faulting the pages in asynchronously
+		will_need,
+	};
+
+	/// @brief passes an access pattern for the pages a range of bytes lies in to the kernel
+	/// the range is widened to whole pages, a hint which the kernel refuses has no effect
+	/// @param bytes the bytes, usually part of a file mapping
+	/// @param pattern the expected access pattern
+	/// @return true if the kernel accepted the hint
+	inline bool advise(std::span<const uint8_t> bytes, access_pattern pattern)
+	{
+		if (bytes.empty())
+			return false;
+
+		static const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+
+		const uintptr_t begin = reinterpret_cast<uintptr_t>(bytes.data()) & ~(page_size - 1);
+		const uintptr_t end = reinterpret_cast<uintptr_t>(bytes.data() + bytes.size());
+
+		int advice = MADV_NORMAL;
+		switch (pattern)
+		{
+			case access_pattern::sequential:
+				advice = MADV_SEQUENTIAL;
+				break;
+			case access_pattern::random:
+				advice = MADV_RANDOM;
+				break;
+			case access_pattern::will_need:
+				advice = MADV_WILLNEED;
+				break;
+			default:
+				break;
+		}
+
+		return madvise(reinterpret_cast<void*>(begin), end - begin, advice) == 0;
+	}
+
+	/// @brief passes an access pattern for a range to the kernel for the lifetime of the guard and restores the
+	/// pattern which applied before. the kernel cannot report the advice of a range, so the previous pattern is the
+	/// one the owner of the bytes last passed
+	class scoped_advice
+	{
+	public:
+		/// @param bytes the bytes, they have to stay mapped until the guard is destroyed
+		/// @param pattern the pattern applied while the guard lives
+		/// @param previous the pattern restored afterwards
+		scoped_advice(std::span<const uint8_t> bytes, access_pattern pattern, access_pattern previous)
+			: bytes(bytes), previous(previous), accepted(pattern != previous && advise(bytes, pattern))
+		{
+		}
+
+		scoped_advice(const scoped_advice&) = delete;
+		scoped_advice& operator=(const scoped_advice&) = delete;
+
+		~scoped_advice()
+		{
+			if (accepted)
+				advise(bytes, previous);
+		}
+
+	private:
+		std::span<const uint8_t> bytes;
+		access_pattern previous;
+
+		/// @brief false if nothing has to be restored, the pattern was already in effect or the kernel refused it
+		bool accepted;
+	};
+
+	/// @brief page faults taken by the calling thread so far, two samples around a phase give the faults it caused
+	struct fault_sample
+	{
+		/// @brief faults served without io, such as the first touch of a page already in the page cache
+		uint64_t minor = 0;
+
+		/// @brief faults which had to read from disk
+		uint64_t major = 0;
+
+		/// @brief samples the counters of the calling thread
+		static fault_sample now()
+		{
+			rusage usage = {};
+			getrusage(RUSAGE_THREAD, &usage);
+			return { static_cast<uint64_t>(usage.ru_minflt), static_cast<uint64_t>(usage.ru_majflt) };
+		}
+
+		fault_sample operator-(const fault_sample& earlier) const
+		{
+			return { minor - earlier.minor, major - earlier.major };
+		}
+	};
+
+	/// @brief read only file mapping of an image, the bytes can be handed to segment_dasm without copying them
+	class mapped_image
+	{
+	public:
+		mapped_image(const mapped_image&) = delete;
+		mapped_image& operator=(const mapped_image&) = delete;
+
+		mapped_image(mapped_image&& other) noexcept
+			: mapping(std::exchange(other.mapping, nullptr)), mapping_size(std::exchange(other.mapping_size, 0)),
+			  mapped_length(std::exchange(other.mapped_length, 0))
+		{
+		}
+
+		~mapped_image()
+		{
+			if (mapping)
+				munmap(mapping, mapped_length);
+		}
+
+		/// @brief maps a file
+		/// @param path the file to map
+		/// @return the mapping, nullopt if the file cannot be opened, is empty or cannot be mapped
+		static std::optional<mapped_image> open(const std::string& path)
+		{
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return std::nullopt;
+
+			struct stat info = {};
+			if (fstat(fd, &info) != 0 || info.st_size == 0)
+			{
+				close(fd);
+				return std::nullopt;
+			}
+
+			void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (mapped == MAP_FAILED)
+				return std::nullopt;
+
+			return mapped_image(mapped, info.st_size, info.st_size);
+		}
+
+		/// @brief reads a file into anonymous memory with the given pages and numa placement
+		/// page cache pages of a file mapping are always small, copying the image is what lets a long multi-threaded
+		/// analysis read it through huge pages. normal pages without a node map the file like open(path)
+		/// @param path the file to load
+		/// @param options the pages backing the copy and the node it is placed on
+		/// @return the image, nullopt if the file cannot be read or the memory cannot be mapped
+		static std::optional<mapped_image> open(const std::string& path, const page_options& options)
+		{
+			if (options.pages == page_policy::normal && options.node == no_node)
+				return open(path);
+
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return std::nullopt;
+
+			struct stat info = {};
+			if (fstat(fd, &info) != 0 || info.st_size == 0)
+			{
+				close(fd);
+				return std::nullopt;
+			}
+
+			void* memory = map_pages(info.st_size, options);
+			if (!memory)
+			{
+				close(fd);
+				return std::nullopt;
+			}
+
+			mapped_image image(memory, info.st_size, page_rounded(info.st_size, options.pages));
+
+			size_t offset = 0;
+			while (offset < image.mapping_size)
+			{
+				const ssize_t read = pread(fd, static_cast<uint8_t*>(memory) + offset, image.mapping_size - offset, offset);
+				if (read <= 0)
+				{
+					close(fd);
+					return std::nullopt;
+				}
+
+				offset += read;
+			}
+
+			close(fd);
+			mprotect(memory, image.mapped_length, PROT_READ);
+			return image;
+		}
+
+		/// @brief getter for the mapped bytes
+		std::span<const uint8_t> bytes() const
+		{
+			return { static_cast<const uint8_t*>(mapping), mapping_size };
+		}
+
+		/// @brief getter for a range of the mapped bytes, clamped to the mapping
+		/// @param offset file offset of the first byte
+		/// @param size the amount of bytes
+		std::span<const uint8_t> bytes(size_t offset, size_t size) const
+		{
+			offset = std::min(offset, mapping_size);
+			return bytes().subspan(offset, std::min(size, mapping_size - offset));
+		}
+
+		/// @brief passes an access pattern for the whole mapping to the kernel
+		/// @return true if the kernel accepted the hint
+		bool advise(access_pattern pattern) const
+		{
+			return dasm::advise(bytes(), pattern);
+		}
+
+	private:
+		void* mapping;
+		size_t mapping_size;
+
+		/// @brief length of the mapping itself, anonymous copies are rounded to their pages
+		size_t mapped_length;
+
+		mapped_image(void* mapping, size_t mapping_size, size_t mapped_length)
+			: mapping(mapping), mapping_size(mapping_size), mapped_length(mapped_length)
+		{
+		}
+	};
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory_resource>
+#include <new>
+
+namespace eagle::dasm
+{
+	/// @brief size of a pmd huge page on x86-64
+	constexpr size_t huge_page_size = 2ull << 20;
+
+	/// @brief value of a node which means no numa placement
+	constexpr int32_t no_node = -1;
+
+	/// @brief which pages back a mapping
+	enum class page_policy : uint8_t
+	{
+		/// @brief regular 4 KiB pages
+		normal,
+
+		/// @brief 2 MiB aligned mapping advised with MADV_HUGEPAGE, khugepaged or the fault path backs it with huge pages
+		transparent_huge,
+
+		/// @brief MAP_HUGETLB from the reserved hugetlbfs pool, falls back to transparent huge pages when the pool is empty
+		explicit_huge,
+	};
+
+	struct page_options
+	{
+		page_policy pages = page_policy::normal;
+
+		/// @brief numa node the pages are preferably placed on, no_node leaves placement to first touch
+		int32_t node = no_node;
+	};
+
+	/// @brief getter for the numa node of the cpu the calling thread runs on
+	/// @return the node, 0 if the kernel does not report one
+	inline int32_t current_numa_node()
+	{
+		unsigned cpu = 0;
+		unsigned node = 0;
+		if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+			return 0;
+
+		return static_cast<int32_t>(node);
+	}
+
+	/// @brief rounds a request up to the granularity pages of a policy are mapped with
+	inline size_t page_rounded(size_t bytes, page_policy pages)
+	{
+		static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+		const size_t granularity = pages == page_policy::normal ? page_size : huge_page_size;
+		return (bytes + granularity - 1) & ~(granularity - 1);
+	}
+
+	/// @brief maps anonymous memory with the pages and node placement of the options
+	/// the placement is set before the memory is touched, so every page faults in on the preferred node
+	/// @param bytes the size of the mapping, rounded with page_rounded
+	/// @param options the page policy and node
+	/// @return the mapping, nullptr if the kernel refused it
+	inline void* map_pages(size_t bytes, const page_options& options)
+	{
+		const size_t size = page_rounded(bytes, options.pages);
+
+		void* mapping = MAP_FAILED;
+		if (options.pages == page_policy::explicit_huge)
+			mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (mapping == MAP_FAILED && options.pages != page_policy::normal)
+		{
+			// over-map by one huge page so the mapping can be trimmed to a huge page aligned range
+			uint8_t* raw = static_cast<uint8_t*>(mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+			if (raw == MAP_FAILED)
+				return nullptr;
+
+			const uintptr_t address = reinterpret_cast<uintptr_t>(raw);
+			uint8_t* aligned = raw + ((huge_page_size - address % huge_page_size) % huge_page_size);
+
+			if (aligned != raw)
+				munmap(raw, aligned - raw);
+			if (aligned + size != raw + size + huge_page_size)
+				munmap(aligned + size, raw + size + huge_page_size - (aligned + size));
+
+			madvise(aligned, size, MADV_HUGEPAGE);
+			mapping = aligned;
+		}
+		else if (mapping == MAP_FAILED)
+		{
+			mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapping == MAP_FAILED)
+				return nullptr;
+		}
+
+		// mbind without libnuma, a preferred policy still falls back to other nodes when the node is full
+		constexpr int mpol_preferred = 1;
+		if (options.node >= 0 && options.node < 64)
+		{
+			const unsigned long mask = 1ul << options.node;
+			syscall(SYS_mbind, mapping, size, mpol_preferred, &mask, sizeof(mask) * 8 + 1, 0);
+		}
+
+		return mapping;
+	}
+
+	/// @brief unmaps memory returned by map_pages
+	/// @param mapping the mapping
+	/// @param bytes the size passed to map_pages
+	/// @param pages the page policy passed to map_pages
+	inline void unmap_pages(void* mapping, size_t bytes, page_policy pages)
+	{
+		munmap(mapping, page_rounded(bytes, pages));
+	}
+
+	/// @brief thread-safe memory resource which maps every request directly with map_pages
+	/// meant as the upstream of arenas and pools, whose chunks are large enough to amortize a system call each
+	class page_resource : public std::pmr::memory_resource
+	{
+	public:
+		explicit page_resource(page_options options = {})
+			: options(options)
+		{
+		}
+
+		/// @brief getter for the options every mapping is created with
+		const page_options& get_options() const { return options; }
+
+		/// @brief getter for the bytes currently mapped, after rounding to whole pages
+		size_t mapped_bytes() const { return mapped.load(std::memory_order_relaxed); }
+
+	private:
+		page_options options;
+		std::atomic<size_t> mapped = 0;
+
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			// mappings are aligned to their page granularity, larger alignments are not requested by the containers of an analysis
+			if (alignment > page_rounded(1, options.pages))
+				throw std::bad_alloc();
+
+			void* p = map_pages(bytes, options);
+			if (!p)
+				throw std::bad_alloc();
+
+			mapped.fetch_add(page_rounded(bytes, options.pages), std::memory_order_relaxed);
+			return p;
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t) override
+		{
+			unmap_pages(p, bytes, options.pages);
+			mapped.fetch_sub(page_rounded(bytes, options.pages), std::memory_order_relaxed);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace eagle::dasm
+{
+	/// @brief getter for the amount of threads parallel work is split across
+	/// @return the hardware thread count, at least 1
+	inline size_t parallel_threads()
+	{
+		return std::max<size_t>(1, std::thread::hardware_concurrency());
+	}
+
+	/// @brief calls fn(index, thread) for every index in [0, count), indices are handed out dynamically so uneven work balances out
+	/// @param count amount of indices
+	/// @param fn callable taking the index and the id of the thread in [0, threads) which runs it
+	/// @param threads amount of threads to use, 0 uses parallel_threads()
+	template <typename function>
+	void parallel_for(size_t count, function&& fn, size_t threads = 0)
+	{
+		if (threads == 0)
+			threads = parallel_threads();
+		threads = std::min(threads, count);
+
+		std::atomic<size_t> next = 0;
+		auto worker = [&](size_t thread)
+		{
+			for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+				i = next.fetch_add(1, std::memory_order_relaxed))
+				fn(i, thread);
+		};
+
+		if (threads <= 1)
+		{
+			worker(0);
+			return;
+		}
+
+		std::vector<std::jthread> pool;
+		pool.reserve(threads - 1);
+		for (size_t thread = 1; thread < threads; thread++)
+			pool.emplace_back(worker, thread);
+
+		worker(0);
+	}
+}
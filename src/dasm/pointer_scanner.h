@@ -0,0 +1,348 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace eagle::dasm
+{
+	namespace detail
+	{
+		/// @brief computes a bit mask over 64 consecutive 8 byte values, bit i is set if value i lies in [low, low + extent)
+		inline uint64_t range_mask(const uint8_t* bytes, uint64_t low, uint64_t extent)
+		{
+			uint64_t hits = 0;
+#if defined(__SSE4_2__)
+			// there is no unsigned 64-bit compare, flipping the sign bits of both sides turns the signed one into it
+			const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+			const __m128i base = _mm_set1_epi64x(static_cast<int64_t>(low));
+			const __m128i limit = _mm_xor_si128(_mm_set1_epi64x(static_cast<int64_t>(extent)), sign);
+
+			for (uint32_t i = 0; i < 64; i += 2)
+			{
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i * 8));
+				const __m128i offset = _mm_xor_si128(_mm_sub_epi64(v, base), sign);
+				const __m128i inside = _mm_cmpgt_epi64(limit, offset);
+				hits |= static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(inside))) << i;
+			}
+#else
+			// branch free so compilers vectorize it for targets with 64-bit compares
+			for (uint32_t i = 0; i < 64; i++)
+			{
+				uint64_t value;
+				std::memcpy(&value, bytes + i * 8, sizeof(value));
+				hits |= static_cast<uint64_t>(value - low < extent) << i;
+			}
+#endif
+			return hits;
+		}
+	}
+
+	/// @brief a mapped section of an image
+	struct image_section
+	{
+		/// @brief the rva the first byte is mapped at
+		uint32_t rva_begin = 0;
+
+		/// @brief the bytes of the section as they are mapped
+		std::span<const uint8_t> data;
+
+		bool executable = false;
+	};
+
+	/// @brief a pointer into executable code found in data
+	struct code_pointer
+	{
+		/// @brief rva of the pointer itself
+		uint32_t site;
+
+		/// @brief rva the pointer points to
+		uint32_t target;
+	};
+
+	/// @brief finds pointers into executable sections which are stored in data, such as vtables, function pointer
+	/// tables and callbacks, which branch following never reaches
+	/// relocations name every absolute pointer of a relocatable image exactly, images without them fall back to
+	/// an aligned scan of their data sections. elf symbol relocations such as R_X86_64_64, R_X86_64_GLOB_DAT and
+	/// R_X86_64_JUMP_SLOT are not read, their value depends on a symbol table and mostly names imports
+	class pointer_scanner
+	{
+	public:
+		/// @param sections every mapped section of the image
+		/// @param image_base the preferred base of the image, 0 for position independent elf objects
+		pointer_scanner(std::span<const image_section> sections, uint64_t image_base)
+			: sections(sections), image_base(image_base)
+		{
+		}
+
+		/// @brief reads the pointers named by a pe base relocation directory
+		/// @param directory the bytes of the base relocation directory
+		/// @return the pointers into executable sections, sorted by site
+		std::vector<code_pointer> from_pe_relocations(std::span<const uint8_t> directory) const
+		{
+			constexpr uint16_t rel_based_highlow = 3;
+			constexpr uint16_t rel_based_dir64 = 10;
+
+			std::vector<code_pointer> pointers;
+
+			size_t offset = 0;
+			while (offset + 8 <= directory.size())
+			{
+				const uint32_t page = read<uint32_t>(directory.data() + offset);
+				const uint32_t block_size = read<uint32_t>(directory.data() + offset + 4);
+				if (block_size < 8 || offset + block_size > directory.size())
+					break;
+
+				for (size_t entry = offset + 8; entry + 2 <= offset + block_size; entry += 2)
+				{
+					const uint16_t value = read<uint16_t>(directory.data() + entry);
+					const uint16_t type = value >> 12;
+					const uint32_t site = page + (value & 0xFFF);
+
+					uint64_t address = 0;
+					if (type == rel_based_dir64)
+					{
+						if (!read_at(site, address))
+							continue;
+					}
+					else if (type == rel_based_highlow)
+					{
+						uint32_t narrow = 0;
+						if (!read_at(site, narrow))
+							continue;
+
+						address = narrow;
+					}
+					else
+					{
+						// absolute entries pad blocks to 4 bytes, other types do not occur on x86
+						continue;
+					}
+
+					add_pointer(pointers, site, address);
+				}
+
+				offset += block_size;
+			}
+
+			sort_pointers(pointers);
+			return pointers;
+		}
+
+		/// @brief reads the pointers named by the R_X86_64_RELATIVE and R_X86_64_IRELATIVE entries of an elf rela table
+		/// such as .rela.dyn, these store the pointed to address in their addend so the section is not read
+		/// @param table the bytes of the Elf64_Rela table
+		/// @return the pointers into executable sections, sorted by site
+		std::vector<code_pointer> from_elf_relocations(std::span<const uint8_t> table) const
+		{
+			constexpr uint32_t r_x86_64_relative = 8;
+			constexpr uint32_t r_x86_64_irelative = 37;
+			constexpr size_t rela_size = 24;
+
+			std::vector<code_pointer> pointers;
+			for (size_t offset = 0; offset + rela_size <= table.size(); offset += rela_size)
+			{
+				const uint64_t site = read<uint64_t>(table.data() + offset);
+				const uint64_t info = read<uint64_t>(table.data() + offset + 8);
+				const int64_t addend = read<int64_t>(table.data() + offset + 16);
+
+				// irelative addends point at the resolver, which is code as well
+				const uint32_t type = static_cast<uint32_t>(info & 0xFFFFFFFF);
+				if ((type != r_x86_64_relative && type != r_x86_64_irelative) || site < image_base ||
+					site - image_base > 0xFFFFFFFF)
+					continue;
+
+				add_pointer(pointers, static_cast<uint32_t>(site - image_base), static_cast<uint64_t>(addend));
+			}
+
+			sort_pointers(pointers);
+			return pointers;
+		}
+
+		/// @brief reads the pointers named by an elf DT_RELR table such as .relr.dyn, which linkers emit in place of
+		/// relative rela entries when packing relocations. the pointed to address is stored at the site itself
+		/// @param table the bytes of the Elf64_Relr table
+		/// @return the pointers into executable sections, sorted by site
+		std::vector<code_pointer> from_elf_relr(std::span<const uint8_t> table) const
+		{
+			std::vector<code_pointer> pointers;
+
+			// an even entry is the address of a site, an odd entry is a bitmap of the 63 words following the last site
+			uint64_t next = 0;
+			for (size_t offset = 0; offset + 8 <= table.size(); offset += 8)
+			{
+				const uint64_t entry = read<uint64_t>(table.data() + offset);
+				if ((entry & 1) == 0)
+				{
+					add_relr_site(pointers, entry);
+					next = entry + 8;
+					continue;
+				}
+
+				for (uint64_t bits = entry >> 1, word = 0; bits != 0; bits >>= 1, word++)
+				{
+					if (bits & 1)
+						add_relr_site(pointers, next + word * 8);
+				}
+
+				next += 63 * 8;
+			}
+
+			sort_pointers(pointers);
+			return pointers;
+		}
+
+		/// @brief scans the non executable sections for aligned values pointing into executable sections
+		/// used for images whose relocations were stripped, values which only look like pointers are found as well
+		/// @param alignment the alignment pointers are stored at, 8 for 64-bit tables
+		/// @return the pointers into executable sections, sorted by site
+		std::vector<code_pointer> scan(uint32_t alignment = 8) const
+		{
+			std::vector<code_pointer> pointers;
+
+			// one unsigned compare per value against the span of all executable sections, exact bounds are checked on hits
+			uint64_t low = UINT64_MAX;
+			uint64_t high = 0;
+			for (const image_section& section : sections)
+			{
+				if (section.executable && !section.data.empty())
+				{
+					low = std::min(low, image_base + section.rva_begin);
+					high = std::max(high, image_base + section.rva_begin + section.data.size());
+				}
+			}
+
+			if (low >= high)
+				return pointers;
+
+			const uint64_t extent = high - low;
+			for (const image_section& section : sections)
+			{
+				if (section.executable)
+					continue;
+
+				// the section start is not necessarily aligned, the first aligned rva is
+				const uint32_t first = (alignment - section.rva_begin % alignment) % alignment;
+				const uint8_t* bytes = section.data.data();
+
+				size_t offset = first;
+				if (alignment == 8)
+				{
+					// 64 values are compared at once, hits are rare so the per pointer work stays out of the loop
+					for (; offset + 64 * 8 <= section.data.size(); offset += 64 * 8)
+					{
+						for (uint64_t hits = detail::range_mask(bytes + offset, low, extent); hits != 0; hits &= hits - 1)
+						{
+							const size_t at = offset + std::countr_zero(hits) * 8;
+							add_pointer(pointers, section.rva_begin + static_cast<uint32_t>(at), read<uint64_t>(bytes + at));
+						}
+					}
+				}
+
+				for (; offset + 8 <= section.data.size(); offset += alignment)
+				{
+					const uint64_t value = read<uint64_t>(bytes + offset);
+					if (value - low < extent)
+						add_pointer(pointers, section.rva_begin + static_cast<uint32_t>(offset), value);
+				}
+			}
+
+			sort_pointers(pointers);
+			return pointers;
+		}
+
+		/// @brief collects the distinct targets of pointers, ready to be queued with discovery_scheduler::push_all
+		/// @param pointers the pointers
+		/// @return the targets in ascending order
+		static std::vector<uint32_t> targets(std::span<const code_pointer> pointers)
+		{
+			std::vector<uint32_t> result;
+			result.reserve(pointers.size());
+			for (const code_pointer& pointer : pointers)
+				result.push_back(pointer.target);
+
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+			return result;
+		}
+
+	private:
+		std::span<const image_section> sections;
+		uint64_t image_base;
+
+		template <typename type>
+		static type read(const uint8_t* bytes)
+		{
+			type value;
+			std::memcpy(&value, bytes, sizeof(type));
+			return value;
+		}
+
+		/// @brief reads a value from the section which contains an rva
+		/// @return false if no section holds all of its bytes
+		template <typename type>
+		bool read_at(uint32_t rva, type& value) const
+		{
+			for (const image_section& section : sections)
+			{
+				if (rva >= section.rva_begin && rva - section.rva_begin + sizeof(type) <= section.data.size())
+				{
+					value = read<type>(section.data.data() + (rva - section.rva_begin));
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		bool is_code(uint32_t rva) const
+		{
+			for (const image_section& section : sections)
+			{
+				if (section.executable && rva >= section.rva_begin && rva - section.rva_begin < section.data.size())
+					return true;
+			}
+
+			return false;
+		}
+
+		/// @brief records the pointer stored at the virtual address of a relr site
+		void add_relr_site(std::vector<code_pointer>& pointers, uint64_t address) const
+		{
+			if (address < image_base || address - image_base > 0xFFFFFFFF)
+				return;
+
+			const uint32_t site = static_cast<uint32_t>(address - image_base);
+			uint64_t value = 0;
+			if (read_at(site, value))
+				add_pointer(pointers, site, value);
+		}
+
+		/// @brief records a pointer if the address it holds lands inside of an executable section
+		void add_pointer(std::vector<code_pointer>& pointers, uint32_t site, uint64_t address) const
+		{
+			if (address < image_base || address - image_base > 0xFFFFFFFF)
+				return;
+
+			const uint32_t target = static_cast<uint32_t>(address - image_base);
+			if (is_code(target))
+				pointers.push_back({ site, target });
+		}
+
+		static void sort_pointers(std::vector<code_pointer>& pointers)
+		{
+			std::sort(pointers.begin(), pointers.end(), [](const code_pointer& a, const code_pointer& b)
+			{
+				return a.site < b.site;
+			});
+		}
+	};
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace eagle::dasm
+{
+	/// @brief set of rvas with atomic test-and-set from any amount of threads
+	/// rvas inside of the dense range live in a bitmap, everything else goes to a sharded lock-free hash table.
+	/// the hash table never removes keys, a shard grows by chaining a table four times the size once a probe window is full
+	class rva_set
+	{
+	public:
+		/// @brief default upper bound for the dense bitmap, 64 MiB covers a 512 MiB range
+		static constexpr size_t default_bitmap_bytes = 64ull << 20;
+
+		/// @param rva_begin first rva of the dense range, usually the start of the executable segment
+		/// @param rva_end end of the dense range
+		/// @param max_bitmap_bytes the range is hashed instead if its bitmap would be larger than this
+		rva_set(uint32_t rva_begin, uint32_t rva_end, size_t max_bitmap_bytes = default_bitmap_bytes)
+			: rva_begin(rva_begin), rva_end(rva_end)
+		{
+			const size_t words = (static_cast<size_t>(rva_end - rva_begin) + 63) / 64;
+			if (rva_end <= rva_begin || words * sizeof(uint64_t) > max_bitmap_bytes)
+			{
+				this->rva_begin = 0;
+				this->rva_end = 0;
+				return;
+			}
+
+			bits = std::make_unique<std::atomic<uint64_t>[]>(words);
+		}
+
+		/// @brief creates a set which hashes every rva
+		rva_set()
+			: rva_set(0, 0)
+		{
+		}
+
+		rva_set(const rva_set&) = delete;
+		rva_set& operator=(const rva_set&) = delete;
+
+		/// @brief adds an rva to the set
+		/// @param rva the rva to add, no_branch must not be added
+		/// @return true if this call added it, false if it was already present
+		bool insert(uint32_t rva)
+		{
+			const bool inserted = in_range(rva) ? test_and_set(rva) : hash_insert(rva);
+			if (inserted)
+				count.fetch_add(1, std::memory_order_relaxed);
+
+			return inserted;
+		}
+
+		/// @brief checks if an rva is in the set
+		bool contains(uint32_t rva) const
+		{
+			if (in_range(rva))
+			{
+				const uint32_t bit = rva - rva_begin;
+				return bits[bit / 64].load(std::memory_order_acquire) & (1ull << (bit % 64));
+			}
+
+			const uint32_t hash = mix(rva);
+			for (const table* t = shards[shard_of(hash)].load(std::memory_order_acquire); t; t = t->next.load(std::memory_order_acquire))
+			{
+				for (uint32_t probe = 0; probe < probe_window; probe++)
+				{
+					const uint32_t key = t->slots[(hash + probe) & t->mask].load(std::memory_order_acquire);
+					if (key == rva)
+						return true;
+					if (key == empty)
+						return false;
+				}
+			}
+
+			return false;
+		}
+
+		/// @brief getter for the amount of rvas in the set
+		size_t size() const { return count.load(std::memory_order_relaxed); }
+
+	private:
+		static constexpr uint32_t empty = 0xFFFFFFFF;
+		static constexpr uint32_t shard_bits = 6;
+		static constexpr uint32_t probe_window = 16;
+		static constexpr uint32_t initial_slots = 4096;
+		static constexpr uint32_t growth = 4;
+
+		struct table
+		{
+			explicit table(uint32_t slot_count)
+				: mask(slot_count - 1), slots(std::make_unique<std::atomic<uint32_t>[]>(slot_count))
+			{
+				for (uint32_t i = 0; i < slot_count; i++)
+					slots[i].store(empty, std::memory_order_relaxed);
+			}
+
+			~table() { delete next.load(std::memory_order_relaxed); }
+
+			uint32_t mask;
+			std::unique_ptr<std::atomic<uint32_t>[]> slots;
+			std::atomic<table*> next = nullptr;
+		};
+
+		/// @brief owns the chain of a shard, the chain is only freed with the set
+		struct shard_head : std::atomic<table*>
+		{
+			shard_head() : std::atomic<table*>(nullptr) {}
+			~shard_head() { delete load(std::memory_order_relaxed); }
+		};
+
+		uint32_t rva_begin;
+		uint32_t rva_end;
+		std::unique_ptr<std::atomic<uint64_t>[]> bits;
+
+		std::array<shard_head, 1u << shard_bits> shards;
+		std::atomic<size_t> count = 0;
+
+		bool in_range(uint32_t rva) const { return rva >= rva_begin && rva < rva_end; }
+
+		bool test_and_set(uint32_t rva)
+		{
+			const uint32_t bit = rva - rva_begin;
+			const uint64_t mask = 1ull << (bit % 64);
+			return !(bits[bit / 64].fetch_or(mask, std::memory_order_acq_rel) & mask);
+		}
+
+		static uint32_t mix(uint32_t value)
+		{
+			value ^= value >> 16;
+			value *= 0x7FEB352D;
+			value ^= value >> 15;
+			value *= 0x846CA68B;
+			value ^= value >> 16;
+			return value;
+		}
+
+		static uint32_t shard_of(uint32_t hash) { return hash >> (32 - shard_bits); }
+
+		/// @brief installs the successor of a table, the thread losing the race frees its copy and uses the winner
+		static table* next_table(std::atomic<table*>& link, uint32_t slot_count)
+		{
+			table* current = link.load(std::memory_order_acquire);
+			if (current)
+				return current;
+
+			table* created = new table(slot_count);
+			if (link.compare_exchange_strong(current, created, std::memory_order_acq_rel))
+				return created;
+
+			delete created;
+			return current;
+		}
+
+		/// @brief slots only ever go from empty to a key, so every thread inserting the same key walks the same
+		/// probe windows and meets at the same slot, the cas loser sees the key and reports it as present
+		bool hash_insert(uint32_t rva)
+		{
+			const uint32_t hash = mix(rva);
+
+			std::atomic<table*>* link = &shards[shard_of(hash)];
+			uint32_t slot_count = initial_slots;
+			while (true)
+			{
+				table* t = next_table(*link, slot_count);
+				for (uint32_t probe = 0; probe < probe_window; probe++)
+				{
+					std::atomic<uint32_t>& slot = t->slots[(hash + probe) & t->mask];
+
+					uint32_t key = slot.load(std::memory_order_acquire);
+					if (key == empty && slot.compare_exchange_strong(key, rva, std::memory_order_acq_rel))
+						return true;
+
+					if (key == rva)
+						return false;
+				}
+
+				link = &t->next;
+				slot_count = (t->mask + 1) * growth;
+			}
+		}
+	};
+}
@@ -0,0 +1,527 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "codec/zydis_defs.h"
+#include "dasm/basic_block.h"
+#include "dasm/compact_block.h"
+#include "dasm/inst_util.h"
+#include "dasm/lazy_inst.h"
+#include "dasm/mapped_image.h"
+
+namespace eagle::dasm
+{
+	/// @brief a decoded instruction, length is 0 and inst is unspecified unless status is ok
+	struct decode_result
+	{
+		codec::dec::inst inst;
+		uint8_t length;
+		decode_status status;
+	};
+
+	/// @brief an instruction decoded up to its header, length is 0 and inst is unspecified unless status is ok
+	struct lazy_decode_result
+	{
+		lazy_inst inst;
+		uint8_t length;
+		decode_status status;
+	};
+
+	/// @brief what a segment_dasm decoded and how long it took, decode times are only taken while timing is enabled
+	struct decode_counters
+	{
+		uint64_t blocks = 0;
+		uint64_t insts = 0;
+
+		/// @brief time spent inside of get_block
+		uint64_t decode_ns = 0;
+
+		/// @brief blocks which took longer than the stall threshold, usually because their bytes faulted in
+		uint64_t stalls = 0;
+
+		/// @brief branch targets whose bytes were prefetched
+		uint64_t prefetches = 0;
+	};
+
+	class dasm_kernel
+	{
+	protected:
+		/// @brief decodes an instruction at the current rva, any rva is accepted and failures are returned as a status
+		/// @return the decoded instruction, its length and out_of_range, truncated or invalid if it could not be decoded
+		virtual decode_result decode_current() = 0;
+
+		/// @brief decodes the instruction at the current rva and returns branches
+		/// @return returns a list of rvas the instruction branches to. len(0) if none, len(1) if jmp, len(2) if conditional jump
+		virtual std::vector<uint32_t> get_branches() = 0;
+
+		/// @brief getter for the current rva
+		/// @return the current rva
+		virtual uint32_t get_current_rva() = 0;
+
+		/// @brief updates the current rva
+		/// @param rva new rva
+		/// @return old rva before replacement
+		virtual uint32_t set_current_rva(uint32_t rva) = 0;
+	};
+
+	class segment_dasm : private dasm_kernel
+	{
+	public:
+		/// @param data the bytes of the segment
+		/// @param rva_begin the rva at which the first byte of the segment is mapped
+		explicit segment_dasm(std::span<const uint8_t> data, uint32_t rva_begin = 0)
+			: rva_begin(rva_begin), rva_end(rva_begin + static_cast<uint32_t>(data.size())), data(data), current_rva(rva_begin)
+		{
+		}
+
+		/// @brief getter for the first rva of the segment
+		/// @return the rva of the first byte
+		uint32_t get_rva_begin() const { return rva_begin; }
+
+		/// @brief getter for the end of the segment
+		/// @return the rva one past the last byte
+		uint32_t get_rva_end() const { return rva_end; }
+
+		/// @brief checks if an rva is located inside of the segment
+		/// @param rva the rva to check
+		/// @return true if the rva is inside of the segment
+		bool contains(uint32_t rva) const { return rva >= rva_begin && rva < rva_end; }
+
+		/// @brief getter for the raw bytes of the segment
+		/// @return the bytes, index 0 is located at get_rva_begin()
+		std::span<const uint8_t> get_bytes() const { return data; }
+
+		/// @brief sets the memory resource which backs every block and instruction container this dasm creates
+		/// @param new_resource the resource, usually the arena of the running analysis
+		void set_resource(std::pmr::memory_resource* new_resource)
+		{
+			resource = new_resource;
+		}
+
+		/// @brief passes the access pattern of the segment to the kernel, scoped advice of the phases restores it
+		/// @param pattern the expected access pattern of the segment bytes
+		/// @return true if the kernel accepted the hint, false for bytes which are not mapped pages such as heap memory
+		bool advise(access_pattern pattern)
+		{
+			const bool accepted = dasm::advise(data, pattern);
+			if (accepted)
+				this->pattern = pattern;
+
+			return accepted;
+		}
+
+		/// @brief passes the access pattern of a phase to the kernel, random for discovery, until the guard is destroyed
+		/// @param pattern the expected access pattern of the segment bytes during the phase
+		/// @return the guard, it restores the pattern last passed to advise
+		[[nodiscard]] scoped_advice advise_scoped(access_pattern pattern) const
+		{
+			return scoped_advice(data, pattern, this->pattern);
+		}
+
+		/// @brief getter for the pattern last passed to advise, normal if none was
+		access_pattern get_access_pattern() const { return pattern; }
+
+		/// @brief pulls the first bytes at an rva towards the cache, issued for branch targets well before they are decoded
+		/// @param rva any rva, rvas outside of the segment are ignored
+		void prefetch(uint32_t rva)
+		{
+			if (!contains(rva))
+				return;
+
+			const uint8_t* bytes = data.data() + (rva - rva_begin);
+			__builtin_prefetch(bytes, 0, 1);
+
+			// an instruction starting near the end of the line continues into the next one
+			if (rva + 64 < rva_end)
+				__builtin_prefetch(bytes + 64, 0, 1);
+
+			counters.prefetches++;
+		}
+
+		/// @brief prefetches the branch targets of a block
+		/// @param block the decoded block whose successors are queued next
+		void prefetch_successors(const basic_block& block)
+		{
+			for (uint32_t branch : { block.branch_one, block.branch_two })
+			{
+				if (branch != no_branch)
+					prefetch(branch);
+			}
+		}
+
+		/// @brief enables measuring the time of every get_block call
+		/// @param stall_ns blocks which take longer than this are counted as stalls
+		void enable_timing(uint64_t stall_ns = 50000)
+		{
+			timing = true;
+			stall_threshold_ns = stall_ns;
+		}
+
+		/// @brief getter for the counters of this dasm
+		const decode_counters& get_counters() const { return counters; }
+
+		/// @brief resets the counters to zero
+		void reset_counters() { counters = {}; }
+
+		/// @brief dissasembled instructions until a branching instruction is reached at the current block, the branching instruction is included
+		/// @param rva the rva at which the target block begins
+		/// @return the basic block the instructions create
+		basic_block get_block(uint32_t rva)
+		{
+			const auto started = timing ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+			basic_block block = decode_block(rva);
+			counters.blocks++;
+			counters.insts += block.insts.size();
+
+			if (timing)
+			{
+				const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - started).count();
+
+				counters.decode_ns += elapsed;
+				if (elapsed > stall_threshold_ns)
+					counters.stalls++;
+			}
+
+			return block;
+		}
+
+		/// @brief disassembles a block the same way as get_block but only stores the location and flags of each instruction
+		/// @param rva the rva at which the target block begins
+		/// @return the compact block the instructions create
+		compact_block get_compact_block(uint32_t rva)
+		{
+			set_current_rva(rva);
+
+			compact_block block(resource);
+			block.rva_begin = get_current_rva();
+			block.rva_end = block.rva_begin;
+
+			while (contains(block.rva_end))
+			{
+				// offsets are 16 bits, oversized blocks continue in a new block
+				if (block.rva_end - block.rva_begin > compact_inst::max_offset)
+				{
+					block.branch_one = block.rva_end;
+					return block;
+				}
+
+				auto [result, size, status] = decode_current();
+				if (status != decode_status::ok)
+				{
+					block.status = status;
+					break;
+				}
+
+				const uint16_t flags = get_inst_flags(result);
+				block.insts.push_back({
+					static_cast<uint16_t>(block.rva_end - block.rva_begin),
+					size,
+					0,
+					flags,
+				});
+
+				if (is_block_end(flags))
+				{
+					read_branches(block);
+					block.rva_end += size;
+					return block;
+				}
+
+				block.rva_end += size;
+				set_current_rva(block.rva_end);
+			}
+
+			mark_unterminated(block);
+			return block;
+		}
+
+		/// @brief disassembles a block the same way as get_block but leaves the operands of each instruction undecoded
+		/// only call instructions have their operands materialized, to resolve the call site
+		/// @param rva the rva at which the target block begins
+		/// @return the lazy block the instructions create
+		lazy_block get_lazy_block(uint32_t rva)
+		{
+			lazy_block block(resource);
+			block.rva_begin = rva;
+			block.rva_end = rva;
+
+			while (contains(block.rva_end))
+			{
+				auto [result, size, status] = decode_lazy_at(block.rva_end);
+				if (status != decode_status::ok)
+				{
+					block.status = status;
+					break;
+				}
+
+				// the instruction is moved into the block first so call operands are cached in the block's resource
+				const uint16_t flags = get_header_flags(result.info);
+				block.insts.push_back(std::move(result));
+
+				if (flags & inst_flag_call)
+					block.calls.push_back(get_call_site(block.insts.back().materialize(block.rva_end), block.rva_end));
+
+				if (is_block_end(flags))
+				{
+					set_current_rva(block.rva_end);
+					read_branches(block);
+					block.rva_end += size;
+					return block;
+				}
+
+				block.rva_end += size;
+			}
+
+			mark_unterminated(block);
+			return block;
+		}
+
+		/// @brief decodes the header of a single instruction, its operands are decoded on first access
+		/// @param rva the rva of the instruction
+		/// @return the lazily decoded instruction, its length and the decode status
+		lazy_decode_result decode_lazy_at(uint32_t rva) const
+		{
+			if (!contains(rva))
+				return { {}, 0, decode_status::out_of_range };
+
+			ZydisDecoderContext context;
+			ZydisDecodedInstruction info;
+			const ZyanStatus result = ZydisDecoderDecodeInstruction(&lazy_inst::decoder(), &context,
+				data.data() + (rva - rva_begin), data.size() - (rva - rva_begin), &info);
+
+			if (!ZYAN_SUCCESS(result))
+				return { {}, 0, result == ZYDIS_STATUS_NO_MORE_DATA ? decode_status::truncated : decode_status::invalid };
+
+			return { lazy_inst(info, context), info.length, decode_status::ok };
+		}
+
+		/// @brief decodes a single instruction, the current rva is moved to the given rva
+		/// @param rva the rva of the instruction
+		/// @return the decoded instruction, its length and the decode status
+		decode_result decode_at(uint32_t rva)
+		{
+			set_current_rva(rva);
+			return decode_current();
+		}
+
+		/// @brief re-decodes the full instruction a compact instruction was created from
+		/// @param block the compact block which contains the instruction
+		/// @param inst the compact instruction
+		/// @return the fully decoded instruction
+		codec::dec::inst expand(const compact_block& block, const compact_inst& inst)
+		{
+			return decode_at(block.inst_rva(inst)).inst;
+		}
+
+		/// @brief re-decodes every instruction of a compact block into a regular basic block
+		/// @param compact the compact block
+		/// @return the basic block with fully decoded instructions
+		basic_block expand(const compact_block& compact)
+		{
+			basic_block block(resource);
+			block.rva_begin = compact.rva_begin;
+			block.rva_end = compact.rva_end;
+			block.branch_one = compact.branch_one;
+			block.branch_two = compact.branch_two;
+			block.status = compact.status;
+
+			block.insts.reserve(compact.insts.size());
+			block.regs.reserve(compact.insts.size());
+			for (const compact_inst& inst : compact.insts)
+			{
+				block.insts.push_back(expand(compact, inst));
+				block.regs.push_back(get_inst_regs(block.insts.back()));
+			}
+
+			return block;
+		}
+
+		/// @brief gets all the instructions in a certain section and disregards the flow of the instructions
+		/// @param rva_begin the rva at which the starting instruction is at
+		/// @param rva_end the inclusive rva at which the last instruction ends
+		/// @return the list of instructions which are contained within this range
+		std::pmr::vector<codec::dec::inst> dump_section(uint32_t rva_begin, uint32_t rva_end)
+		{
+			std::pmr::vector<codec::dec::inst> insts(resource);
+
+			// the sweep reads every byte once front to back, readahead keeps the next pages coming in
+			const uint32_t first = std::max(rva_begin, this->rva_begin);
+			const uint32_t last = std::min(rva_end, this->rva_end);
+			const std::span<const uint8_t> swept = first < last ? data.subspan(first - this->rva_begin, last - first) :
+				std::span<const uint8_t>();
+			const scoped_advice advice(swept, access_pattern::sequential, pattern);
+
+			uint32_t rva_current = rva_begin;
+			set_current_rva(rva_current);
+
+			while (rva_current < rva_end)
+			{
+				auto [result, size, status] = decode_current();
+				if (status != decode_status::ok)
+				{
+					// undecodable byte, resynchronize on the next one
+					rva_current++;
+					set_current_rva(rva_current);
+					continue;
+				}
+
+				insts.push_back(result);
+
+				rva_current += size;
+				set_current_rva(rva_current);
+			}
+
+			return insts;
+		}
+
+	private:
+		uint32_t rva_begin;
+		uint32_t rva_end;
+
+		std::span<const uint8_t> data;
+		uint32_t current_rva = 0;
+
+		/// @brief the pattern last passed to advise, phases restore it when they end
+		access_pattern pattern = access_pattern::normal;
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+		decode_counters counters;
+		bool timing = false;
+		uint64_t stall_threshold_ns = 0;
+
+		/// @brief decodes the block at an rva, get_block wraps it with the counters
+		basic_block decode_block(uint32_t rva)
+		{
+			set_current_rva(rva);
+
+			basic_block block(resource);
+			block.rva_begin = get_current_rva();
+			block.rva_end = block.rva_begin;
+
+			while (contains(block.rva_end))
+			{
+				auto [result, size, status] = decode_current();
+				if (status != decode_status::ok)
+				{
+					// the block keeps what decoded so far and discovery carries on with other targets
+					block.status = status;
+					break;
+				}
+
+				block.insts.push_back(result);
+				block.regs.push_back(get_inst_regs(result));
+
+				const uint16_t flags = get_inst_flags(result);
+				if (flags & inst_flag_call)
+					block.calls.push_back(get_call_site(result, block.rva_end));
+
+				// the terminating instruction belongs to the block, its branches are read before moving on
+				if (is_block_end(flags))
+				{
+					read_branches(block);
+					block.rva_end += size;
+					return block;
+				}
+
+				block.rva_end += size;
+				set_current_rva(block.rva_end);
+			}
+
+			mark_unterminated(block);
+			return block;
+		}
+
+		/// @brief flags a block which stopped without a terminator, either on bytes which did not decode or at the end of the segment
+		template <typename block_type>
+		void mark_unterminated(block_type& block) const
+		{
+			if (block.status == decode_status::ok)
+				block.status = contains(block.rva_begin) ? decode_status::truncated : decode_status::out_of_range;
+		}
+
+		/// @brief stores the branches of the instruction at the current rva into the block
+		template <typename block_type>
+		void read_branches(block_type& block)
+		{
+			auto branches = get_branches();
+			if (branches.size() > 0)
+				block.branch_one = branches[0];
+			if (branches.size() > 1)
+				block.branch_two = branches[1];
+		}
+
+		/// @brief decodes the header and every operand of the instruction at the current rva
+		/// @return the decoded instruction with its rva as runtime address, the formatted text is left empty
+		decode_result decode_current() override
+		{
+			if (!contains(current_rva))
+				return { {}, 0, decode_status::out_of_range };
+
+			const size_t offset = current_rva - rva_begin;
+
+			decode_result result{ {}, 0, decode_status::ok };
+			ZydisDecoderContext context;
+			const ZyanStatus status = ZydisDecoderDecodeInstruction(&lazy_inst::decoder(), &context,
+				data.data() + offset, data.size() - offset, &result.inst.info);
+
+			if (!ZYAN_SUCCESS(status))
+				return { {}, 0, status == ZYDIS_STATUS_NO_MORE_DATA ? decode_status::truncated : decode_status::invalid };
+
+			if (!ZYAN_SUCCESS(ZydisDecoderDecodeOperands(&lazy_inst::decoder(), &context, &result.inst.info,
+				result.inst.operands, result.inst.info.operand_count)))
+				return { {}, 0, decode_status::invalid };
+
+			result.inst.runtime_address = current_rva;
+			result.length = result.inst.info.length;
+			return result;
+		}
+
+		/// @brief decodes the instruction at the current rva and returns branches
+		/// @return the taken target first and the fall through second for conditional jumps, the target of relative jumps,
+		/// nothing for returns, indirect jumps and instructions which do not branch
+		std::vector<uint32_t> get_branches() override
+		{
+			std::vector<uint32_t> branches;
+
+			const auto [inst, length, status] = decode_current();
+			if (status != decode_status::ok)
+				return branches;
+
+			const uint16_t flags = get_inst_flags(inst);
+			if (!(flags & (inst_flag_cond_branch | inst_flag_uncond_branch)))
+				return branches;
+
+			const uint32_t next_rva = current_rva + length;
+			for (uint8_t i = 0; i < inst.info.operand_count_visible; i++)
+			{
+				const codec::dec::operand& op = inst.operands[i];
+				if (op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE && op.imm.is_relative)
+					branches.push_back(next_rva + static_cast<uint32_t>(op.imm.value.s));
+			}
+
+			if (flags & inst_flag_cond_branch)
+				branches.push_back(next_rva);
+
+			return branches;
+		}
+
+		/// @brief getter for the current rva
+		/// @return the current rva
+		uint32_t get_current_rva() override { return current_rva; }
+
+		/// @brief updates the current rva
+		/// @param rva new rva
+		/// @return old rva before replacement
+		uint32_t set_current_rva(uint32_t rva) override { return std::exchange(current_rva, rva); }
+	};
+}
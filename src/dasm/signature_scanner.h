@@ -0,0 +1,322 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define EAGLE_DASM_SSE2 1
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define EAGLE_DASM_SSSE3 1
+#endif
+
+#include "dasm/parallel.h"
+#include "dasm/segment_dasm.h"
+
+namespace eagle::dasm
+{
+	/// @brief location at which a signature matched
+	struct signature_match
+	{
+		uint32_t rva;
+		uint32_t signature;
+	};
+
+	/// @brief scans bytes for many ida style signatures ("48 8B ?? ?? E8") at once
+	/// every signature is anchored at its rarest fixed byte, the scan looks for anchor bytes only and verifies the
+	/// signatures anchored at a hit. any amount of anchor bytes is tested 16 bytes at a time with a nibble lookup
+	/// when ssse3 is available, sse2 compares every anchor byte and is used for up to 16 anchors
+	class signature_scanner
+	{
+	public:
+		/// @brief parses and adds a signature, compile must be called before the next scan
+		/// @param pattern hex bytes separated by spaces, ? or ?? is a wildcard byte
+		/// @return the id of the signature, nullopt if the pattern is malformed or has no fixed byte
+		std::optional<uint32_t> add(std::string_view pattern)
+		{
+			signature sig;
+			while (!pattern.empty())
+			{
+				const size_t token_begin = pattern.find_first_not_of(" \t");
+				if (token_begin == std::string_view::npos)
+					break;
+
+				pattern.remove_prefix(token_begin);
+				const size_t token_end = std::min(pattern.find_first_of(" \t"), pattern.size());
+				const std::string_view token = pattern.substr(0, token_end);
+				pattern.remove_prefix(token_end);
+
+				if (token == "?" || token == "??")
+				{
+					sig.bytes.push_back(0);
+					sig.mask.push_back(0);
+					continue;
+				}
+
+				const int high = hex_value(token[0]);
+				const int low = token.size() == 2 ? hex_value(token[1]) : -1;
+				if (high < 0 || low < 0)
+					return std::nullopt;
+
+				sig.bytes.push_back(static_cast<uint8_t>(high << 4 | low));
+				sig.mask.push_back(0xFF);
+			}
+
+			// the anchor is the fixed byte least likely to appear in code
+			bool has_anchor = false;
+			for (uint32_t i = 0; i < sig.bytes.size(); i++)
+			{
+				if (sig.mask[i] == 0)
+					continue;
+
+				if (!has_anchor || commonness(sig.bytes[i]) < commonness(sig.bytes[sig.anchor]))
+					sig.anchor = i;
+
+				has_anchor = true;
+			}
+
+			if (!has_anchor)
+				return std::nullopt;
+
+			signatures.push_back(std::move(sig));
+			compiled = false;
+
+			return static_cast<uint32_t>(signatures.size() - 1);
+		}
+
+		/// @brief builds the anchor tables of every added signature
+		void compile()
+		{
+			for (std::vector<uint32_t>& list : by_anchor)
+				list.clear();
+
+			anchor_bytes.clear();
+			anchor_set = {};
+			low_nibble_lookup = {};
+			for (uint32_t id = 0; id < signatures.size(); id++)
+			{
+				const uint8_t anchor = signatures[id].bytes[signatures[id].anchor];
+				if (by_anchor[anchor].empty())
+				{
+					anchor_bytes.push_back(anchor);
+					anchor_set[anchor / 64] |= 1ull << (anchor % 64);
+
+					// bit h of entry l is set if byte (h << 4 | l) is an anchor, high nibbles 8-15 use the second half
+					low_nibble_lookup[(anchor >> 7) * 16 + (anchor & 0xF)] |= static_cast<uint8_t>(1u << ((anchor >> 4) & 7));
+				}
+
+				by_anchor[anchor].push_back(id);
+			}
+
+			compiled = true;
+		}
+
+		/// @brief scans the bytes of a segment
+		/// @param dasm the segment
+		/// @param threads amount of threads, 0 uses parallel_threads()
+		/// @return every match sorted by rva, the rvas can be handed to get_block directly
+		std::vector<signature_match> scan(const segment_dasm& dasm, size_t threads = 0) const
+		{
+			return scan(dasm.get_bytes(), dasm.get_rva_begin(), threads);
+		}
+
+		/// @brief scans a range of bytes
+		/// @param data the bytes
+		/// @param rva_begin the rva of the first byte
+		/// @param threads amount of threads, 0 uses parallel_threads()
+		/// @return every match sorted by rva
+		std::vector<signature_match> scan(std::span<const uint8_t> data, uint32_t rva_begin, size_t threads = 0) const
+		{
+			if (!compiled || anchor_bytes.empty())
+				return {};
+
+			// chunks split the anchor positions, a signature start is only reported by the chunk holding its anchor
+			const size_t chunk_count = (data.size() + chunk_size - 1) / chunk_size;
+			std::vector<std::vector<signature_match>> found(chunk_count);
+			parallel_for(chunk_count, [&](size_t chunk, size_t)
+			{
+				const size_t begin = chunk * chunk_size;
+				const size_t end = std::min(begin + chunk_size, data.size());
+
+				for_each_anchor(data, begin, end, [&](size_t position)
+				{
+					verify(data, position, rva_begin, found[chunk]);
+				});
+			}, threads);
+
+			std::vector<signature_match> matches;
+			for (const std::vector<signature_match>& list : found)
+				matches.insert(matches.end(), list.begin(), list.end());
+
+			std::sort(matches.begin(), matches.end(), [](const signature_match& a, const signature_match& b)
+			{
+				return a.rva != b.rva ? a.rva < b.rva : a.signature < b.signature;
+			});
+
+			return matches;
+		}
+
+		/// @brief getter for the amount of added signatures
+		size_t size() const { return signatures.size(); }
+
+	private:
+		struct signature
+		{
+			std::vector<uint8_t> bytes;
+			std::vector<uint8_t> mask;
+			uint32_t anchor = 0;
+		};
+
+		static constexpr size_t chunk_size = 1 << 20;
+
+		std::vector<signature> signatures;
+		std::array<std::vector<uint32_t>, 256> by_anchor;
+		std::vector<uint8_t> anchor_bytes;
+
+		/// @brief 256 bit membership set of the anchor bytes
+		std::array<uint64_t, 4> anchor_set = {};
+
+		/// @brief the anchor set as two 16 entry tables indexed by the low nibble, for high nibbles 0-7 and 8-15
+		alignas(16) std::array<uint8_t, 32> low_nibble_lookup = {};
+
+		bool compiled = false;
+
+		static int hex_value(char c)
+		{
+			if (c >= '0' && c <= '9')
+				return c - '0';
+			if (c >= 'a' && c <= 'f')
+				return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F')
+				return c - 'A' + 10;
+
+			return -1;
+		}
+
+		/// @brief rough rank of how often a byte appears in x64 code, lower is rarer
+		static int commonness(uint8_t byte)
+		{
+			static constexpr uint8_t common[] = {
+				0x00, 0xFF, 0xCC, 0x48, 0x8B, 0x89, 0x24, 0x0F, 0x4C, 0x44, 0x8D, 0x83, 0x85, 0xE8,
+				0x01, 0x41, 0x45, 0x74, 0x75, 0xC3, 0x90, 0x40, 0x08, 0x10, 0x20, 0xC0, 0x4D, 0x49,
+			};
+
+			const uint8_t* it = std::find(std::begin(common), std::end(common), byte);
+			return it == std::end(common) ? 0 : static_cast<int>(std::end(common) - it);
+		}
+
+		/// @brief calls fn with every position in [begin, end) holding an anchor byte
+		template <typename function>
+		void for_each_anchor(std::span<const uint8_t> data, size_t begin, size_t end, function&& fn) const
+		{
+			if (anchor_bytes.size() == 1)
+			{
+				const uint8_t* base = data.data();
+				const uint8_t* current = base + begin;
+				const uint8_t* last = base + end;
+				while (current < last)
+				{
+					current = static_cast<const uint8_t*>(std::memchr(current, anchor_bytes[0], last - current));
+					if (current == nullptr)
+						break;
+
+					fn(static_cast<size_t>(current - base));
+					current++;
+				}
+
+				return;
+			}
+
+			size_t position = begin;
+#if defined(EAGLE_DASM_SSSE3)
+			const __m128i low_lookup = _mm_load_si128(reinterpret_cast<const __m128i*>(low_nibble_lookup.data()));
+			const __m128i high_lookup = _mm_load_si128(reinterpret_cast<const __m128i*>(low_nibble_lookup.data() + 16));
+			const __m128i bit_lookup = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+			const __m128i nibble = _mm_set1_epi8(0x0F);
+			const __m128i top_bit = _mm_set1_epi8(-128);
+
+			for (; position + 16 <= end; position += 16)
+			{
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + position));
+				const __m128i low = _mm_and_si128(block, nibble);
+				const __m128i high = _mm_and_si128(_mm_srli_epi16(block, 4), nibble);
+
+				// pshufb yields 0 for indices with the top bit set, which selects the table half of each byte
+				const __m128i top = _mm_and_si128(block, top_bit);
+				const __m128i rows = _mm_or_si128(_mm_shuffle_epi8(low_lookup, _mm_or_si128(low, top)),
+					_mm_shuffle_epi8(high_lookup, _mm_or_si128(low, _mm_xor_si128(top, top_bit))));
+
+				const __m128i hits = _mm_and_si128(rows, _mm_shuffle_epi8(bit_lookup, high));
+				uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128()))) & 0xFFFF;
+				while (mask != 0)
+				{
+					fn(position + std::countr_zero(mask));
+					mask &= mask - 1;
+				}
+			}
+#elif defined(EAGLE_DASM_SSE2)
+			if (anchor_bytes.size() <= 16)
+			{
+				__m128i needles[16];
+				for (size_t i = 0; i < anchor_bytes.size(); i++)
+					needles[i] = _mm_set1_epi8(static_cast<char>(anchor_bytes[i]));
+
+				for (; position + 16 <= end; position += 16)
+				{
+					const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + position));
+
+					__m128i hits = _mm_setzero_si128();
+					for (size_t i = 0; i < anchor_bytes.size(); i++)
+						hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+
+					uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+					while (mask != 0)
+					{
+						fn(position + std::countr_zero(mask));
+						mask &= mask - 1;
+					}
+				}
+			}
+#endif
+
+			for (; position < end; position++)
+			{
+				const uint8_t byte = data[position];
+				if (anchor_set[byte / 64] & (1ull << (byte % 64)))
+					fn(position);
+			}
+		}
+
+		/// @brief verifies every signature anchored at the byte of a position
+		void verify(std::span<const uint8_t> data, size_t position, uint32_t rva_begin,
+			std::vector<signature_match>& matches) const
+		{
+			for (uint32_t id : by_anchor[data[position]])
+			{
+				const signature& sig = signatures[id];
+				if (position < sig.anchor || position - sig.anchor + sig.bytes.size() > data.size())
+					continue;
+
+				const size_t start = position - sig.anchor;
+
+				bool matched = true;
+				for (size_t i = 0; i < sig.bytes.size() && matched; i++)
+					matched = (data[start + i] & sig.mask[i]) == sig.bytes[i];
+
+				if (matched)
+					matches.push_back({ rva_begin + static_cast<uint32_t>(start), id });
+			}
+		}
+	};
+}
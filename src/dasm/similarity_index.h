@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/function_map.h"
+#include "dasm/parallel.h"
+
+namespace eagle::dasm
+{
+	/// @brief minhash signature of a function, two signatures agree in about as many slots as the jaccard similarity
+	/// of the feature sets they were computed from
+	constexpr size_t minhash_size = 64;
+	using minhash = std::array<uint32_t, minhash_size>;
+
+	/// @brief computes minhash signatures of functions from mnemonic trigrams inside of blocks and the shape of every
+	/// block in the graph, its size bucket, in-degree and out-degree
+	class minhash_extractor
+	{
+	public:
+		/// @param blocks the recovered blocks
+		/// @param index index over the same blocks
+		/// @param functions the function partition of the blocks
+		minhash_extractor(const block_list& blocks, const block_index& index, const function_map& functions)
+			: blocks(blocks), index(index), functions(functions), in_degree(blocks.size(), 0)
+		{
+			for (const basic_block& block : blocks)
+				for_each_successor(block, index, [&](uint32_t successor) { in_degree[successor]++; });
+		}
+
+		/// @brief computes the signature of a function
+		minhash signature(uint32_t function) const
+		{
+			minhash result;
+			result.fill(0xFFFFFFFF);
+
+			auto add = [&](uint64_t feature)
+			{
+				for (size_t slot = 0; slot < minhash_size; slot++)
+					result[slot] = std::min(result[slot], static_cast<uint32_t>(mix(feature ^ seeds[slot])));
+			};
+
+			for (uint32_t block : functions.blocks(function))
+			{
+				const basic_block& b = blocks[block];
+
+				uint32_t out_degree = 0;
+				for_each_successor(b, index, [&](uint32_t) { out_degree++; });
+
+				const uint32_t size_bucket = std::bit_width(b.insts.size());
+				add(0x5348415045000000ull | (size_bucket << 16) | (std::min(in_degree[block], 255u) << 8) | out_degree);
+
+				for (size_t i = 0; i + 2 < b.insts.size(); i++)
+				{
+					add((static_cast<uint64_t>(b.insts[i].info.mnemonic) << 32) |
+						(static_cast<uint64_t>(b.insts[i + 1].info.mnemonic) << 16) | b.insts[i + 2].info.mnemonic);
+				}
+
+				// blocks shorter than a trigram still contribute their mnemonics
+				if (b.insts.size() < 3)
+				{
+					for (const codec::dec::inst& inst : b.insts)
+						add(0x4D4E454D00000000ull | inst.info.mnemonic);
+				}
+			}
+
+			return result;
+		}
+
+		/// @brief computes the signature of every function in parallel
+		std::vector<minhash> signatures(size_t threads = 0) const
+		{
+			std::vector<minhash> result(functions.size());
+			parallel_for(functions.size(), [&](size_t function, size_t)
+			{
+				result[function] = signature(static_cast<uint32_t>(function));
+			}, threads);
+
+			return result;
+		}
+
+	private:
+		const block_list& blocks;
+		const block_index& index;
+		const function_map& functions;
+		std::vector<uint32_t> in_degree;
+
+		static constexpr uint64_t mix(uint64_t value)
+		{
+			value ^= value >> 33;
+			value *= 0xFF51AFD7ED558CCD;
+			value ^= value >> 33;
+			value *= 0xC4CEB9FE1A85EC53;
+			value ^= value >> 33;
+			return value;
+		}
+
+		static constexpr std::array<uint64_t, minhash_size> make_seeds()
+		{
+			std::array<uint64_t, minhash_size> result = {};
+			for (size_t slot = 0; slot < minhash_size; slot++)
+				result[slot] = mix(0x9E3779B97F4A7C15ull * (slot + 1));
+
+			return result;
+		}
+
+		static const std::array<uint64_t, minhash_size> seeds;
+	};
+
+	// defined after the class so make_seeds is complete when it is evaluated
+	inline constexpr std::array<uint64_t, minhash_size> minhash_extractor::seeds = minhash_extractor::make_seeds();
+
+	struct similarity_hit
+	{
+		/// @brief the id the function was added with
+		uint64_t id;
+
+		/// @brief estimated jaccard similarity, the fraction of equal signature slots
+		float similarity;
+	};
+
+	/// @brief on-disk layout shared by the builder and the mapped index
+	/// header, ids, signatures and one hash sorted (band hash, item) table per band, every section 8 byte aligned
+	struct similarity_index_layout
+	{
+		static constexpr uint32_t magic = 0x58494D53; // SMIX
+		static constexpr uint32_t version = 1;
+
+		/// @brief rows per band, 16 bands of 4 rows find pairs above ~0.5 similarity with high probability
+		static constexpr uint32_t rows = 4;
+		static constexpr uint32_t bands = minhash_size / rows;
+
+		struct header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t signature_size;
+			uint32_t band_count;
+			uint64_t count;
+			uint64_t reserved;
+		};
+
+		struct band_entry
+		{
+			uint64_t hash;
+			uint64_t item;
+		};
+
+		static uint64_t band_hash(const minhash& signature, uint32_t band)
+		{
+			uint64_t h = 0xCBF29CE484222325 ^ band;
+			for (uint32_t row = 0; row < rows; row++)
+				h = (h ^ signature[band * rows + row]) * 0x100000001B3;
+
+			return h;
+		}
+	};
+
+	/// @brief collects signatures and writes them as a similarity index file
+	class similarity_index_builder
+	{
+	public:
+		/// @brief adds a function
+		/// @param id caller defined id returned by queries, such as an image id and entry rva packed together
+		/// @param signature the minhash of the function
+		void add(uint64_t id, const minhash& signature)
+		{
+			ids.push_back(id);
+			signatures.push_back(signature);
+		}
+
+		/// @brief getter for the amount of added functions
+		size_t size() const { return ids.size(); }
+
+		/// @brief writes the index file
+		/// @param path the file to create
+		/// @return true if the file was written completely
+		bool save(const std::string& path) const
+		{
+			using layout = similarity_index_layout;
+
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			if (!out)
+				return false;
+
+			const layout::header header = { layout::magic, layout::version, minhash_size, layout::bands, ids.size(), 0 };
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint64_t));
+			out.write(reinterpret_cast<const char*>(signatures.data()), signatures.size() * sizeof(minhash));
+
+			std::vector<layout::band_entry> table(ids.size());
+			for (uint32_t band = 0; band < layout::bands; band++)
+			{
+				for (uint64_t item = 0; item < ids.size(); item++)
+					table[item] = { layout::band_hash(signatures[item], band), item };
+
+				std::sort(table.begin(), table.end(), [](const layout::band_entry& a, const layout::band_entry& b)
+				{
+					return a.hash != b.hash ? a.hash < b.hash : a.item < b.item;
+				});
+
+				out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(layout::band_entry));
+			}
+
+			return out.good();
+		}
+
+	private:
+		std::vector<uint64_t> ids;
+		std::vector<minhash> signatures;
+	};
+
+	/// @brief read only similarity index mapped from a file, queries touch only the band ranges they hit and the
+	/// signatures of the candidates so the index does not need to fit into memory
+	class similarity_index
+	{
+	public:
+		similarity_index(const similarity_index&) = delete;
+		similarity_index& operator=(const similarity_index&) = delete;
+
+		similarity_index(similarity_index&& other) noexcept
+			: mapping(std::exchange(other.mapping, nullptr)), mapping_size(std::exchange(other.mapping_size, 0)),
+			  count(other.count), ids(other.ids), signatures(other.signatures), tables(other.tables)
+		{
+		}
+
+		~similarity_index()
+		{
+			if (mapping)
+				munmap(mapping, mapping_size);
+		}
+
+		/// @brief maps an index file written by similarity_index_builder
+		/// @param path the index file
+		/// @return the index, nullopt if the file cannot be mapped or is not a valid index
+		static std::optional<similarity_index> open(const std::string& path)
+		{
+			using layout = similarity_index_layout;
+
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return std::nullopt;
+
+			struct stat info = {};
+			if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(layout::header))
+			{
+				close(fd);
+				return std::nullopt;
+			}
+
+			void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if (mapped == MAP_FAILED)
+				return std::nullopt;
+
+			similarity_index index(mapped, info.st_size);
+
+			const auto& header = *static_cast<const layout::header*>(mapped);
+			const size_t per_item = sizeof(uint64_t) + sizeof(minhash) + layout::bands * sizeof(layout::band_entry);
+
+			// the count is bounded by the file before it is multiplied, a corrupt count cannot wrap the size check
+			if (header.magic != layout::magic || header.version != layout::version ||
+				header.signature_size != minhash_size || header.band_count != layout::bands ||
+				header.count > (index.mapping_size - sizeof(layout::header)) / per_item ||
+				sizeof(layout::header) + header.count * per_item != index.mapping_size)
+				return std::nullopt;
+
+			const uint8_t* cursor = static_cast<const uint8_t*>(mapped) + sizeof(layout::header);
+			index.count = header.count;
+			index.ids = reinterpret_cast<const uint64_t*>(cursor);
+			cursor += header.count * sizeof(uint64_t);
+			index.signatures = reinterpret_cast<const minhash*>(cursor);
+			cursor += header.count * sizeof(minhash);
+			index.tables = reinterpret_cast<const layout::band_entry*>(cursor);
+
+			// band lookups jump around the tables
+			madvise(mapped, info.st_size, MADV_RANDOM);
+			return index;
+		}
+
+		/// @brief getter for the amount of indexed functions
+		size_t size() const { return count; }
+
+		/// @brief finds the most similar indexed functions
+		/// @param signature the minhash of the query function
+		/// @param k the maximum amount of results
+		/// @param min_similarity results below this estimate are dropped
+		/// @return the hits sorted by descending similarity
+		std::vector<similarity_hit> query(const minhash& signature, size_t k, float min_similarity = 0.0f) const
+		{
+			using layout = similarity_index_layout;
+
+			std::vector<uint64_t> candidates;
+			for (uint32_t band = 0; band < layout::bands; band++)
+			{
+				const layout::band_entry* first = tables + band * count;
+				const layout::band_entry* last = first + count;
+				const uint64_t hash = layout::band_hash(signature, band);
+
+				auto [begin, end] = std::equal_range(first, last, layout::band_entry { hash, 0 },
+					[](const layout::band_entry& a, const layout::band_entry& b) { return a.hash < b.hash; });
+
+				for (auto it = begin; it != end; ++it)
+					candidates.push_back(it->item);
+			}
+
+			std::sort(candidates.begin(), candidates.end());
+			candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+			std::vector<similarity_hit> hits;
+			hits.reserve(candidates.size());
+			for (uint64_t item : candidates)
+			{
+				uint32_t equal = 0;
+				for (size_t slot = 0; slot < minhash_size; slot++)
+					equal += signatures[item][slot] == signature[slot];
+
+				const float similarity = static_cast<float>(equal) / minhash_size;
+				if (similarity >= min_similarity)
+					hits.push_back({ ids[item], similarity });
+			}
+
+			const size_t keep = std::min(k, hits.size());
+			std::partial_sort(hits.begin(), hits.begin() + keep, hits.end(), [](const similarity_hit& a, const similarity_hit& b)
+			{
+				return a.similarity != b.similarity ? a.similarity > b.similarity : a.id < b.id;
+			});
+
+			hits.resize(keep);
+			return hits;
+		}
+
+	private:
+		void* mapping;
+		size_t mapping_size;
+
+		uint64_t count = 0;
+		const uint64_t* ids = nullptr;
+		const minhash* signatures = nullptr;
+		const similarity_index_layout::band_entry* tables = nullptr;
+
+		similarity_index(void* mapping, size_t mapping_size)
+			: mapping(mapping), mapping_size(mapping_size)
+		{
+		}
+	};
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace eagle::dasm
+{
+	/// @brief vector which keeps up to N elements inside of itself and spills to its allocator beyond that
+	/// used for the per-block lists which are short for almost every block, so decoding a typical block does not
+	/// allocate for them and a traversal finds them next to the rest of the block. only trivially copyable elements
+	/// are supported, moving an inline vector copies its elements
+	template <typename T, size_t N>
+	class small_vector
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "small_vector relocates elements with memcpy");
+		static_assert(N > 0, "small_vector needs inline capacity");
+
+	public:
+		using allocator_type = std::pmr::polymorphic_allocator<>;
+		using value_type = T;
+		using size_type = size_t;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		small_vector() = default;
+
+		explicit small_vector(const allocator_type& alloc)
+			: alloc(alloc)
+		{
+		}
+
+		small_vector(const small_vector& other)
+			: small_vector(other, allocator_type())
+		{
+		}
+
+		small_vector(const small_vector& other, const allocator_type& alloc)
+			: alloc(alloc)
+		{
+			assign(other.begin(), other.size());
+		}
+
+		small_vector(small_vector&& other) noexcept
+			: alloc(other.alloc)
+		{
+			take(other);
+		}
+
+		small_vector(small_vector&& other, const allocator_type& alloc)
+			: alloc(alloc)
+		{
+			if (other.alloc == alloc)
+				take(other);
+			else
+				assign(other.begin(), other.size());
+		}
+
+		small_vector& operator=(const small_vector& other)
+		{
+			if (this != &other)
+			{
+				count = 0;
+				assign(other.begin(), other.size());
+			}
+
+			return *this;
+		}
+
+		small_vector& operator=(small_vector&& other) noexcept
+		{
+			if (this == &other)
+				return *this;
+
+			if (other.alloc == alloc)
+			{
+				release();
+				take(other);
+			}
+			else
+			{
+				count = 0;
+				assign(other.begin(), other.size());
+			}
+
+			return *this;
+		}
+
+		~small_vector()
+		{
+			release();
+		}
+
+		allocator_type get_allocator() const { return alloc; }
+
+		size_t size() const { return count; }
+		size_t capacity() const { return limit; }
+		bool empty() const { return count == 0; }
+
+		/// @brief checks if the elements are still stored inside of the vector
+		bool is_inline() const { return items == inline_items(); }
+
+		T* data() { return items; }
+		const T* data() const { return items; }
+
+		iterator begin() { return items; }
+		iterator end() { return items + count; }
+		const_iterator begin() const { return items; }
+		const_iterator end() const { return items + count; }
+
+		T& operator[](size_t i) { return items[i]; }
+		const T& operator[](size_t i) const { return items[i]; }
+
+		T& front() { return items[0]; }
+		const T& front() const { return items[0]; }
+		T& back() { return items[count - 1]; }
+		const T& back() const { return items[count - 1]; }
+
+		void push_back(const T& value)
+		{
+			if (count == limit)
+			{
+				// the value may live inside of the storage which is about to be replaced
+				const T copy = value;
+				grow(limit * 2);
+				items[count++] = copy;
+				return;
+			}
+
+			items[count++] = value;
+		}
+
+		template <typename... args_t>
+		T& emplace_back(args_t&&... args)
+		{
+			if (count == limit)
+				grow(limit * 2);
+
+			T* slot = ::new (static_cast<void*>(items + count)) T{ std::forward<args_t>(args)... };
+			count++;
+			return *slot;
+		}
+
+		void pop_back() { count--; }
+		void clear() { count = 0; }
+
+		void reserve(size_t new_capacity)
+		{
+			if (new_capacity > limit)
+				grow(new_capacity);
+		}
+
+		void resize(size_t new_size)
+		{
+			reserve(new_size);
+			for (size_t i = count; i < new_size; i++)
+				::new (static_cast<void*>(items + i)) T{};
+
+			count = new_size;
+		}
+
+	private:
+		allocator_type alloc;
+		T* items = inline_items();
+		size_t count = 0;
+		size_t limit = N;
+		alignas(T) std::byte storage[sizeof(T) * N];
+
+		T* inline_items() { return reinterpret_cast<T*>(storage); }
+		const T* inline_items() const { return reinterpret_cast<const T*>(storage); }
+
+		void grow(size_t new_capacity)
+		{
+			new_capacity = std::max(new_capacity, N * 2);
+
+			T* spilled = alloc.allocate_object<T>(new_capacity);
+			if (count)
+				std::memcpy(spilled, items, count * sizeof(T));
+
+			release();
+			items = spilled;
+			limit = new_capacity;
+		}
+
+		/// @brief copies elements into the existing storage, growing it if they do not fit
+		void assign(const T* first, size_t amount)
+		{
+			reserve(amount);
+			if (amount)
+				std::memcpy(items, first, amount * sizeof(T));
+
+			count = amount;
+		}
+
+		/// @brief steals the spilled storage of a vector with an equal allocator, inline elements are copied
+		void take(small_vector& other)
+		{
+			if (other.is_inline())
+			{
+				items = inline_items();
+				limit = N;
+				count = 0;
+				assign(other.begin(), other.size());
+			}
+			else
+			{
+				items = std::exchange(other.items, other.inline_items());
+				limit = std::exchange(other.limit, N);
+				count = other.count;
+			}
+
+			other.count = 0;
+		}
+
+		/// @brief returns spilled storage to the allocator and falls back to the inline storage
+		void release()
+		{
+			if (!is_inline())
+				alloc.deallocate_object(items, limit);
+
+			items = inline_items();
+			limit = N;
+		}
+	};
+}
@@ -0,0 +1,701 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "codec/zydis_defs.h"
+#include "dasm/basic_block.h"
+#include "dasm/function_cfg.h"
+#include "dasm/inst_util.h"
+#include "dasm/liveness.h"
+
+namespace eagle::dasm
+{
+	/// @brief value id which does not refer to any value
+	constexpr uint32_t no_value = 0xFFFFFFFF;
+
+	enum class ssa_op : uint8_t
+	{
+		/// @brief imm holds the value
+		constant,
+
+		/// @brief value of register reg when the function is entered
+		entry,
+
+		/// @brief one operand per predecessor of the block in predecessor order, phis of the entry block
+		/// have the value at function entry as an additional last operand
+		phi,
+
+		copy,
+
+		/// @brief unknown value written by something the lifter does not model, reg holds the register, the operands
+		/// are values it is partly computed from
+		opaque,
+
+		/// @brief operand 0 truncated to imm bits
+		trunc,
+
+		/// @brief operand 0 sign extended from imm bits
+		sext,
+
+		add,
+		sub,
+		mul,
+		and_,
+		or_,
+		xor_,
+		shl,
+		shr,
+		sar,
+		neg,
+		not_,
+
+		/// @brief operand 0 is the address, imm holds the size in bits
+		load,
+
+		/// @brief operand 0 is the address, operand 1 the stored value
+		store,
+
+		/// @brief flags of operand 0 - operand 1
+		compare,
+
+		/// @brief flags of operand 0 & operand 1
+		test,
+
+		/// @brief operand 0 is the target, the value is the return value
+		call,
+
+		/// @brief operand 0 is the target
+		branch,
+
+		/// @brief operand 0 is the flags, imm holds the mnemonic of the conditional jump
+		cond_branch,
+
+		/// @brief operand 0 is the returned value
+		ret,
+	};
+
+	/// @brief instruction of the ssa ir, the value it defines is identified by its position in ssa_function::insts
+	struct ssa_inst
+	{
+		ssa_op op;
+		uint8_t reg;
+		uint16_t operand_count;
+		uint32_t first_operand;
+		uint32_t block;
+		uint32_t rva;
+		uint64_t imm;
+	};
+
+	/// @brief block of the ssa ir, its phis and body are ranges of ssa_function::order
+	struct ssa_block
+	{
+		uint32_t first_phi;
+		uint32_t phi_count;
+		uint32_t first_body;
+		uint32_t body_count;
+	};
+
+	/// @brief ssa form of one function stored in flat arrays over the analysis arena
+	/// blocks use the local ids of the function_cfg the function was lifted from
+	class ssa_function
+	{
+	public:
+		explicit ssa_function(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: insts(resource), operands(resource), blocks(resource), order(resource)
+		{
+		}
+
+		std::pmr::vector<ssa_inst> insts;
+		std::pmr::vector<uint32_t> operands;
+		std::pmr::vector<ssa_block> blocks;
+		std::pmr::vector<uint32_t> order;
+
+		/// @brief getter for the operand values of a value
+		std::span<const uint32_t> operands_of(uint32_t value) const
+		{
+			const ssa_inst& inst = insts[value];
+			return std::span(operands).subspan(inst.first_operand, inst.operand_count);
+		}
+
+		/// @brief getter for the phis of a block
+		std::span<const uint32_t> phis(uint32_t block) const
+		{
+			return std::span(order).subspan(blocks[block].first_phi, blocks[block].phi_count);
+		}
+
+		/// @brief getter for the instructions of a block after its phis, in execution order
+		std::span<const uint32_t> body(uint32_t block) const
+		{
+			return std::span(order).subspan(blocks[block].first_body, blocks[block].body_count);
+		}
+	};
+
+	/// @brief lifts the blocks of a function into ssa form
+	///
+	/// the general purpose registers and the flags are the variables, ssa is constructed on the fly while the
+	/// blocks are lifted in reverse post-order (braun et al., simple and efficient construction of ssa form).
+	/// memory is not renamed, loads and stores stay in program order. partial register writes and instructions
+	/// the lifter does not model define opaque values for every register they write
+	class ssa_lifter
+	{
+	public:
+		/// @param blocks the recovered blocks
+		/// @param cfg the graph of the function to lift
+		/// @param abi registers destroyed by calls
+		ssa_lifter(const block_list& blocks, const function_cfg& cfg, liveness_abi abi = liveness_abi::win64())
+			: blocks(blocks), cfg(cfg), abi(abi)
+		{
+		}
+
+		/// @brief lifts the function
+		/// @param resource the resource the ir arrays are allocated from
+		/// @return the ssa function
+		ssa_function lift(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+		{
+			ssa_function result(resource);
+			fn = &result;
+
+			const size_t count = cfg.size();
+			fn->blocks.assign(count, ssa_block{ 0, 0, 0, 0 });
+
+			current_def.assign(count * variable_count, no_value);
+			entry_values.fill(no_value);
+			sealed.assign(count, false);
+			filled.assign(count, false);
+			incomplete.assign(count, {});
+			phi_ids.clear();
+
+			std::vector<uint32_t> body;
+			for (uint32_t local = 0; local < count; local++)
+			{
+				if (cfg.predecessors(local).empty())
+					seal(local);
+			}
+
+			for (uint32_t local : cfg.reverse_postorder())
+			{
+				current_block = local;
+				body_ids = &body;
+
+				const uint32_t first_body = static_cast<uint32_t>(body.size());
+				lift_block(blocks[cfg.block(local)]);
+
+				fn->blocks[local].first_body = first_body;
+				fn->blocks[local].body_count = static_cast<uint32_t>(body.size()) - first_body;
+				filled[local] = true;
+
+				for (uint32_t successor : cfg.successors(local))
+					try_seal(successor);
+			}
+
+			for (uint32_t local = 0; local < count; local++)
+			{
+				if (!sealed[local])
+					seal(local);
+			}
+
+			// phis of each block first, then the bodies in lift order
+			std::sort(phi_ids.begin(), phi_ids.end(), [&](uint32_t a, uint32_t b)
+			{
+				return fn->insts[a].block != fn->insts[b].block ? fn->insts[a].block < fn->insts[b].block : a < b;
+			});
+
+			fn->order.reserve(phi_ids.size() + body.size());
+			for (size_t i = 0; i < phi_ids.size();)
+			{
+				const uint32_t block = fn->insts[phi_ids[i]].block;
+				fn->blocks[block].first_phi = static_cast<uint32_t>(fn->order.size());
+
+				for (; i < phi_ids.size() && fn->insts[phi_ids[i]].block == block; i++)
+					fn->order.push_back(phi_ids[i]);
+
+				fn->blocks[block].phi_count = static_cast<uint32_t>(fn->order.size()) - fn->blocks[block].first_phi;
+			}
+
+			const uint32_t body_offset = static_cast<uint32_t>(fn->order.size());
+			fn->order.insert(fn->order.end(), body.begin(), body.end());
+			for (ssa_block& block : fn->blocks)
+				block.first_body += body_offset;
+
+			fn = nullptr;
+			return result;
+		}
+
+	private:
+		/// @brief 16 general purpose registers and the flags
+		static constexpr uint32_t variable_count = 17;
+		static constexpr uint32_t flags_variable = 16;
+
+		const block_list& blocks;
+		const function_cfg& cfg;
+		liveness_abi abi;
+
+		ssa_function* fn = nullptr;
+
+		std::vector<uint32_t> current_def;
+		std::array<uint32_t, variable_count> entry_values{};
+		std::vector<bool> sealed;
+		std::vector<bool> filled;
+		std::vector<std::vector<std::pair<uint32_t, uint32_t>>> incomplete;
+		std::vector<uint32_t> phi_ids;
+
+		uint32_t current_block = 0;
+		uint32_t current_rva = 0;
+		std::vector<uint32_t>* body_ids = nullptr;
+
+		uint32_t emit(ssa_op op, std::initializer_list<uint32_t> args, uint64_t imm = 0, uint8_t reg = 0)
+		{
+			const uint32_t id = static_cast<uint32_t>(fn->insts.size());
+			fn->insts.push_back({ op, reg, static_cast<uint16_t>(args.size()), static_cast<uint32_t>(fn->operands.size()),
+				current_block, current_rva, imm });
+			fn->operands.insert(fn->operands.end(), args.begin(), args.end());
+
+			body_ids->push_back(id);
+			return id;
+		}
+
+		uint32_t constant(uint64_t value)
+		{
+			return emit(ssa_op::constant, {}, value);
+		}
+
+		uint32_t new_phi(uint32_t block)
+		{
+			const uint32_t id = static_cast<uint32_t>(fn->insts.size());
+			const uint16_t count = static_cast<uint16_t>(incoming(block));
+
+			fn->insts.push_back({ ssa_op::phi, 0, count, static_cast<uint32_t>(fn->operands.size()), block, 0, 0 });
+			fn->operands.resize(fn->operands.size() + count, no_value);
+
+			phi_ids.push_back(id);
+			return id;
+		}
+
+		uint32_t& def(uint32_t variable, uint32_t block)
+		{
+			return current_def[block * variable_count + variable];
+		}
+
+		void write(uint32_t variable, uint32_t value)
+		{
+			def(variable, current_block) = value;
+		}
+
+		uint32_t read(uint32_t variable, uint32_t block)
+		{
+			// chains of sealed single predecessor blocks are walked without recursion
+			std::vector<uint32_t> path;
+			while (def(variable, block) == no_value && sealed[block] && incoming(block) == 1 && block != 0)
+			{
+				path.push_back(block);
+				block = cfg.predecessors(block)[0];
+			}
+
+			uint32_t value = def(variable, block);
+			if (value == no_value)
+				value = read_recursive(variable, block);
+
+			for (uint32_t visited : path)
+				def(variable, visited) = value;
+
+			return value;
+		}
+
+		uint32_t read_recursive(uint32_t variable, uint32_t block)
+		{
+			uint32_t value;
+			if (!sealed[block])
+			{
+				value = new_phi(block);
+				incomplete[block].push_back({ variable, value });
+			}
+			else if (block == 0 && cfg.predecessors(block).empty())
+			{
+				value = entry_value(variable);
+			}
+			else if (incoming(block) == 1)
+			{
+				value = read(variable, cfg.predecessors(block)[0]);
+			}
+			else
+			{
+				value = new_phi(block);
+				def(variable, block) = value;
+				value = add_phi_operands(variable, value);
+			}
+
+			def(variable, block) = value;
+			return value;
+		}
+
+		uint32_t entry_value(uint32_t variable)
+		{
+			if (entry_values[variable] == no_value)
+			{
+				const uint32_t id = static_cast<uint32_t>(fn->insts.size());
+				fn->insts.push_back({ ssa_op::entry, static_cast<uint8_t>(variable), 0, 0, 0, 0, 0 });
+
+				// entry values belong to the entry block ahead of its body
+				phi_ids.push_back(id);
+				entry_values[variable] = id;
+			}
+
+			return entry_values[variable];
+		}
+
+		/// @brief amount of edges entering a block, the entry block is also entered by the function call
+		uint32_t incoming(uint32_t block) const
+		{
+			return static_cast<uint32_t>(cfg.predecessors(block).size()) + (block == 0 ? 1 : 0);
+		}
+
+		uint32_t add_phi_operands(uint32_t variable, uint32_t phi)
+		{
+			const uint32_t block = fn->insts[phi].block;
+			const std::span<const uint32_t> preds = cfg.predecessors(block);
+			for (size_t i = 0; i < preds.size(); i++)
+			{
+				const uint32_t value = read(variable, preds[i]);
+				fn->operands[fn->insts[phi].first_operand + i] = value;
+			}
+
+			if (block == 0)
+				fn->operands[fn->insts[phi].first_operand + preds.size()] = entry_value(variable);
+
+			return remove_trivial_phi(phi);
+		}
+
+		/// @brief turns a phi whose operands are all the same value (or itself) into a copy of that value
+		uint32_t remove_trivial_phi(uint32_t phi)
+		{
+			uint32_t same = no_value;
+			for (uint32_t i = 0; i < fn->insts[phi].operand_count; i++)
+			{
+				const uint32_t value = fn->operands[fn->insts[phi].first_operand + i];
+				if (value == same || value == phi)
+					continue;
+
+				if (same != no_value)
+					return phi;
+
+				same = value;
+			}
+
+			if (same == no_value)
+				return phi;
+
+			fn->insts[phi].op = ssa_op::copy;
+			fn->insts[phi].operand_count = 1;
+			fn->operands[fn->insts[phi].first_operand] = same;
+			return phi;
+		}
+
+		void try_seal(uint32_t block)
+		{
+			if (sealed[block])
+				return;
+
+			for (uint32_t pred : cfg.predecessors(block))
+			{
+				if (!filled[pred])
+					return;
+			}
+
+			seal(block);
+		}
+
+		void seal(uint32_t block)
+		{
+			sealed[block] = true;
+			for (const auto& [variable, phi] : incomplete[block])
+				add_phi_operands(variable, phi);
+
+			incomplete[block].clear();
+		}
+
+		static int32_t variable_of(codec::reg reg)
+		{
+			const uint64_t mask = get_reg_mask(reg);
+			if (mask & reg_mask_gpr)
+				return std::countr_zero(mask);
+			if (mask & reg_mask_flags)
+				return flags_variable;
+
+			return -1;
+		}
+
+		uint32_t opaque(uint32_t variable)
+		{
+			return emit(ssa_op::opaque, {}, 0, static_cast<uint8_t>(variable));
+		}
+
+		uint32_t address(const codec::dec::inst& inst, const codec::dec::operand& op)
+		{
+			if (op.mem.base == ZYDIS_REGISTER_RIP)
+				return constant(current_rva + inst.info.length + op.mem.disp.value);
+
+			// fs and gs relative addresses point into thread local data whose base is unknown
+			if (op.mem.segment == ZYDIS_REGISTER_FS || op.mem.segment == ZYDIS_REGISTER_GS)
+				return opaque(0xFF);
+
+			uint32_t value = no_value;
+			if (op.mem.base != ZYDIS_REGISTER_NONE)
+				value = read_register(op.mem.base);
+
+			if (op.mem.index != ZYDIS_REGISTER_NONE)
+			{
+				uint32_t scaled = read_register(op.mem.index);
+				if (op.mem.scale > 1)
+					scaled = emit(ssa_op::shl, { scaled, constant(std::countr_zero(static_cast<uint32_t>(op.mem.scale))) });
+
+				value = value == no_value ? scaled : emit(ssa_op::add, { value, scaled });
+			}
+
+			const uint32_t disp = constant(static_cast<uint64_t>(op.mem.disp.value));
+			return value == no_value ? disp : emit(ssa_op::add, { value, disp });
+		}
+
+		uint32_t read_register(codec::reg reg)
+		{
+			const int32_t variable = variable_of(reg);
+			if (variable < 0)
+				return opaque(0xFF);
+
+			return read(variable, current_block);
+		}
+
+		uint32_t read_operand(const codec::dec::inst& inst, const codec::dec::operand& op)
+		{
+			switch (op.type)
+			{
+				case ZYDIS_OPERAND_TYPE_REGISTER:
+				{
+					const uint32_t value = read_register(op.reg.value);
+					if (variable_of(op.reg.value) >= 0 && variable_of(op.reg.value) != flags_variable && op.size < 64)
+						return emit(ssa_op::trunc, { value }, op.size);
+
+					return value;
+				}
+				case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+				{
+					if (op.imm.is_relative)
+						return constant(current_rva + inst.info.length + op.imm.value.s);
+
+					return constant(op.imm.value.u);
+				}
+				case ZYDIS_OPERAND_TYPE_MEMORY:
+					return emit(ssa_op::load, { address(inst, op) }, op.size);
+				default:
+					return opaque(0xFF);
+			}
+		}
+
+		void write_operand(const codec::dec::inst& inst, const codec::dec::operand& op, uint32_t value)
+		{
+			if (op.type == ZYDIS_OPERAND_TYPE_MEMORY)
+			{
+				emit(ssa_op::store, { address(inst, op), value }, op.size);
+				return;
+			}
+
+			const int32_t variable = variable_of(op.reg.value);
+			if (variable < 0)
+				return;
+
+			// 32 bit writes zero the upper half, 8 and 16 bit writes merge with the old value
+			if (op.size == 32)
+				value = emit(ssa_op::trunc, { value }, 32);
+			else if (op.size < 32 && variable != flags_variable)
+				value = opaque(variable);
+
+			write(variable, value);
+		}
+
+		/// @brief defines opaque values for every register an instruction writes
+		void clobber(uint64_t def_mask)
+		{
+			for (uint32_t variable = 0; variable < 16; variable++)
+			{
+				if (def_mask & (1ull << variable))
+					write(variable, opaque(variable));
+			}
+
+			if (def_mask & reg_mask_flags)
+				write(flags_variable, opaque(flags_variable));
+		}
+
+		void lift_block(const basic_block& block)
+		{
+			current_rva = block.rva_begin;
+			for (size_t i = 0; i < block.insts.size(); i++)
+			{
+				lift_inst(block.insts[i], block.regs[i]);
+				current_rva += block.insts[i].info.length;
+			}
+		}
+
+		void lift_binary(const codec::dec::inst& inst, ssa_op op)
+		{
+			const codec::dec::operand& dst = inst.operands[0];
+			const codec::dec::operand& src = inst.operands[1];
+
+			// xor and sub of a register with itself are the usual way of zeroing it
+			const bool self = dst.type == ZYDIS_OPERAND_TYPE_REGISTER && src.type == ZYDIS_OPERAND_TYPE_REGISTER &&
+				dst.reg.value == src.reg.value;
+
+			uint32_t result;
+			if (self && (op == ssa_op::xor_ || op == ssa_op::sub))
+				result = constant(0);
+			else
+				result = emit(op, { read_operand(inst, dst), read_operand(inst, src) });
+
+			write_operand(inst, dst, result);
+			write(flags_variable, result);
+		}
+
+		void lift_inst(const codec::dec::inst& inst, const inst_regs& regs)
+		{
+			const codec::dec::operand* ops = inst.operands;
+			const uint8_t visible = inst.info.operand_count_visible;
+
+			switch (inst.info.meta.category)
+			{
+				case ZYDIS_CATEGORY_COND_BR:
+					emit(ssa_op::cond_branch, { read(flags_variable, current_block) }, inst.info.mnemonic);
+					return;
+				case ZYDIS_CATEGORY_UNCOND_BR:
+					emit(ssa_op::branch, { read_operand(inst, ops[0]) });
+					return;
+				case ZYDIS_CATEGORY_RET:
+					emit(ssa_op::ret, { read(0, current_block) });
+					return;
+				case ZYDIS_CATEGORY_CALL:
+				{
+					const uint32_t result = emit(ssa_op::call, { read_operand(inst, ops[0]) });
+					clobber(abi.call_clobbers & ~1ull);
+					write(0, result);
+					return;
+				}
+				default:
+					break;
+			}
+
+			switch (inst.info.mnemonic)
+			{
+				case ZYDIS_MNEMONIC_NOP:
+					return;
+				case ZYDIS_MNEMONIC_MOV:
+					write_operand(inst, ops[0], read_operand(inst, ops[1]));
+					return;
+				case ZYDIS_MNEMONIC_MOVZX:
+					write_operand(inst, ops[0], read_operand(inst, ops[1]));
+					return;
+				case ZYDIS_MNEMONIC_MOVSXD:
+					write_operand(inst, ops[0], emit(ssa_op::sext, { read_operand(inst, ops[1]) }, ops[1].size));
+					return;
+				case ZYDIS_MNEMONIC_LEA:
+					write_operand(inst, ops[0], address(inst, ops[1]));
+					return;
+				case ZYDIS_MNEMONIC_ADD:
+					lift_binary(inst, ssa_op::add);
+					return;
+				case ZYDIS_MNEMONIC_SUB:
+					lift_binary(inst, ssa_op::sub);
+					return;
+				case ZYDIS_MNEMONIC_AND:
+					lift_binary(inst, ssa_op::and_);
+					return;
+				case ZYDIS_MNEMONIC_OR:
+					lift_binary(inst, ssa_op::or_);
+					return;
+				case ZYDIS_MNEMONIC_XOR:
+					lift_binary(inst, ssa_op::xor_);
+					return;
+				case ZYDIS_MNEMONIC_SHL:
+					lift_binary(inst, ssa_op::shl);
+					return;
+				case ZYDIS_MNEMONIC_SHR:
+					lift_binary(inst, ssa_op::shr);
+					return;
+				case ZYDIS_MNEMONIC_SAR:
+					lift_binary(inst, ssa_op::sar);
+					return;
+				case ZYDIS_MNEMONIC_IMUL:
+				{
+					if (visible == 2)
+					{
+						lift_binary(inst, ssa_op::mul);
+						return;
+					}
+
+					if (visible == 3)
+					{
+						const uint32_t result = emit(ssa_op::mul, { read_operand(inst, ops[1]), read_operand(inst, ops[2]) });
+						write_operand(inst, ops[0], result);
+						write(flags_variable, result);
+						return;
+					}
+
+					break;
+				}
+				case ZYDIS_MNEMONIC_INC:
+				case ZYDIS_MNEMONIC_DEC:
+				{
+					const ssa_op op = inst.info.mnemonic == ZYDIS_MNEMONIC_INC ? ssa_op::add : ssa_op::sub;
+					const uint32_t result = emit(op, { read_operand(inst, ops[0]), constant(1) });
+					write_operand(inst, ops[0], result);
+
+					// zf, sf, of, af and pf follow the result while cf is kept, so the new flags depend on both
+					write(flags_variable, emit(ssa_op::opaque, { result, read(flags_variable, current_block) }, 0, flags_variable));
+					return;
+				}
+				case ZYDIS_MNEMONIC_NEG:
+				case ZYDIS_MNEMONIC_NOT:
+				{
+					const ssa_op op = inst.info.mnemonic == ZYDIS_MNEMONIC_NEG ? ssa_op::neg : ssa_op::not_;
+					const uint32_t result = emit(op, { read_operand(inst, ops[0]) });
+					write_operand(inst, ops[0], result);
+					if (op == ssa_op::neg)
+						write(flags_variable, result);
+
+					return;
+				}
+				case ZYDIS_MNEMONIC_CMP:
+				case ZYDIS_MNEMONIC_TEST:
+				{
+					const ssa_op op = inst.info.mnemonic == ZYDIS_MNEMONIC_CMP ? ssa_op::compare : ssa_op::test;
+					write(flags_variable, emit(op, { read_operand(inst, ops[0]), read_operand(inst, ops[1]) }));
+					return;
+				}
+				case ZYDIS_MNEMONIC_PUSH:
+				{
+					const uint32_t value = read_operand(inst, ops[0]);
+					const uint32_t rsp = emit(ssa_op::sub, { read(4, current_block), constant(8) });
+					emit(ssa_op::store, { rsp, value }, 64);
+					write(4, rsp);
+					return;
+				}
+				case ZYDIS_MNEMONIC_POP:
+				{
+					const uint32_t rsp = read(4, current_block);
+					const uint32_t value = emit(ssa_op::load, { rsp }, 64);
+					write(4, emit(ssa_op::add, { rsp, constant(8) }));
+					write_operand(inst, ops[0], value);
+					return;
+				}
+				default:
+					break;
+			}
+
+			clobber(regs.def);
+		}
+	};
+}
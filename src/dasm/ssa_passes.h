@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+#include "dasm/ssa.h"
+
+namespace eagle::dasm
+{
+	/// @brief optimistic constant propagation over an ssa function
+	/// every value starts unknown, is evaluated in id order and the whole function is re-evaluated
+	/// until nothing changes, phis ignore operands which are still unknown so loop invariant constants survive
+	class ssa_constants
+	{
+	public:
+		explicit ssa_constants(const ssa_function& fn)
+			: states(fn.insts.size(), state::unknown), values(fn.insts.size(), 0)
+		{
+			bool changed = true;
+			while (changed)
+			{
+				changed = false;
+				for (uint32_t value = 0; value < fn.insts.size(); value++)
+				{
+					if (states[value] == state::varying)
+						continue;
+
+					const auto [new_state, new_value] = evaluate(fn, value);
+					if (new_state != states[value] || new_value != values[value])
+					{
+						states[value] = new_state;
+						values[value] = new_value;
+						changed = true;
+					}
+				}
+
+				passes++;
+			}
+		}
+
+		/// @brief checks if a value is the same constant on every path
+		bool is_constant(uint32_t value) const { return states[value] == state::constant; }
+
+		/// @brief getter for the constant of a value, only meaningful if is_constant is true
+		uint64_t value(uint32_t value) const { return values[value]; }
+
+		/// @brief getter for the amount of passes over the function until the values settled
+		uint32_t pass_count() const { return passes; }
+
+	private:
+		enum class state : uint8_t
+		{
+			unknown,
+			constant,
+			varying,
+		};
+
+		std::vector<state> states;
+		std::vector<uint64_t> values;
+		uint32_t passes = 0;
+
+		std::pair<state, uint64_t> evaluate(const ssa_function& fn, uint32_t value) const
+		{
+			const ssa_inst& inst = fn.insts[value];
+			const std::span<const uint32_t> args = fn.operands_of(value);
+
+			if (inst.op == ssa_op::constant)
+				return { state::constant, inst.imm };
+
+			if (inst.op == ssa_op::phi)
+			{
+				std::pair<state, uint64_t> result = { state::unknown, 0 };
+				for (uint32_t arg : args)
+				{
+					if (arg == no_value || states[arg] == state::unknown)
+						continue;
+
+					if (states[arg] == state::varying)
+						return { state::varying, 0 };
+
+					if (result.first == state::constant && result.second != values[arg])
+						return { state::varying, 0 };
+
+					result = { state::constant, values[arg] };
+				}
+
+				return result;
+			}
+
+			switch (inst.op)
+			{
+				case ssa_op::copy:
+				case ssa_op::trunc:
+				case ssa_op::sext:
+				case ssa_op::neg:
+				case ssa_op::not_:
+				case ssa_op::add:
+				case ssa_op::sub:
+				case ssa_op::mul:
+				case ssa_op::and_:
+				case ssa_op::or_:
+				case ssa_op::xor_:
+				case ssa_op::shl:
+				case ssa_op::shr:
+				case ssa_op::sar:
+					break;
+				default:
+					return { state::varying, 0 };
+			}
+
+			for (uint32_t arg : args)
+			{
+				if (states[arg] != state::constant)
+					return { states[arg], 0 };
+			}
+
+			const uint64_t a = args.size() > 0 ? values[args[0]] : 0;
+			const uint64_t b = args.size() > 1 ? values[args[1]] : 0;
+			const uint64_t bits = inst.imm;
+
+			switch (inst.op)
+			{
+				case ssa_op::copy:
+					return { state::constant, a };
+				case ssa_op::trunc:
+					return { state::constant, bits >= 64 ? a : a & ((1ull << bits) - 1) };
+				case ssa_op::sext:
+				{
+					if (bits == 0 || bits >= 64)
+						return { state::constant, a };
+
+					const uint64_t sign = 1ull << (bits - 1);
+					const uint64_t low = a & ((1ull << bits) - 1);
+					return { state::constant, (low ^ sign) - sign };
+				}
+				case ssa_op::neg:
+					return { state::constant, 0 - a };
+				case ssa_op::not_:
+					return { state::constant, ~a };
+				case ssa_op::add:
+					return { state::constant, a + b };
+				case ssa_op::sub:
+					return { state::constant, a - b };
+				case ssa_op::mul:
+					return { state::constant, a * b };
+				case ssa_op::and_:
+					return { state::constant, a & b };
+				case ssa_op::or_:
+					return { state::constant, a | b };
+				case ssa_op::xor_:
+					return { state::constant, a ^ b };
+				case ssa_op::shl:
+					return { state::constant, a << (b & 63) };
+				case ssa_op::shr:
+					return { state::constant, a >> (b & 63) };
+				case ssa_op::sar:
+					return { state::constant, static_cast<uint64_t>(static_cast<int64_t>(a) >> (b & 63)) };
+				default:
+					return { state::varying, 0 };
+			}
+		}
+	};
+
+	/// @brief indirect branch or call whose target folded to a constant
+	struct resolved_target
+	{
+		uint32_t rva;
+		uint64_t target;
+		ssa_op op;
+	};
+
+	/// @brief finds jumps and calls through registers whose target is a known constant
+	/// @param fn the ssa function
+	/// @param constants constant propagation results of the function
+	/// @return the resolved targets in value order
+	inline std::vector<resolved_target> resolve_indirect_targets(const ssa_function& fn, const ssa_constants& constants)
+	{
+		std::vector<resolved_target> resolved;
+		for (uint32_t value = 0; value < fn.insts.size(); value++)
+		{
+			const ssa_inst& inst = fn.insts[value];
+			if (inst.op != ssa_op::branch && inst.op != ssa_op::call)
+				continue;
+
+			// direct targets are literal constants and already known to discovery
+			const uint32_t target = fn.operands_of(value)[0];
+			if (fn.insts[target].op == ssa_op::constant || !constants.is_constant(target))
+				continue;
+
+			resolved.push_back({ inst.rva, constants.value(target), inst.op });
+		}
+
+		return resolved;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+namespace eagle::dasm
+{
+	/// @brief getter for the amount of bytes left in a stream, used to reject counts of a corrupt header before allocating
+	/// @param in the stream, its read position is left unchanged
+	/// @return the amount of bytes, nullopt if the stream cannot seek
+	inline std::optional<uint64_t> remaining_bytes(std::istream& in)
+	{
+		const std::istream::pos_type current = in.tellg();
+		if (current == std::istream::pos_type(-1))
+			return std::nullopt;
+
+		in.seekg(0, std::ios::end);
+		const std::istream::pos_type end = in.tellg();
+		in.seekg(current);
+
+		if (end == std::istream::pos_type(-1) || !in)
+			return std::nullopt;
+
+		return static_cast<uint64_t>(end - current);
+	}
+
+	/// @brief writes an array of trivially copyable values without padding, types with padding are written field by field
+	template <typename type>
+	void write_values(std::ostream& out, const std::vector<type>& values)
+	{
+		static_assert(std::has_unique_object_representations_v<type>, "the type has padding bytes");
+		out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(type));
+	}
+
+	/// @brief reads an array of trivially copyable values, the vector grows chunk by chunk so a count taken from a
+	/// corrupt header fails at the end of the stream instead of allocating the whole count up front
+	/// @param in the stream
+	/// @param values the vector the values are written to, replaced entirely
+	/// @param count the amount of values to read
+	/// @return true if every value was read
+	template <typename type>
+	bool read_values(std::istream& in, std::vector<type>& values, uint64_t count)
+	{
+		static_assert(std::has_unique_object_representations_v<type>, "the type has padding bytes");
+		constexpr uint64_t chunk = (1u << 20) / sizeof(type);
+
+		values.clear();
+		while (values.size() < count)
+		{
+			const size_t first = values.size();
+			values.resize(first + std::min(chunk, count - first));
+
+			if (!in.read(reinterpret_cast<char*>(values.data() + first), (values.size() - first) * sizeof(type)))
+				return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dasm/block_index.h"
+#include "dasm/function_map.h"
+#include "dasm/pointer_scanner.h"
+#include "dasm/xref_index.h"
+
+namespace eagle::dasm
+{
+	enum class string_encoding : uint8_t
+	{
+		ascii,
+
+		/// @brief little endian utf-16 restricted to the ascii range, the form wide literals of most binaries take
+		utf16,
+	};
+
+	/// @brief null terminated run of printable characters found in data
+	struct found_string
+	{
+		uint32_t rva;
+
+		/// @brief length in characters, without the terminator
+		uint32_t length;
+
+		string_encoding encoding;
+	};
+
+	namespace detail
+	{
+		/// @brief computes bit masks over 16 bytes, bit i is set if byte i is printable or a tab, newline or carriage return
+		/// and if byte i is zero respectively
+		inline void classify_bytes(const uint8_t* bytes, uint32_t& printable, uint32_t& zero)
+		{
+#if defined(__SSE2__)
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+
+			// bytes from 0x80 up are negative as signed bytes and fail the lower bound
+			const __m128i visible = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F)));
+			const __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+				_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+
+			printable = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(visible, space)));
+			zero = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())));
+#else
+			printable = 0;
+			zero = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const uint8_t b = bytes[i];
+				if ((b >= 0x20 && b < 0x7F) || b == '\t' || b == '\n' || b == '\r')
+					printable |= 1u << i;
+				if (b == 0)
+					zero |= 1u << i;
+			}
+#endif
+		}
+	}
+
+	/// @brief finds null terminated ascii and utf-16 strings in a data section, 16 bytes are classified at a time
+	/// @param data the bytes of the section
+	/// @param rva_begin the rva of the first byte
+	/// @param min_length strings shorter than this many characters are skipped
+	/// @return the strings sorted by rva, utf-16 strings start at even rvas
+	inline std::vector<found_string> scan_strings(std::span<const uint8_t> data, uint32_t rva_begin, uint32_t min_length = 4)
+	{
+		std::vector<found_string> strings;
+
+		// both encodings are tracked in one pass, a run is the amount of characters since the last break
+		uint32_t ascii_run = 0;
+		uint32_t wide_run = 0;
+
+		auto ascii_step = [&](size_t offset, bool printable, bool zero)
+		{
+			if (printable)
+			{
+				ascii_run++;
+				return;
+			}
+
+			if (zero && ascii_run >= min_length)
+				strings.push_back({ rva_begin + static_cast<uint32_t>(offset - ascii_run), ascii_run, string_encoding::ascii });
+
+			ascii_run = 0;
+		};
+
+		// a utf-16 character is a printable byte followed by a zero byte, the terminator is two zero bytes
+		auto wide_step = [&](size_t offset, bool low_printable, bool low_zero, bool high_zero)
+		{
+			if (low_printable && high_zero)
+			{
+				wide_run++;
+				return;
+			}
+
+			if (low_zero && high_zero && wide_run >= min_length)
+				strings.push_back({ rva_begin + static_cast<uint32_t>(offset - wide_run * 2), wide_run, string_encoding::utf16 });
+
+			wide_run = 0;
+		};
+
+		size_t offset = 0;
+		for (; offset + 16 <= data.size(); offset += 16)
+		{
+			uint32_t printable = 0;
+			uint32_t zero = 0;
+			detail::classify_bytes(data.data() + offset, printable, zero);
+
+			// blocks of binary data and blocks inside of long ascii strings skip the per byte walk
+			if (ascii_run == 0 && wide_run == 0 && printable == 0)
+				continue;
+
+			if (printable == 0xFFFF && wide_run == 0)
+			{
+				ascii_run += 16;
+				continue;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const size_t at = offset + i;
+				ascii_step(at, printable >> i & 1, zero >> i & 1);
+
+				if (((rva_begin + at) & 1) == 0 && at + 1 < data.size())
+				{
+					// the high byte of the last pair lies in the next block
+					const bool high_zero = i < 15 ? zero >> (i + 1) & 1 : data[at + 1] == 0;
+					wide_step(at, printable >> i & 1, zero >> i & 1, high_zero);
+				}
+			}
+		}
+
+		for (; offset < data.size(); offset++)
+		{
+			const uint8_t b = data[offset];
+			const bool printable = (b >= 0x20 && b < 0x7F) || b == '\t' || b == '\n' || b == '\r';
+			ascii_step(offset, printable, b == 0);
+
+			if (((rva_begin + offset) & 1) == 0 && offset + 1 < data.size())
+				wide_step(offset, printable, b == 0, data[offset + 1] == 0);
+		}
+
+		std::sort(strings.begin(), strings.end(), [](const found_string& a, const found_string& b)
+		{
+			return a.rva < b.rva;
+		});
+
+		return strings;
+	}
+
+	/// @brief strings of an image linked to the functions referring to them, so finding the functions which use a
+	/// string is a lookup. a string is referenced by rip relative operands, absolute displacements and in-image
+	/// immediates pointing at its first character, see xref_builder
+	class string_index
+	{
+	public:
+		/// @brief value returned when no string matches
+		static constexpr uint32_t npos = 0xFFFFFFFF;
+
+		/// @param strings the strings found in the data sections of the image
+		/// @param sections the sections the strings were found in, used to read their text
+		/// @param xrefs references of the recovered instructions
+		/// @param blocks index over the recovered blocks
+		/// @param functions the function partition of the blocks
+		string_index(std::span<const found_string> strings, std::span<const image_section> sections,
+			const xref_index& xrefs, const block_index& blocks, const function_map& functions)
+		{
+			entries.reserve(strings.size());
+			for (const found_string& s : strings)
+			{
+				const uint32_t text_offset = static_cast<uint32_t>(text.size());
+				if (!read_text(sections, s, text))
+					continue;
+
+				entries.push_back({ s.rva, text_offset, s.length, s.encoding });
+			}
+
+			// every string gets the sorted distinct functions whose instructions refer to it
+			std::vector<uint32_t> referencing;
+			offsets.reserve(entries.size() + 1);
+			for (const entry& e : entries)
+			{
+				offsets.push_back(static_cast<uint32_t>(function_refs.size()));
+
+				referencing.clear();
+				for (const xref& ref : xrefs.refs_to(e.rva))
+				{
+					// an instruction shared by overlapping streams counts for the function of every stream
+					blocks.for_each_containing(ref.source, [&](uint32_t block)
+					{
+						const uint32_t function = functions.owner(block);
+						if (function != function_map::npos)
+							referencing.push_back(function);
+
+						return true;
+					});
+				}
+
+				std::sort(referencing.begin(), referencing.end());
+				referencing.erase(std::unique(referencing.begin(), referencing.end()), referencing.end());
+				function_refs.insert(function_refs.end(), referencing.begin(), referencing.end());
+			}
+
+			offsets.push_back(static_cast<uint32_t>(function_refs.size()));
+
+			by_text.resize(entries.size());
+			for (uint32_t i = 0; i < entries.size(); i++)
+				by_text[i] = i;
+
+			std::sort(by_text.begin(), by_text.end(), [&](uint32_t a, uint32_t b)
+			{
+				return string(a) != string(b) ? string(a) < string(b) : entries[a].rva < entries[b].rva;
+			});
+		}
+
+		/// @brief getter for the amount of strings
+		size_t size() const { return entries.size(); }
+
+		/// @brief getter for the rva of a string
+		uint32_t rva(uint32_t id) const { return entries[id].rva; }
+
+		/// @brief getter for the encoding of a string
+		string_encoding encoding(uint32_t id) const { return entries[id].encoding; }
+
+		/// @brief getter for the text of a string, utf-16 strings are narrowed to their ascii characters
+		std::string_view string(uint32_t id) const
+		{
+			return std::string_view(text).substr(entries[id].text_offset, entries[id].length);
+		}
+
+		/// @brief finds the string which starts at an rva
+		/// @return the id of the string, npos if none starts there
+		uint32_t find(uint32_t rva) const
+		{
+			auto it = std::lower_bound(entries.begin(), entries.end(), rva, [](const entry& e, uint32_t value)
+			{
+				return e.rva < value;
+			});
+
+			if (it == entries.end() || it->rva != rva)
+				return npos;
+
+			return static_cast<uint32_t>(it - entries.begin());
+		}
+
+		/// @brief finds every string with exactly this text, in either encoding
+		/// @return the ids of the strings sorted by rva
+		std::vector<uint32_t> find(std::string_view value) const
+		{
+			auto first = std::lower_bound(by_text.begin(), by_text.end(), value, [&](uint32_t id, std::string_view v)
+			{
+				return string(id) < v;
+			});
+
+			std::vector<uint32_t> result;
+			for (auto it = first; it != by_text.end() && string(*it) == value; ++it)
+				result.push_back(*it);
+
+			return result;
+		}
+
+		/// @brief finds every string containing a substring, a scan over the string text only
+		/// @return the ids of the strings sorted by rva
+		std::vector<uint32_t> find_containing(std::string_view part) const
+		{
+			std::vector<uint32_t> result;
+			for (uint32_t id = 0; id < entries.size(); id++)
+			{
+				if (string(id).find(part) != std::string_view::npos)
+					result.push_back(id);
+			}
+
+			return result;
+		}
+
+		/// @brief getter for the functions referring to a string
+		/// @return the functions in ascending order
+		std::span<const uint32_t> functions_referencing(uint32_t id) const
+		{
+			return std::span(function_refs).subspan(offsets[id], offsets[id + 1] - offsets[id]);
+		}
+
+		/// @brief finds the functions referring to any string with exactly this text
+		/// @return the distinct functions in ascending order
+		std::vector<uint32_t> functions_referencing(std::string_view value) const
+		{
+			std::vector<uint32_t> result;
+			for (uint32_t id : find(value))
+			{
+				const std::span<const uint32_t> functions = functions_referencing(id);
+				result.insert(result.end(), functions.begin(), functions.end());
+			}
+
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+			return result;
+		}
+
+	private:
+		struct entry
+		{
+			uint32_t rva;
+			uint32_t text_offset;
+			uint32_t length;
+			string_encoding encoding;
+		};
+
+		std::vector<entry> entries;
+		std::string text;
+
+		/// @brief ids ordered by text for exact lookups
+		std::vector<uint32_t> by_text;
+
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> function_refs;
+
+		/// @brief appends the characters of a string to the text pool
+		/// @return false if no section holds the whole string
+		static bool read_text(std::span<const image_section> sections, const found_string& s, std::string& out)
+		{
+			const uint32_t width = s.encoding == string_encoding::utf16 ? 2 : 1;
+			for (const image_section& section : sections)
+			{
+				if (s.rva < section.rva_begin || s.rva - section.rva_begin + static_cast<size_t>(s.length) * width > section.data.size())
+					continue;
+
+				const uint8_t* bytes = section.data.data() + (s.rva - section.rva_begin);
+				for (uint32_t i = 0; i < s.length; i++)
+					out.push_back(static_cast<char>(bytes[i * width]));
+
+				return true;
+			}
+
+			return false;
+		}
+	};
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "dasm/parallel.h"
+
+namespace eagle::dasm
+{
+	/// @brief fixed set of worker threads running submitted tasks, shared by analyses which outlive a single call
+	/// every worker owns a deque, tasks submitted from a worker go to its own deque and are taken newest first,
+	/// outside submissions are spread round robin and idle workers steal the oldest task of another worker.
+	/// tasks still queued when the pool is destroyed never run and are released with their queue, running tasks are joined
+	class thread_pool
+	{
+	public:
+		/// @param threads amount of workers, 0 uses parallel_threads()
+		explicit thread_pool(size_t threads = 0)
+		{
+			if (threads == 0)
+				threads = parallel_threads();
+
+			queues.reserve(threads);
+			for (size_t thread = 0; thread < threads; thread++)
+				queues.push_back(std::make_unique<task_queue>());
+
+			workers.reserve(threads);
+			for (size_t thread = 0; thread < threads; thread++)
+				workers.emplace_back([this, thread](std::stop_token stop) { work(thread, stop); });
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		~thread_pool()
+		{
+			for (std::jthread& worker : workers)
+				worker.request_stop();
+
+			wake.notify_all();
+		}
+
+		/// @brief queues a task, it runs on the submitting worker or whichever worker steals it first
+		void submit(std::function<void()> task)
+		{
+			const size_t target = current_pool == this
+				? current_worker
+				: next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+			// pushed before it is counted, so a worker woken by the count always finds a task to take
+			{
+				std::lock_guard lock(queues[target]->mutex);
+				queues[target]->tasks.push_back(std::move(task));
+			}
+
+			queued.fetch_add(1, std::memory_order_release);
+
+			// taking the sleep lock orders the count update before a worker re-checks it and goes to sleep
+			{
+				std::lock_guard lock(sleep_mutex);
+			}
+
+			wake.notify_one();
+		}
+
+		/// @brief getter for the amount of workers
+		size_t size() const { return workers.size(); }
+
+		/// @brief getter for the amount of tasks taken from another worker
+		uint64_t steals() const { return steal_count.load(std::memory_order_relaxed); }
+
+	private:
+		struct task_queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		static inline thread_local const thread_pool* current_pool = nullptr;
+		static inline thread_local size_t current_worker = 0;
+
+		std::vector<std::unique_ptr<task_queue>> queues;
+		// drops below zero for a moment when a worker takes a task before its submitter counted it
+		std::atomic<std::ptrdiff_t> queued = 0;
+		std::atomic<size_t> next_queue = 0;
+		std::atomic<uint64_t> steal_count = 0;
+
+		std::mutex sleep_mutex;
+		std::condition_variable_any wake;
+
+		// declared last so the workers are joined before the queues they read are destroyed
+		std::vector<std::jthread> workers;
+
+		bool take(size_t thread, std::function<void()>& task)
+		{
+			{
+				task_queue& own = *queues[thread];
+				std::lock_guard lock(own.mutex);
+				if (!own.tasks.empty())
+				{
+					task = std::move(own.tasks.back());
+					own.tasks.pop_back();
+					return true;
+				}
+			}
+
+			for (size_t offset = 1; offset < queues.size(); offset++)
+			{
+				task_queue& victim = *queues[(thread + offset) % queues.size()];
+				std::lock_guard lock(victim.mutex);
+				if (!victim.tasks.empty())
+				{
+					task = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+					steal_count.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void work(size_t thread, std::stop_token stop)
+		{
+			current_pool = this;
+			current_worker = thread;
+
+			while (!stop.stop_requested())
+			{
+				std::function<void()> task;
+				if (take(thread, task))
+				{
+					queued.fetch_sub(1, std::memory_order_relaxed);
+					task();
+					continue;
+				}
+
+				std::unique_lock lock(sleep_mutex);
+				if (!wake.wait(lock, stop, [&] { return queued.load(std::memory_order_acquire) > 0; }))
+					return;
+			}
+		}
+	};
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/inst_util.h"
+#include "dasm/stream_io.h"
+
+namespace eagle::dasm
+{
+	/// @brief reference from an instruction to an address
+	struct xref
+	{
+		uint32_t source;
+		ref_kind kind;
+	};
+
+	/// @brief sorted (target, source) reference index
+	/// targets are stored once with offsets into the source list, so a lookup is a binary search over the unique targets
+	class xref_index
+	{
+	public:
+		xref_index() = default;
+
+		/// @brief finds every instruction which refers to an address
+		/// @param target the referenced rva
+		/// @return the references sorted by source rva, empty if nothing refers to the target
+		std::span<const xref> refs_to(uint32_t target) const
+		{
+			auto it = std::lower_bound(targets.begin(), targets.end(), target);
+			if (it == targets.end() || *it != target)
+				return {};
+
+			const size_t i = it - targets.begin();
+			return std::span(refs).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+		}
+
+		/// @brief finds every referenced address in [begin, end)
+		/// @return the sorted unique targets inside of the range
+		std::span<const uint32_t> targets_in(uint32_t begin, uint32_t end) const
+		{
+			auto first = std::lower_bound(targets.begin(), targets.end(), begin);
+			auto last = std::lower_bound(first, targets.end(), end);
+
+			return std::span(targets).subspan(first - targets.begin(), last - first);
+		}
+
+		/// @brief getter for the amount of unique targets
+		size_t target_count() const { return targets.size(); }
+
+		/// @brief getter for the amount of references
+		size_t size() const { return refs.size(); }
+
+		/// @brief writes the index in its binary form, references are written as a source and a kind array
+		/// @param out the stream the index is written to
+		/// @return true if the stream accepted all of the data
+		bool save(std::ostream& out) const
+		{
+			std::vector<uint32_t> sources(refs.size());
+			std::vector<uint8_t> kinds(refs.size());
+			for (size_t i = 0; i < refs.size(); i++)
+			{
+				sources[i] = refs[i].source;
+				kinds[i] = static_cast<uint8_t>(refs[i].kind);
+			}
+
+			const std::vector<uint32_t> header = { magic, version, static_cast<uint32_t>(targets.size()), static_cast<uint32_t>(refs.size()) };
+			write_values(out, header);
+			write_values(out, targets);
+			write_values(out, offsets);
+			write_values(out, sources);
+			write_values(out, kinds);
+
+			return out.good();
+		}
+
+		/// @brief reads an index written by save
+		/// @param in the stream the index is read from
+		/// @return the index, nullopt if the data is not a valid index
+		static std::optional<xref_index> load(std::istream& in)
+		{
+			std::vector<uint32_t> header;
+			if (!read_values(in, header, 4) || header[0] != magic || header[1] != version)
+				return std::nullopt;
+
+			const uint64_t target_count = header[2];
+			const uint64_t ref_count = header[3];
+
+			const std::optional<uint64_t> left = remaining_bytes(in);
+			if (left && *left < target_count * 4 + (target_count + 1) * 4 + ref_count * 5)
+				return std::nullopt;
+
+			xref_index index;
+			std::vector<uint32_t> sources;
+			std::vector<uint8_t> kinds;
+			if (!read_values(in, index.targets, target_count) || !read_values(in, index.offsets, target_count + 1) ||
+				!read_values(in, sources, ref_count) || !read_values(in, kinds, ref_count))
+				return std::nullopt;
+
+			// lookups binary search the targets and slice the references with the offsets
+			for (size_t i = 1; i < index.targets.size(); i++)
+			{
+				if (index.targets[i - 1] >= index.targets[i])
+					return std::nullopt;
+			}
+
+			if (index.offsets.front() != 0 || index.offsets.back() != ref_count)
+				return std::nullopt;
+
+			for (size_t i = 1; i < index.offsets.size(); i++)
+			{
+				if (index.offsets[i - 1] > index.offsets[i])
+					return std::nullopt;
+			}
+
+			index.refs.resize(ref_count);
+			for (size_t i = 0; i < ref_count; i++)
+			{
+				if (kinds[i] > static_cast<uint8_t>(ref_kind::immediate))
+					return std::nullopt;
+
+				index.refs[i] = { sources[i], static_cast<ref_kind>(kinds[i]) };
+			}
+
+			return index;
+		}
+
+	private:
+		friend class xref_builder;
+
+		static constexpr uint32_t magic = 0x46455258; // XREF
+		/// @brief 2 added ref_kind::immediate
+		static constexpr uint32_t version = 2;
+
+		std::vector<uint32_t> targets;
+		std::vector<uint32_t> offsets = { 0 };
+		std::vector<xref> refs;
+	};
+
+	/// @brief collects references while blocks are decoded and turns them into an xref_index
+	class xref_builder
+	{
+	public:
+		/// @param image_base the preferred base of the image, absolute displacements are rebased with it
+		/// @param image_size the size of the mapped image, immediates inside of it are recorded, 0 skips immediates
+		explicit xref_builder(uint64_t image_base = 0, uint32_t image_size = 0)
+			: image_base(image_base), image_size(image_size)
+		{
+		}
+
+		/// @brief records the references of every instruction in a freshly decoded block
+		/// @param block the block
+		void add(const basic_block& block)
+		{
+			uint32_t rva = block.rva_begin;
+			for (const codec::dec::inst& inst : block.insts)
+			{
+				for_each_reference(inst, rva, image_base, image_size, [&](uint32_t target, ref_kind kind)
+				{
+					entries.push_back({ target, { rva, kind } });
+				});
+
+				rva += inst.info.length;
+			}
+		}
+
+		/// @brief merges the references collected by another builder, used to join per-thread builders
+		/// @param other the builder whose references are taken
+		void merge(xref_builder&& other)
+		{
+			entries.insert(entries.end(), other.entries.begin(), other.entries.end());
+			other.entries.clear();
+		}
+
+		/// @brief sorts the collected references and builds the index, the builder is empty afterwards
+		/// a source referring to a target more than once, such as an instruction decoded by two overlapping blocks,
+		/// is kept once
+		/// @return the index
+		xref_index build()
+		{
+			std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b)
+			{
+				if (a.target != b.target)
+					return a.target < b.target;
+
+				return a.ref.source != b.ref.source ? a.ref.source < b.ref.source : a.ref.kind < b.ref.kind;
+			});
+
+			entries.erase(std::unique(entries.begin(), entries.end(), [](const entry& a, const entry& b)
+			{
+				return a.target == b.target && a.ref.source == b.ref.source;
+			}), entries.end());
+
+			xref_index index;
+			index.offsets.clear();
+			index.refs.reserve(entries.size());
+			for (const entry& e : entries)
+			{
+				if (index.targets.empty() || index.targets.back() != e.target)
+				{
+					index.targets.push_back(e.target);
+					index.offsets.push_back(static_cast<uint32_t>(index.refs.size()));
+				}
+
+				index.refs.push_back(e.ref);
+			}
+
+			index.offsets.push_back(static_cast<uint32_t>(index.refs.size()));
+
+			entries.clear();
+			entries.shrink_to_fit();
+			return index;
+		}
+
+	private:
+		struct entry
+		{
+			uint32_t target;
+			xref ref;
+		};
+
+		uint64_t image_base;
+		uint32_t image_size;
+		std::vector<entry> entries;
+	};
+}
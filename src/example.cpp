@@ -1,112 +1,22 @@
 #include <cstdint>
 
-#include <tuple>
+#include <sys/resource.h>
 
+#include <fstream>
+#include <string>
 #include <vector>
 
-// #include ... other project headers
-
-namespace eagle::dasm
-{
-	struct basic_block
-	{
-		uint32_t rva_begin, uint32_t rva_end;
-		uint32_t branch_one, branch_two;
+#include "dasm/arena.h"
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/function_map.h"
+#include "dasm/hybrid_engine.h"
+#include "dasm/pointer_scanner.h"
+#include "dasm/segment_dasm.h"
+#include "dasm/string_index.h"
+#include "dasm/xref_index.h"
 
-		std::vector<codec::dec::inst> insts;
-	}
-
-	class dasm_kernel
-	{
-	protected:
-		/// @brief decodes an instruction at the current rva, the function assumes that the rva is located at a valid instruction
-		/// @return pair with [decoded instruction, instruction length] at the current rva
-		virtual std::pair<codec::dec::inst, uint8_t> decode_current() = 0;
-
-		/// @brief decodes the instruction at the current rva and returns branches
-		/// @return returns a list of rvas the instruction branches to. len(0) if none, len(1) if jmp, len(2) if conditional jump
-		virtual std::vector<uint32_t> get_branches() = 0;
-
-		/// @brief getter for the current rva
-		/// @return the current rva
-		virtual uint32_t get_current_rva();
-
-		/// @brief updates the current rva
-		/// @param rva new rva
-		/// @return old rva before replacement
-		virtual uint32_t set_current_rva(uint32_t rva);
-	};
-
-	class segment_dasm : private dasm_kernel
-	{
-	public:
-		// some kind of ctor for file data here
-		// ...
-
-		/// @brief dissasembled instructions until a branching instruction is reached at the current block
-		/// @param rva the rva at which the target block begins
-		/// @return the basic block the instructions create
-		basic_block get_block(uint32_t rva)
-		{
-			set_current_rva(rva);
-
-			basic_block block{};
-			block.rva_begin = get_current_rva();
-
-			while (does_branch() == 0)
-			{
-				auto [result, size] = decode_current();
-				block.insts.push_back(result);
-
-				block.rva_end += size;
-				set_current_rva(block.rva_end);
-			}
-
-			auto branches = get_branches();
-			block.branch_one = std::get<0>(branches);
-			block.branch_two = std::get<1>(branches);
-
-			return block;
-		}
-
-		/// @brief gets all the instructions in a certain section and disregards the flow of the instructions
-		/// @param rva_begin the rva at which the starting instruction is at
-		/// @param rva_end the inclusive rva at which the last instruction ends
-		/// @return the list of instructions which are contained within this range
-		std::vector<codec::dec::inst> dump_section(uint32_t rva_begin, uint32_t rva_end)
-		{
-			std::vector<codec::dec::inst> insts;
-
-			uint32_t rva_current = rva_begin;
-			for (int i = rva_current; i < rva_end;)
-			{
-				auto [result, size] = decode_current();
-				insts.push_back(result);
-
-				rva_current += size;
-				set_current_rva(block.rva_end);
-			}
-
-			return insts;
-		}
-
-	private:
-		uint32_t rva_begin;
-		uint32_t rva_end;
-
-		// std::pair<codec::dec::inst, uint8_t> decode_current() override{ }
-		// std::vector<uint32_t> get_branches() override { }
-
-		/// @brief getter for the current rva
-		/// @return the current rva
-		virtual uint32_t get_current_rva() override {};
-
-		/// @brief updates the current rva
-		/// @param rva new rva
-		/// @return old rva before replacement
-		virtual uint32_t set_current_rva(uint32_t rva) override {};
-	};
-}
+// #include ... other project headers
 
 int main()
 {
@@ -114,37 +24,58 @@ int main()
 	// ...
 
 	std::vec<uint8_t> bin_data = ...;
+
+	// every block and instruction container of this analysis lives in the arena and is freed with it
+	eagle::dasm::analysis_arena arena;
+
+	rusage usage_before{};
+	getrusage(RUSAGE_SELF, &usage_before);
+
 	eagle::dasm::segment_dasm dasm(bin_data);
+	dasm.set_resource(arena.resource());
 
-	std::vector<codec::dec::inst> insts = dasm.dump_section();
+	std::pmr::vector<codec::dec::inst> insts = dasm.dump_section();
 	for (auto inst : insts)
 		print(inst); // dump all the instructions for the entire section into a print
 
-	std::set<uint32_t> discovered_rvas;
-	std::vector<basic_block> blocks;
+	// recursive descent from the entry first, then the gaps it leaves are swept for code it could not reach
+	std::vector<uint32_t> entries = { start_rva };
 
-	std::dequeue<uint32> rva_queue;
-	rva_queue.push(start_rva);
+	// references are recorded while each block is still hot from decoding
+	eagle::dasm::xref_builder xrefs(image_base, image_size);
 
-	while (rva_queue.empty())
+	eagle::dasm::hybrid_engine engine(bin_data, 0, arena.resource());
+
+	// vtables and function pointer tables are named by the base relocations, their targets seed descent directly
+	const eagle::dasm::image_section sections[] = { { 0, bin_data, true }, { data_rva, data_bytes, false } };
+	eagle::dasm::pointer_scanner pointers(sections, image_base);
+	engine.add_pointer_targets(eagle::dasm::pointer_scanner::targets(pointers.from_pe_relocations(reloc_directory)));
+
+	eagle::dasm::block_list blocks = engine.run(entries, [&](const eagle::dasm::basic_block& block)
 	{
-		eagle::dasm::segment_dasm dasm(bin_data);
-		basic_block block = dasm.get_block();
-
-		auto insert_branch = [&](auto branch_rva)
-		{
-			if (branch_rva != -1)
-			{
-				if (discovered_rvas.insert(branch_rva))
-					rva_queue.push(branch_rva);
-			}
-		};
-
-		insert_branch(block.branch_one);
-		insert_branch(block.branch_two);
-
-		blocks.push_back(block);
-	}
+		xrefs.add(block);
+	});
+
+	eagle::dasm::xref_index xref_index = xrefs.build();
+
+	std::ofstream xref_file("analysis.xref", std::ios::binary);
+	xref_index.save(xref_file);
+
+	// strings of the data section linked to the functions whose instructions point at them
+	eagle::dasm::block_index block_index(blocks);
+	eagle::dasm::function_map functions(blocks, block_index, entries);
+	eagle::dasm::string_index strings(eagle::dasm::scan_strings(data_bytes, data_rva), sections, xref_index,
+		block_index, functions);
+
+	for (uint32_t function : strings.functions_referencing("invalid license"))
+		print("references the license string: " + std::to_string(functions.entry(function)));
+
+	print("covered bytes: " + std::to_string(engine.get_coverage().covered_bytes()));
+
+	// stalls are blocks whose bytes were cold, prefetching branch targets and the random access hint keep them low
+	const eagle::dasm::decode_counters& counters = engine.get_counters();
+	print("decoded blocks: " + std::to_string(counters.blocks) + " stalls: " + std::to_string(counters.stalls) +
+		" decode ns: " + std::to_string(counters.decode_ns) + " prefetches: " + std::to_string(counters.prefetches));
 
 	print("here are the discovered blocks");
 	for (auto &block : blocks)
@@ -153,4 +84,12 @@ int main()
 		for (auto inst : block.insts)
 			print(inst);
 	}
-}
\ No newline at end of file
+
+	rusage usage_after{};
+	getrusage(RUSAGE_SELF, &usage_after);
+
+	print("arena upstream allocations: " + std::to_string(arena.upstream_allocations()) +
+		" bytes: " + std::to_string(arena.upstream_bytes()));
+	print("minor page faults: " + std::to_string(usage_after.ru_minflt - usage_before.ru_minflt) +
+		" major page faults: " + std::to_string(usage_after.ru_majflt - usage_before.ru_majflt));
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/// @brief fails the test with the location and the expression if the condition does not hold
+/// unlike assert it stays active in release builds, the tests run against optimized headers as well
+#define EAGLE_CHECK(condition)                                                                      \
+	do                                                                                              \
+	{                                                                                               \
+		if (!(condition))                                                                           \
+		{                                                                                           \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);      \
+			std::exit(1);                                                                           \
+		}                                                                                           \
+	} while (false)
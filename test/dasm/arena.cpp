@@ -0,0 +1,92 @@
+#include <cstdint>
+
+#include <memory_resource>
+#include <vector>
+
+#include "dasm/arena.h"
+#include "dasm/basic_block.h"
+#include "dasm/parallel.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	// the counter sees every request which reaches it
+	counting_resource counter;
+	void* p = counter.allocate(64, 8);
+	void* q = counter.allocate(32, 16);
+	EAGLE_CHECK(counter.allocations() == 2 && counter.bytes() == 96);
+	counter.deallocate(q, 32, 16);
+	counter.deallocate(p, 64, 8);
+	EAGLE_CHECK(counter.allocations() == 2);
+
+	// blocks and their instruction vectors are carved out of a few large chunks
+	analysis_arena arena(4096);
+	{
+		block_list blocks(arena.resource());
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			basic_block block;
+			block.rva_begin = i * 0x10;
+			block.rva_end = block.rva_begin + 0x10;
+			block.insts.resize(4);
+			blocks.push_back(std::move(block));
+		}
+
+		EAGLE_CHECK(blocks.size() == 256);
+		EAGLE_CHECK(blocks[0].get_allocator().resource() == arena.resource());
+		EAGLE_CHECK(blocks[255].insts.get_allocator().resource() == arena.resource());
+		EAGLE_CHECK(blocks[255].rva_begin == 0xFF0 && blocks[255].insts.size() == 4);
+	}
+
+	const uint64_t chunks = arena.upstream_allocations();
+	EAGLE_CHECK(chunks > 0 && chunks < 32);
+	EAGLE_CHECK(arena.upstream_bytes() >= 256 * 4 * sizeof(codec::dec::inst));
+
+	// a released arena starts over from the upstream resource
+	arena.release();
+	std::pmr::vector<uint32_t> values(arena.resource());
+	values.resize(16);
+	EAGLE_CHECK(arena.upstream_allocations() > chunks);
+
+	// arenas are independent of each other
+	analysis_arena other(4096);
+	EAGLE_CHECK(other.upstream_allocations() == 0 && other.resource() != arena.resource());
+
+	// the budget tracks live bytes from every thread and remembers the peak
+	budget_resource budget(1000);
+	{
+		std::pmr::vector<uint8_t> small(600, 0, &budget);
+		EAGLE_CHECK(budget.live_bytes() == 600 && !budget.exhausted());
+
+		std::pmr::vector<uint8_t> large(600, 0, &budget);
+		EAGLE_CHECK(budget.live_bytes() == 1200 && budget.exhausted());
+	}
+
+	EAGLE_CHECK(budget.live_bytes() == 0 && budget.peak_bytes() == 1200 && !budget.exhausted());
+	EAGLE_CHECK(budget.get_budget() == 1000);
+
+	parallel_for(64, [&](size_t, size_t)
+	{
+		void* p = budget.allocate(100, 8);
+		budget.deallocate(p, 100, 8);
+	}, 4);
+
+	EAGLE_CHECK(budget.live_bytes() == 0 && budget.peak_bytes() >= 1200);
+
+	// every slot creates its arena on first use, backed by pages of the requested kind
+	node_local_arenas arenas(2, page_policy::normal, 4096);
+	EAGLE_CHECK(arenas.size() == 2 && arenas.node(0) == no_node && arenas.node(1) == no_node);
+
+	analysis_arena& first = arenas.arena(0);
+	EAGLE_CHECK(&arenas.arena(0) == &first && &arenas.arena(1) != &first);
+	{
+		std::pmr::vector<uint64_t> values(1000, 7, first.resource());
+		EAGLE_CHECK(values[999] == 7 && first.upstream_allocations() > 0);
+	}
+
+	arenas.release();
+	EAGLE_CHECK(arenas.node(0) == current_numa_node() && arenas.node(1) == current_numa_node());
+	return 0;
+}
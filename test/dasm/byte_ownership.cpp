@@ -0,0 +1,75 @@
+#include <cstdint>
+
+#include <atomic>
+#include <vector>
+
+#include "dasm/byte_ownership.h"
+#include "dasm/parallel.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	using claim_result = byte_ownership::claim_result;
+
+	{
+		byte_ownership ownership(0x1000, 0x2000);
+		EAGLE_CHECK(ownership.claim(0x1000, 5) == claim_result::claimed);
+		EAGLE_CHECK(ownership.claim(0x1000, 5) == claim_result::existing);
+		EAGLE_CHECK(ownership.owner(0x1004) == 0x1000);
+		EAGLE_CHECK(ownership.owner(0x1005) == byte_ownership::npos);
+		EAGLE_CHECK(ownership.is_inst_start(0x1000) && !ownership.is_inst_start(0x1002));
+
+		// a jump into the middle of the instruction decodes an overlapping one, the first owner keeps the bytes
+		EAGLE_CHECK(ownership.claim(0x1002, 2) == claim_result::overlap);
+		EAGLE_CHECK(ownership.owner(0x1002) == 0x1000);
+
+		const std::vector<inst_overlap> overlaps = ownership.overlaps();
+		EAGLE_CHECK(overlaps.size() == 1);
+		EAGLE_CHECK(overlaps[0].rva == 0x1002 && overlaps[0].length == 2 && overlaps[0].owner == 0x1000);
+	}
+
+	{
+		// the instruction owning the start byte keeps the bytes it took, bytes of other instructions stay with them
+		byte_ownership ownership(0x1000, 0x2000);
+		EAGLE_CHECK(ownership.claim(0x1004, 2) == claim_result::claimed);
+		EAGLE_CHECK(ownership.claim(0x1000, 6) == claim_result::overlap);
+		EAGLE_CHECK(ownership.owner(0x1000) == 0x1000 && ownership.owner(0x1003) == 0x1000);
+		EAGLE_CHECK(ownership.owner(0x1004) == 0x1004 && ownership.owner(0x1005) == 0x1004);
+		EAGLE_CHECK(ownership.is_inst_start(0x1004));
+
+		// claiming it again still reports the overlap, an instruction starting inside of it owns none of its bytes
+		EAGLE_CHECK(ownership.claim(0x1000, 6) == claim_result::overlap);
+		EAGLE_CHECK(ownership.claim(0x1002, 3) == claim_result::overlap);
+		EAGLE_CHECK(ownership.owner(0x1002) == 0x1000);
+
+		const std::vector<inst_overlap> overlaps = ownership.overlaps();
+		EAGLE_CHECK(overlaps.size() == 2);
+		EAGLE_CHECK(overlaps[0].rva == 0x1000 && overlaps[0].owner == 0x1004);
+		EAGLE_CHECK(overlaps[1].rva == 0x1002 && overlaps[1].owner == 0x1000);
+	}
+
+	{
+		// every instruction is claimed three times from many threads, exactly one claim of each wins
+		byte_ownership ownership(0, 0x10000);
+		std::atomic<size_t> claimed = 0;
+		std::atomic<size_t> existing = 0;
+		parallel_for(0x10000 / 4 * 3, [&](size_t i, size_t)
+		{
+			const claim_result result = ownership.claim(static_cast<uint32_t>(i % (0x10000 / 4)) * 4, 4);
+			if (result == claim_result::claimed)
+				claimed.fetch_add(1, std::memory_order_relaxed);
+			else if (result == claim_result::existing)
+				existing.fetch_add(1, std::memory_order_relaxed);
+		}, 4);
+
+		EAGLE_CHECK(claimed == 0x10000 / 4);
+		EAGLE_CHECK(existing == 0x10000 / 4 * 2);
+		EAGLE_CHECK(ownership.overlaps().empty());
+		for (uint32_t rva = 0; rva < 0x10000; rva++)
+			EAGLE_CHECK(ownership.owner(rva) == (rva & ~3u));
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/call_graph.h"
+#include "dasm/function_map.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	basic_block& add_block(block_list& blocks, uint32_t rva, uint32_t branch_one = no_branch, uint32_t branch_two = no_branch)
+	{
+		basic_block& block = blocks.emplace_back();
+		block.rva_begin = rva;
+		block.rva_end = rva + 0x10;
+		block.branch_one = branch_one;
+		block.branch_two = branch_two;
+		return block;
+	}
+
+	bool same(std::span<const uint32_t> nodes, std::vector<uint32_t> expected)
+	{
+		return std::vector<uint32_t>(nodes.begin(), nodes.end()) == expected;
+	}
+}
+
+int main()
+{
+	block_list blocks;
+
+	// 0x100 spans three blocks, 0x200 and 0x300 one each
+	basic_block& head = add_block(blocks, 0x100, 0x110, 0x120);
+	head.calls.push_back({ 0x104, 0x200, call_kind::direct });
+	head.calls.push_back({ 0x108, 0x200, call_kind::direct });
+	head.calls.push_back({ 0x10C, 0, call_kind::indirect });
+
+	basic_block& body = add_block(blocks, 0x110, 0x120);
+	body.calls.push_back({ 0x112, 0x300, call_kind::direct });
+	body.calls.push_back({ 0x118, 0x5000, call_kind::slot });
+	add_block(blocks, 0x120);
+
+	basic_block& callee = add_block(blocks, 0x200);
+	callee.calls.push_back({ 0x202, 0x300, call_kind::direct });
+	callee.calls.push_back({ 0x206, 0x5000, call_kind::slot });
+	callee.calls.push_back({ 0x20A, 0x4000, call_kind::slot });
+	callee.calls.push_back({ 0x20E, 0x9999, call_kind::direct });
+
+	add_block(blocks, 0x300);
+
+	// a block no function reaches contributes no edges
+	add_block(blocks, 0x400).calls.push_back({ 0x404, 0x100, call_kind::direct });
+
+	const block_index index(blocks);
+	const uint32_t entries[] = { 0x100, 0x200, 0x300 };
+	const function_map functions(blocks, index, entries);
+	const uint32_t f100 = functions.find(0x100);
+	const uint32_t f200 = functions.find(0x200);
+	const uint32_t f300 = functions.find(0x300);
+
+	for (size_t threads : { 1, 4 })
+	{
+		const call_graph graph(blocks, functions, threads);
+
+		// slots become nodes after the functions in rva order, calls to unknown targets and indirect calls are dropped
+		EAGLE_CHECK(graph.size() == 5 && graph.edge_count() == 6);
+		EAGLE_CHECK(!graph.is_slot(f300) && graph.is_slot(3) && graph.is_slot(4));
+		EAGLE_CHECK(graph.slot_rva(3) == 0x4000 && graph.slot_rva(4) == 0x5000);
+
+		// repeated calls collapse into one edge, the lists are sorted
+		EAGLE_CHECK(same(graph.callees(f100), { f200, f300, 4 }));
+		EAGLE_CHECK(same(graph.callees(f200), { f300, 3, 4 }));
+		EAGLE_CHECK(graph.callees(f300).empty() && graph.callees(4).empty());
+
+		EAGLE_CHECK(graph.callers(f100).empty());
+		EAGLE_CHECK(same(graph.callers(f200), { f100 }));
+		EAGLE_CHECK(same(graph.callers(f300), { f100, f200 }));
+		EAGLE_CHECK(same(graph.callers(3), { f200 }));
+		EAGLE_CHECK(same(graph.callers(4), { f100, f200 }));
+	}
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include <cstdint>
+
+#include "dasm/basic_block.h"
+#include "dasm/discovery_scheduler.h"
+#include "dasm/rva_set.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	rva_set discovered(0, 0x1000);
+	discovery_scheduler scheduler(discovered);
+	auto anywhere = [](uint32_t) { return true; };
+
+	EAGLE_CHECK(scheduler.push(0x10, discovery_priority::branch));
+	EAGLE_CHECK(scheduler.push(0x20, discovery_priority::call));
+	EAGLE_CHECK(scheduler.push(0x30, discovery_priority::speculative));
+	EAGLE_CHECK(scheduler.pending() == 3);
+
+	// a queued rva is not queued twice at the same or a less urgent level
+	EAGLE_CHECK(!scheduler.push(0x10, discovery_priority::speculative));
+
+	// a request promotes a waiting rva ahead of everything else
+	scheduler.request(0x30);
+
+	const auto first = scheduler.pop();
+	EAGLE_CHECK(first && first->rva == 0x30 && first->priority == discovery_priority::request);
+
+	// targets of a requested block inherit its priority and overtake older work
+	basic_block block;
+	block.branch_one = 0x40;
+	block.branch_two = 0x20;
+	scheduler.push_successors(block, first->priority, anywhere);
+	scheduler.complete();
+
+	const auto second = scheduler.pop();
+	EAGLE_CHECK(second && second->rva == 0x40 && second->priority == discovery_priority::request);
+	scheduler.complete();
+
+	const auto third = scheduler.pop();
+	EAGLE_CHECK(third && third->rva == 0x20 && third->priority == discovery_priority::request);
+	scheduler.complete();
+
+	const auto fourth = scheduler.pop();
+	EAGLE_CHECK(fourth && fourth->rva == 0x10 && fourth->priority == discovery_priority::branch);
+	scheduler.complete();
+
+	EAGLE_CHECK(!scheduler.pop());
+	EAGLE_CHECK(scheduler.idle() && scheduler.pending() == 0);
+
+	// decoded rvas are never queued again, not even by a request
+	EAGLE_CHECK(!scheduler.push(0x10, discovery_priority::request));
+	scheduler.request(0x20);
+	EAGLE_CHECK(!scheduler.pop() && scheduler.idle());
+
+	// successors outside of the segment are filtered
+	basic_block outside;
+	outside.branch_one = 0x5000;
+	scheduler.push_successors(outside, discovery_priority::branch, [](uint32_t rva) { return rva < 0x1000; });
+	EAGLE_CHECK(!scheduler.pop());
+
+	// bulk pushes skip rvas which were discovered before
+	const uint32_t targets[] = { 0x10, 0x50, 0x60 };
+	EAGLE_CHECK(scheduler.push_all(targets, discovery_priority::pointer) == 2);
+	EAGLE_CHECK(scheduler.pending() == 2);
+	return 0;
+}
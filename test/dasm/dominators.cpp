@@ -0,0 +1,97 @@
+#include <cstdint>
+
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/dominators.h"
+#include "dasm/function_cfg.h"
+#include "dasm/function_map.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	void add_block(block_list& blocks, uint32_t rva, uint32_t branch_one = no_branch, uint32_t branch_two = no_branch)
+	{
+		basic_block& block = blocks.emplace_back();
+		block.rva_begin = rva;
+		block.rva_end = rva + 0x10;
+		block.branch_one = branch_one;
+		block.branch_two = branch_two;
+	}
+}
+
+int main()
+{
+	block_list blocks;
+
+	// 0x10 enters an outer loop at 0x20 which contains the self loop 0x30, 0x40 latches the outer loop
+	add_block(blocks, 0x10, 0x20);
+	add_block(blocks, 0x20, 0x30);
+	add_block(blocks, 0x30, 0x30, 0x40);
+	add_block(blocks, 0x40, 0x20, 0x50);
+	add_block(blocks, 0x50);
+
+	// 0x110 and 0x120 branch into each other and are both entered from 0x100, an irreducible region
+	add_block(blocks, 0x100, 0x110, 0x120);
+	add_block(blocks, 0x110, 0x120, 0x130);
+	add_block(blocks, 0x120, 0x110);
+	add_block(blocks, 0x130);
+
+	const block_index index(blocks);
+	const uint32_t entries[] = { 0x10, 0x100 };
+	const function_map functions(blocks, index, entries);
+	EAGLE_CHECK(functions.size() == 2);
+
+	const function_cfg cfg(blocks, index, functions, 0);
+	EAGLE_CHECK(cfg.size() == 5 && blocks[cfg.block(0)].rva_begin == 0x10);
+
+	auto local = [&](uint32_t rva)
+	{
+		for (uint32_t id = 0; id < cfg.size(); id++)
+		{
+			if (blocks[cfg.block(id)].rva_begin == rva)
+				return id;
+		}
+
+		return dominator_tree::npos;
+	};
+
+	const dominator_tree tree(cfg);
+	EAGLE_CHECK(tree.idom(0) == dominator_tree::npos);
+	EAGLE_CHECK(tree.idom(local(0x20)) == 0 && tree.idom(local(0x30)) == local(0x20));
+	EAGLE_CHECK(tree.idom(local(0x40)) == local(0x30) && tree.idom(local(0x50)) == local(0x40));
+	EAGLE_CHECK(tree.dominates(local(0x20), local(0x50)) && tree.dominates(local(0x30), local(0x30)));
+	EAGLE_CHECK(!tree.dominates(local(0x50), local(0x40)) && !tree.dominates(local(0x40), local(0x30)));
+	EAGLE_CHECK(tree.children(local(0x30)).size() == 1 && tree.children(local(0x30))[0] == local(0x40));
+	EAGLE_CHECK(tree.reverse_postorder().size() == 5 && tree.reverse_postorder()[0] == 0);
+
+	// the self loop nests inside of the outer loop
+	const loop_forest forest(cfg, tree);
+	EAGLE_CHECK(forest.size() == 2);
+
+	const uint32_t outer = forest.loop_of(local(0x20));
+	const uint32_t inner = forest.loop_of(local(0x30));
+	EAGLE_CHECK(outer != inner && forest.header(outer) == local(0x20) && forest.header(inner) == local(0x30));
+	EAGLE_CHECK(forest.parent(outer) == loop_forest::npos && forest.parent(inner) == outer);
+	EAGLE_CHECK(forest.depth(outer) == 1 && forest.depth(inner) == 2);
+	EAGLE_CHECK(forest.blocks(outer).size() == 3 && forest.blocks(inner).size() == 1);
+	EAGLE_CHECK(forest.loop_of(local(0x40)) == outer && forest.block_depth(local(0x40)) == 1);
+	EAGLE_CHECK(forest.loop_of(0) == loop_forest::npos && forest.block_depth(local(0x50)) == 0);
+
+	// every function at once, flattened onto block list positions
+	const loop_nesting nesting(blocks, index, functions, 2);
+	EAGLE_CHECK(nesting.loop_count(0) == 2 && nesting.loop_count(1) == 0);
+	EAGLE_CHECK(nesting.idom(index.find(0x10)) == loop_nesting::npos);
+	EAGLE_CHECK(nesting.idom(index.find(0x50)) == index.find(0x40));
+	EAGLE_CHECK(nesting.loop_header(index.find(0x40)) == index.find(0x20) && nesting.loop_depth(index.find(0x30)) == 2);
+
+	// neither block of the irreducible region dominates the other, so it forms no loop
+	EAGLE_CHECK(nesting.idom(index.find(0x110)) == index.find(0x100));
+	EAGLE_CHECK(nesting.idom(index.find(0x120)) == index.find(0x100));
+	EAGLE_CHECK(nesting.idom(index.find(0x130)) == index.find(0x110));
+	EAGLE_CHECK(nesting.loop_header(index.find(0x110)) == loop_nesting::npos && nesting.loop_depth(index.find(0x120)) == 0);
+	return 0;
+}
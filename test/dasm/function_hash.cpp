@@ -0,0 +1,149 @@
+#include <cstdint>
+
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dasm/block_index.h"
+#include "dasm/function_hash.h"
+#include "dasm/function_map.h"
+#include "dasm/segment_dasm.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	/// @brief decodes the blocks reachable from an entry and hashes the function starting there
+	uint64_t hash_function(const std::vector<uint8_t>& code, uint32_t rva_begin, uint32_t entry)
+	{
+		segment_dasm dasm(code, rva_begin);
+
+		block_list blocks;
+		std::vector<uint32_t> work = { entry };
+		while (!work.empty())
+		{
+			const uint32_t rva = work.back();
+			work.pop_back();
+
+			bool seen = false;
+			for (const basic_block& block : blocks)
+				seen |= block.rva_begin == rva;
+
+			if (seen)
+				continue;
+
+			blocks.push_back(dasm.get_block(rva));
+			for (uint32_t branch : { blocks.back().branch_one, blocks.back().branch_two })
+			{
+				if (branch != no_branch)
+					work.push_back(branch);
+			}
+		}
+
+		const block_index index(blocks);
+		const uint32_t entries[] = { entry };
+		const function_map functions(blocks, index, entries);
+		return function_hasher(code, rva_begin, 0, 0).hash(blocks, functions, functions.find(entry));
+	}
+
+	std::optional<function_cache> load(const std::string& bytes)
+	{
+		std::istringstream in(bytes);
+		return function_cache::load(in);
+	}
+
+	/// @brief hashes mov rax, [base + disp]; ret, the memory operand is filled in by hand as the test decoder lacks it
+	uint64_t hash_load(ZydisRegister base, uint8_t disp)
+	{
+		const std::vector<uint8_t> code = { 0x48, 0x8B, 0x44, 0x24, disp, 0xC3 };
+
+		block_list blocks;
+		basic_block& block = blocks.emplace_back();
+		block.rva_begin = 0x1000;
+		block.rva_end = 0x1006;
+
+		codec::dec::inst& load = block.insts.emplace_back();
+		load.info.mnemonic = ZYDIS_MNEMONIC_MOV;
+		load.info.length = 5;
+		load.info.operand_count = load.info.operand_count_visible = 2;
+		load.info.raw.disp.offset = 4;
+		load.info.raw.disp.size = 8;
+		load.operands[1].type = ZYDIS_OPERAND_TYPE_MEMORY;
+		load.operands[1].mem.base = base;
+		load.operands[1].mem.disp.has_displacement = true;
+		load.operands[1].mem.disp.value = disp;
+
+		codec::dec::inst& ret = block.insts.emplace_back();
+		ret.info.mnemonic = ZYDIS_MNEMONIC_RET;
+		ret.info.meta.category = ZYDIS_CATEGORY_RET;
+		ret.info.length = 1;
+
+		const block_index index(blocks);
+		const uint32_t entries[] = { 0x1000 };
+		const function_map functions(blocks, index, entries);
+		return function_hasher(code, 0x1000, 0, 0x10000).hash(blocks, functions, functions.find(0x1000));
+	}
+
+	void patch(std::string& bytes, size_t offset, uint64_t value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(value));
+	}
+}
+
+int main()
+{
+	// push rbp, mov rbp, rsp, jz +1, nop, pop rbp, ret, linked at two addresses with different padding in front
+	const std::vector<uint8_t> function = { 0x55, 0x48, 0x89, 0xE5, 0x74, 0x01, 0x90, 0x5D, 0xC3 };
+	std::vector<uint8_t> moved = { 0xCC, 0xCC, 0xCC };
+	moved.insert(moved.end(), function.begin(), function.end());
+
+	const uint64_t hash = hash_function(function, 0x1000, 0x1000);
+	EAGLE_CHECK(hash == hash_function(moved, 0x5000, 0x5003));
+
+	// a different branch distance changes the shape and the hash
+	std::vector<uint8_t> changed = function;
+	changed[5] = 0x00;
+	EAGLE_CHECK(hash != hash_function(changed, 0x1000, 0x1000));
+
+	// stack offsets stay part of the hash even when they fall inside of an image based at 0, rip relative ones do not
+	EAGLE_CHECK(hash_load(ZYDIS_REGISTER_RSP, 0x10) != hash_load(ZYDIS_REGISTER_RSP, 0x20));
+	EAGLE_CHECK(hash_load(ZYDIS_REGISTER_RIP, 0x10) == hash_load(ZYDIS_REGISTER_RIP, 0x20));
+
+	function_cache cache;
+	const uint8_t result[] = { 1, 2, 3 };
+	EAGLE_CHECK(cache.insert(hash, result));
+	EAGLE_CHECK(!cache.insert(hash, std::span(result, 1)));
+	EAGLE_CHECK(cache.insert(7, std::span(result, 1)));
+	EAGLE_CHECK(cache.size() == 2 && !cache.find(8));
+
+	std::ostringstream out;
+	EAGLE_CHECK(cache.save(out));
+	const std::string bytes = out.str();
+
+	const std::optional<function_cache> loaded = load(bytes);
+	EAGLE_CHECK(loaded && loaded->size() == 2);
+	EAGLE_CHECK(loaded->find(hash) == std::vector<uint8_t>({ 1, 2, 3 }));
+	EAGLE_CHECK(loaded->find(7) == std::vector<uint8_t>({ 1 }));
+
+	// the header is magic, version, entry count and pool size, then hash, offset and size per entry
+	std::string corrupt = bytes;
+	patch(corrupt, 16, UINT64_MAX / 2);
+	EAGLE_CHECK(!load(corrupt));
+
+	corrupt = bytes;
+	patch(corrupt, 24, 1ull << 40);
+	EAGLE_CHECK(!load(corrupt));
+
+	corrupt = bytes;
+	patch(corrupt, 40, UINT64_MAX);
+	EAGLE_CHECK(!load(corrupt));
+
+	EAGLE_CHECK(!load(bytes.substr(0, bytes.size() - 1)));
+
+	function_cache moved_cache(std::move(cache));
+	EAGLE_CHECK(moved_cache.size() == 2 && moved_cache.find(hash));
+	return 0;
+}
@@ -0,0 +1,129 @@
+#include <cstdint>
+
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/inst_query.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	codec::dec::inst make_inst(ZydisMnemonic mnemonic, uint8_t length)
+	{
+		codec::dec::inst inst{};
+		inst.info.mnemonic = mnemonic;
+		inst.info.length = length;
+		return inst;
+	}
+
+	void set_reg(codec::dec::inst& inst, uint8_t i, ZydisRegister reg)
+	{
+		inst.operands[i].type = ZYDIS_OPERAND_TYPE_REGISTER;
+		inst.operands[i].reg.value = reg;
+		inst.info.operand_count = inst.info.operand_count_visible = i + 1;
+	}
+
+	void set_mem(codec::dec::inst& inst, uint8_t i, ZydisRegister base, ZydisRegister index, uint8_t scale, int64_t disp)
+	{
+		inst.operands[i].type = ZYDIS_OPERAND_TYPE_MEMORY;
+		inst.operands[i].mem.base = base;
+		inst.operands[i].mem.index = index;
+		inst.operands[i].mem.scale = scale;
+		inst.operands[i].mem.disp.has_displacement = disp != 0;
+		inst.operands[i].mem.disp.value = disp;
+		inst.info.operand_count = inst.info.operand_count_visible = i + 1;
+	}
+
+	size_t count(const std::vector<query_match>& matches, uint32_t query)
+	{
+		size_t n = 0;
+		for (const query_match& match : matches)
+			n += match.query == query;
+
+		return n;
+	}
+}
+
+int main()
+{
+	// 0x1000: mov rax, [rip+0x100]; call rax; mov rax, [rip+0x100]; call rcx; mov rdx, [rax+rcx*8]
+	codec::dec::inst load = make_inst(ZYDIS_MNEMONIC_MOV, 7);
+	set_reg(load, 0, ZYDIS_REGISTER_RAX);
+	set_mem(load, 1, ZYDIS_REGISTER_RIP, ZYDIS_REGISTER_NONE, 0, 0x100);
+
+	codec::dec::inst call_rax = make_inst(ZYDIS_MNEMONIC_CALL, 2);
+	set_reg(call_rax, 0, ZYDIS_REGISTER_RAX);
+
+	codec::dec::inst call_rcx = call_rax;
+	call_rcx.operands[0].reg.value = ZYDIS_REGISTER_RCX;
+
+	codec::dec::inst indexed = make_inst(ZYDIS_MNEMONIC_MOV, 4);
+	set_reg(indexed, 0, ZYDIS_REGISTER_RDX);
+	set_mem(indexed, 1, ZYDIS_REGISTER_RAX, ZYDIS_REGISTER_RCX, 8, 0);
+
+	block_list blocks;
+	basic_block& block = blocks.emplace_back();
+	block.rva_begin = 0x1000;
+	for (const codec::dec::inst& inst : { load, call_rax, load, call_rcx, indexed })
+	{
+		block.insts.push_back(inst);
+		block.rva_end += inst.info.length;
+	}
+
+	block.rva_end += block.rva_begin;
+
+	inst_query queries;
+	const auto through_register = queries.add("mov R, [rip+X]; call R");
+	const auto any_call = queries.add("mov R, [rip+X]; call *");
+	const auto calls_rcx = queries.add("*; call rcx");
+	const auto plain = queries.add("mov *, [rax]");
+	const auto scaled = queries.add("mov *, [rax+rcx*8]");
+	const auto wrong_scale = queries.add("mov *, [rax+rcx*4]");
+	const auto index_capture = queries.add("mov *, [rax+I*S]");
+	EAGLE_CHECK(through_register && any_call && calls_rcx && plain && scaled && wrong_scale && index_capture);
+	EAGLE_CHECK(queries.size() == 7);
+
+	// malformed patterns and unknown mnemonics are rejected
+	EAGLE_CHECK(!queries.add("bogus rax"));
+	EAGLE_CHECK(!queries.add("mov rax,"));
+	EAGLE_CHECK(!queries.add("mov , rax"));
+	EAGLE_CHECK(!queries.add("mov rax,,rcx"));
+	EAGLE_CHECK(!queries.add("mov [rax+]"));
+	EAGLE_CHECK(!queries.add(" ; "));
+	EAGLE_CHECK(!queries.add("nop A, B, C, D, E"));
+	EAGLE_CHECK(queries.size() == 7);
+
+	const std::vector<query_match> matches = queries.run(blocks, 2);
+	EAGLE_CHECK(count(matches, *through_register) == 1);
+	EAGLE_CHECK(count(matches, *any_call) == 2);
+	EAGLE_CHECK(count(matches, *calls_rcx) == 1);
+	EAGLE_CHECK(count(matches, *plain) == 0);
+	EAGLE_CHECK(count(matches, *scaled) == 1);
+	EAGLE_CHECK(count(matches, *wrong_scale) == 0);
+	EAGLE_CHECK(count(matches, *index_capture) == 1);
+
+	// matches are sorted by rva and point at the first instruction, rip relative captures bind the referenced rva
+	for (size_t i = 1; i < matches.size(); i++)
+		EAGLE_CHECK(matches[i - 1].rva <= matches[i].rva);
+
+	for (const query_match& match : matches)
+	{
+		EAGLE_CHECK(match.block == 0);
+		if (match.query == *through_register)
+			EAGLE_CHECK(match.rva == 0x1000 && match.inst == 0 && match.captures[1] == 0x1107);
+
+		if (match.query == *calls_rcx)
+			EAGLE_CHECK(match.rva == 0x1009 && match.inst == 2 && match.captures[0] == 0);
+
+		if (match.query == *index_capture)
+			EAGLE_CHECK(match.rva == 0x1012 && match.captures[1] == 8);
+	}
+
+	// a single block can be matched directly
+	std::vector<query_match> direct;
+	queries.run_block(block, 7, direct);
+	EAGLE_CHECK(direct.size() == matches.size() && direct[0].block == 7);
+	return 0;
+}
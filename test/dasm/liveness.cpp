@@ -0,0 +1,100 @@
+#include <cstdint>
+
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/liveness.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	constexpr uint64_t rax = liveness_abi::gpr(0);
+	constexpr uint64_t rcx = liveness_abi::gpr(1);
+	constexpr uint64_t rdx = liveness_abi::gpr(2);
+
+	basic_block& add_block(block_list& blocks, uint32_t rva, uint32_t branch_one = no_branch, uint32_t branch_two = no_branch)
+	{
+		basic_block& block = blocks.emplace_back();
+		block.rva_begin = block.rva_end = rva;
+		block.branch_one = branch_one;
+		block.branch_two = branch_two;
+		return block;
+	}
+
+	void add_inst(basic_block& block, uint8_t length, uint64_t use, uint64_t def,
+		ZydisInstructionCategory category = ZYDIS_CATEGORY_INVALID)
+	{
+		codec::dec::inst inst{};
+		inst.runtime_address = block.rva_end;
+		inst.info.length = length;
+		inst.info.meta.category = category;
+
+		block.insts.push_back(inst);
+		block.regs.push_back({ use, def });
+		block.rva_end += length;
+	}
+}
+
+int main()
+{
+	block_list blocks;
+
+	// 0x100: mov rdx, rcx; cmp rdx, 0; jz 0x120
+	basic_block& entry = add_block(blocks, 0x100, 0x120, 0x10A);
+	add_inst(entry, 4, rcx, rdx);
+	add_inst(entry, 4, rdx, reg_mask_flags);
+	add_inst(entry, 2, reg_mask_flags, 0, ZYDIS_CATEGORY_COND_BR);
+
+	// 0x10A: mov rax, rdx; jmp 0x120
+	basic_block& fallthrough = add_block(blocks, 0x10A, 0x120);
+	add_inst(fallthrough, 4, rdx, rax);
+	add_inst(fallthrough, 2, 0, 0, ZYDIS_CATEGORY_UNCOND_BR);
+
+	// 0x120: ret
+	add_inst(add_block(blocks, 0x120), 1, 0, 0, ZYDIS_CATEGORY_RET);
+
+	// 0x200: call; ret
+	basic_block& caller = add_block(blocks, 0x200);
+	add_inst(caller, 5, 0, 0, ZYDIS_CATEGORY_CALL);
+	add_inst(caller, 1, 0, 0, ZYDIS_CATEGORY_RET);
+
+	// 0x300: jmp to a target which was never recovered
+	add_inst(add_block(blocks, 0x300, 0x999), 2, 0, 0, ZYDIS_CATEGORY_UNCOND_BR);
+
+	const block_index index(blocks);
+	const liveness_abi abi = liveness_abi::win64();
+	const liveness live(blocks, index, abi);
+
+	// returns keep the abi exit registers alive, registers written before they are read are dead
+	EAGLE_CHECK(live.live_in(2) == abi.exit_live);
+	EAGLE_CHECK(live.live_in(1) == ((abi.exit_live & ~rax) | rdx));
+	EAGLE_CHECK(live.live_out(0) == (abi.exit_live | rdx));
+	EAGLE_CHECK(live.live_in(0) == (abi.exit_live | rcx));
+
+	// positions inside of a block walk back from the end of the block
+	EAGLE_CHECK(live.live_at(0x100) == live.live_in(0));
+	EAGLE_CHECK(live.live_at(0x104) == (abi.exit_live | rdx));
+	EAGLE_CHECK(live.live_at(0x108) == (abi.exit_live | rdx | reg_mask_flags));
+	EAGLE_CHECK(live.live_at(0x101) == ~0ull);
+	EAGLE_CHECK(live.live_at(0x5000) == ~0ull);
+
+	// rsp is never free, rdx and the volatile registers nobody reads are
+	EAGLE_CHECK(live.free_at(0x100) == (rdx | liveness_abi::gpr(8) | liveness_abi::gpr(9) |
+		liveness_abi::gpr(10) | liveness_abi::gpr(11)));
+
+	// calls read the argument registers and clobber the volatile ones
+	EAGLE_CHECK(live.live_in(3) == (abi.call_uses | (abi.exit_live & ~abi.call_clobbers)));
+
+	// unresolved branches keep everything alive
+	EAGLE_CHECK(live.live_out(4) == ~0ull);
+	EAGLE_CHECK(live.steps() >= blocks.size());
+
+	// the first argument is rcx on windows and rdi on system v, which does not preserve rdi
+	const liveness sysv(blocks, index, liveness_abi::sysv());
+	EAGLE_CHECK((live.live_in(3) & rcx) && (sysv.live_in(3) & liveness_abi::gpr(7)));
+	EAGLE_CHECK(!(sysv.live_in(2) & liveness_abi::gpr(7)));
+	return 0;
+}
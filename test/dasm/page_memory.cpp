@@ -0,0 +1,55 @@
+#include <cstdint>
+
+#include <cstring>
+#include <memory_resource>
+#include <vector>
+
+#include "dasm/page_memory.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	EAGLE_CHECK(page_rounded(1, page_policy::normal) == page_size);
+	EAGLE_CHECK(page_rounded(page_size, page_policy::normal) == page_size);
+	EAGLE_CHECK(page_rounded(1, page_policy::transparent_huge) == huge_page_size);
+	EAGLE_CHECK(page_rounded(huge_page_size + 1, page_policy::explicit_huge) == 2 * huge_page_size);
+	EAGLE_CHECK(current_numa_node() >= 0);
+
+	// huge page mappings are aligned to the huge page size, whichever pages end up backing them
+	for (page_policy pages : { page_policy::normal, page_policy::transparent_huge, page_policy::explicit_huge })
+	{
+		page_resource resource({ pages, current_numa_node() });
+		EAGLE_CHECK(resource.mapped_bytes() == 0);
+
+		void* memory = resource.allocate(3 << 20, 64);
+		EAGLE_CHECK(memory != nullptr);
+		EAGLE_CHECK(resource.mapped_bytes() == page_rounded(3 << 20, pages));
+		if (pages != page_policy::normal)
+			EAGLE_CHECK(reinterpret_cast<uintptr_t>(memory) % huge_page_size == 0);
+
+		std::memset(memory, 0xAB, 3 << 20);
+		EAGLE_CHECK(static_cast<uint8_t*>(memory)[(3 << 20) - 1] == 0xAB);
+
+		resource.deallocate(memory, 3 << 20, 64);
+		EAGLE_CHECK(resource.mapped_bytes() == 0);
+	}
+
+	// the resource backs pmr containers like any other upstream
+	page_resource upstream;
+	{
+		std::pmr::monotonic_buffer_resource arena(&upstream);
+		std::pmr::vector<uint32_t> values(&arena);
+		for (uint32_t i = 0; i < 100000; i++)
+			values.push_back(i);
+
+		EAGLE_CHECK(values[99999] == 99999);
+		EAGLE_CHECK(upstream.mapped_bytes() != 0);
+	}
+
+	EAGLE_CHECK(upstream.mapped_bytes() == 0);
+	EAGLE_CHECK(upstream.is_equal(upstream) && !upstream.is_equal(page_resource()));
+	return 0;
+}
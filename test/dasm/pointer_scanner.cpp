@@ -0,0 +1,121 @@
+#include <cstdint>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "dasm/pointer_scanner.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	template <typename type>
+	void put(std::vector<uint8_t>& bytes, size_t offset, type value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(type));
+	}
+}
+
+int main()
+{
+	constexpr uint64_t base = 0x140000000;
+	std::vector<uint8_t> text(0x1000, 0xCC);
+	std::vector<uint8_t> data(0x100, 0);
+	put<uint64_t>(data, 0x10, base + 0x1010);
+	put<uint64_t>(data, 0x18, base + 0x5000);
+
+	const image_section sections[] = { { 0x1000, text, true }, { 0x3000, data, false } };
+	const pointer_scanner scanner(sections, base);
+
+	{
+		// one block for page 0x3000 with two dir64 entries and one absolute padding entry
+		std::vector<uint8_t> directory(14);
+		put<uint32_t>(directory, 0, 0x3000);
+		put<uint32_t>(directory, 4, 14);
+		put<uint16_t>(directory, 8, 0xA010);
+		put<uint16_t>(directory, 10, 0xA018);
+		put<uint16_t>(directory, 12, 0);
+
+		const std::vector<code_pointer> pointers = scanner.from_pe_relocations(directory);
+		EAGLE_CHECK(pointers.size() == 1);
+		EAGLE_CHECK(pointers[0].site == 0x3010 && pointers[0].target == 0x1010);
+	}
+
+	{
+		const std::vector<code_pointer> pointers = scanner.scan();
+		EAGLE_CHECK(pointers.size() == 1 && pointers[0].target == 0x1010);
+	}
+
+	{
+		// relative and irelative addends are read, other types are not
+		std::vector<uint8_t> table(72, 0);
+		const uint64_t types[] = { 8, 37, 6 };
+		for (size_t i = 0; i < 3; i++)
+		{
+			put<uint64_t>(table, i * 24, base + 0x3000 + i * 8);
+			put<uint64_t>(table, i * 24 + 8, types[i]);
+			put<int64_t>(table, i * 24 + 16, static_cast<int64_t>(base + 0x1100 + i));
+		}
+
+		const std::vector<code_pointer> pointers = scanner.from_elf_relocations(table);
+		EAGLE_CHECK(pointers.size() == 2);
+		EAGLE_CHECK(pointers[0].target == 0x1100 && pointers[1].target == 0x1101);
+	}
+
+	{
+		// a site, then a bitmap of the words after it and a second bitmap continuing 63 words later
+		std::vector<uint8_t> relocated(0x400, 0);
+		const uint32_t sites[] = { 0x3000, 0x3008, 0x3018, 0x3008 + 62 * 8, 0x3008 + 64 * 8 };
+		for (uint32_t site : sites)
+			put<uint64_t>(relocated, site - 0x3000, base + 0x1200);
+
+		const image_section relr_sections[] = { { 0x1000, text, true }, { 0x3000, relocated, false } };
+		const pointer_scanner relr_scanner(relr_sections, base);
+
+		std::vector<uint8_t> table(24);
+		put<uint64_t>(table, 0, base + 0x3000);
+		put<uint64_t>(table, 8, 1 | 1ull << 1 | 1ull << 3 | 1ull << 63);
+		put<uint64_t>(table, 16, 1 | 1ull << 2);
+
+		const std::vector<code_pointer> pointers = relr_scanner.from_elf_relr(table);
+		EAGLE_CHECK(pointers.size() == 5);
+		for (size_t i = 0; i < 5; i++)
+			EAGLE_CHECK(pointers[i].site == sites[i] && pointers[i].target == 0x1200);
+	}
+
+	{
+		// the bulk compare of the scan agrees with a value by value search, including both ends of the code range
+		std::vector<uint8_t> noise(0x10000);
+		std::mt19937_64 rng(5);
+		for (size_t offset = 0; offset + 8 <= noise.size(); offset += 8)
+		{
+			const uint64_t choice = rng() % 8;
+			const uint64_t value = choice < 2 ? base + 0x1000 + rng() % 0x1800 : choice == 2 ? base + 0xFFF :
+				choice == 3 ? base + 0x1FFF : rng();
+			put<uint64_t>(noise, offset, value);
+		}
+
+		const image_section noisy_sections[] = { { 0x1000, text, true }, { 0x8000, noise, false } };
+		const std::vector<code_pointer> pointers = pointer_scanner(noisy_sections, base).scan();
+
+		std::vector<code_pointer> expected;
+		for (size_t offset = 0; offset + 8 <= noise.size(); offset += 8)
+		{
+			uint64_t value = 0;
+			std::memcpy(&value, noise.data() + offset, sizeof(value));
+			if (value >= base + 0x1000 && value < base + 0x2000)
+				expected.push_back({ 0x8000 + static_cast<uint32_t>(offset), static_cast<uint32_t>(value - base) });
+		}
+
+		EAGLE_CHECK(!expected.empty() && pointers.size() == expected.size());
+		for (size_t i = 0; i < pointers.size(); i++)
+			EAGLE_CHECK(pointers[i].site == expected[i].site && pointers[i].target == expected[i].target);
+	}
+
+	const code_pointer duplicates[] = { { 0x3000, 0x1020 }, { 0x3008, 0x1010 }, { 0x3010, 0x1020 } };
+	const std::vector<uint32_t> targets = pointer_scanner::targets(duplicates);
+	EAGLE_CHECK(targets.size() == 2 && targets[0] == 0x1010 && targets[1] == 0x1020);
+	return 0;
+}
@@ -0,0 +1,42 @@
+#include <cstdint>
+
+#include <atomic>
+#include <vector>
+
+#include "dasm/parallel.h"
+#include "dasm/rva_set.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	// rvas inside of the range go to the bitmap, the others to the hash shards
+	rva_set set(0x1000, 0x2000);
+	EAGLE_CHECK(set.insert(0x1000));
+	EAGLE_CHECK(!set.insert(0x1000));
+	EAGLE_CHECK(set.insert(0x1FFF));
+	EAGLE_CHECK(set.insert(0x10));
+	EAGLE_CHECK(!set.insert(0x10));
+	EAGLE_CHECK(set.insert(0xFFFFFFF0));
+	EAGLE_CHECK(set.contains(0x1000) && set.contains(0x1FFF) && set.contains(0x10) && set.contains(0xFFFFFFF0));
+	EAGLE_CHECK(!set.contains(0x1001) && !set.contains(0x2000) && !set.contains(0x11));
+	EAGLE_CHECK(set.size() == 4);
+
+	// every rva is won by exactly one of the racing inserts
+	rva_set shared(0, 0x10000);
+	std::atomic<size_t> wins = 0;
+	parallel_for(400000, [&](size_t i, size_t)
+	{
+		if (shared.insert(static_cast<uint32_t>(i % 100000) * 7))
+			wins.fetch_add(1, std::memory_order_relaxed);
+	}, 8);
+
+	EAGLE_CHECK(wins == 100000);
+	EAGLE_CHECK(shared.size() == 100000);
+	for (uint32_t i = 0; i < 100000; i++)
+		EAGLE_CHECK(shared.contains(i * 7));
+
+	EAGLE_CHECK(!shared.contains(3));
+	return 0;
+}
@@ -0,0 +1,85 @@
+#include <cstdint>
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dasm/signature_scanner.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	{
+		signature_scanner scanner;
+		EAGLE_CHECK(!scanner.add(""));
+		EAGLE_CHECK(!scanner.add("?? ??"));
+		EAGLE_CHECK(!scanner.add("4G"));
+		EAGLE_CHECK(!scanner.add("123"));
+
+		const auto prologue = scanner.add("55 48 89 E5");
+		const auto call = scanner.add("E8 ? ? ? ? C3");
+		EAGLE_CHECK(prologue && call && scanner.size() == 2);
+		scanner.compile();
+
+		const std::vector<uint8_t> data = { 0x90, 0x55, 0x48, 0x89, 0xE5, 0xE8, 0x01, 0x02, 0x03, 0x04, 0xC3, 0x55, 0x48 };
+		const std::vector<signature_match> matches = scanner.scan(data, 0x1000);
+		EAGLE_CHECK(matches.size() == 2);
+		EAGLE_CHECK(matches[0].rva == 0x1001 && matches[0].signature == *prologue);
+		EAGLE_CHECK(matches[1].rva == 0x1005 && matches[1].signature == *call);
+	}
+
+	// many signatures take the anchor set path, every match is compared against a brute force search
+	std::mt19937 rng(7);
+	for (int round = 0; round < 20; round++)
+	{
+		signature_scanner scanner;
+		std::vector<std::vector<int>> patterns;
+		for (int i = 0; i < 1 + round * 4; i++)
+		{
+			std::vector<int> pattern;
+			std::string text;
+			const int length = 2 + static_cast<int>(rng() % 3);
+			for (int k = 0; k < length; k++)
+			{
+				const int value = k == 1 && rng() % 2 ? -1 : static_cast<int>(rng() % 256);
+				pattern.push_back(value);
+
+				char hex[4] = {};
+				std::snprintf(hex, sizeof(hex), "%02X", value);
+				text += value < 0 ? "?? " : std::string(hex) + " ";
+			}
+
+			EAGLE_CHECK(scanner.add(text));
+			patterns.push_back(pattern);
+		}
+
+		scanner.compile();
+
+		std::vector<uint8_t> data(5000);
+		for (uint8_t& byte : data)
+			byte = static_cast<uint8_t>(rng());
+
+		size_t expected = 0;
+		for (const std::vector<int>& pattern : patterns)
+		{
+			for (size_t at = 0; at + pattern.size() <= data.size(); at++)
+			{
+				bool matched = true;
+				for (size_t k = 0; k < pattern.size() && matched; k++)
+					matched = pattern[k] < 0 || data[at + k] == pattern[k];
+
+				expected += matched;
+			}
+		}
+
+		const std::vector<signature_match> matches = scanner.scan(data, 0x1000, 2);
+		EAGLE_CHECK(matches.size() == expected);
+		for (size_t i = 1; i < matches.size(); i++)
+			EAGLE_CHECK(matches[i - 1].rva <= matches[i].rva);
+	}
+
+	return 0;
+}
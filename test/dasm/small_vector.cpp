@@ -0,0 +1,57 @@
+#include <cstdint>
+
+#include <memory_resource>
+
+#include "dasm/basic_block.h"
+#include "dasm/small_vector.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	small_vector<int, 2> values;
+	EAGLE_CHECK(values.empty() && values.is_inline() && values.capacity() == 2);
+
+	values.push_back(1);
+	values.push_back(2);
+	EAGLE_CHECK(values.is_inline());
+
+	// the third element spills to the allocator and keeps the inline ones
+	values.push_back(3);
+	EAGLE_CHECK(!values.is_inline() && values.size() == 3);
+	EAGLE_CHECK(values[0] == 1 && values[1] == 2 && values.back() == 3);
+
+	for (int i = 4; i <= 100; i++)
+		values.push_back(i);
+
+	EAGLE_CHECK(values.size() == 100 && values[99] == 100);
+
+	values.resize(3);
+	EAGLE_CHECK(values.size() == 3 && values.back() == 3);
+	values.pop_back();
+	EAGLE_CHECK(values.size() == 2);
+
+	small_vector<int, 2> copy = values;
+	EAGLE_CHECK(copy.size() == 2 && copy[0] == 1 && copy[1] == 2);
+
+	small_vector<int, 2> moved = std::move(values);
+	EAGLE_CHECK(moved.size() == 2 && moved[1] == 2);
+
+	// spilled storage comes from the allocator the vector was constructed with
+	std::pmr::monotonic_buffer_resource arena;
+	small_vector<call_site, 2> calls(&arena);
+	for (uint32_t i = 0; i < 10; i++)
+		calls.push_back({ 0x1000 + i, 0x2000 + i, call_kind::direct });
+
+	EAGLE_CHECK(calls.get_allocator().resource() == &arena);
+	EAGLE_CHECK(calls.size() == 10 && calls[9].target == 0x2009);
+
+	// blocks carry their call sites along when they move between lists
+	block_list blocks(&arena);
+	basic_block block(&arena);
+	block.calls = calls;
+	blocks.push_back(std::move(block));
+	EAGLE_CHECK(blocks[0].calls.size() == 10 && blocks[0].calls[5].target == 0x2005);
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include <cstdint>
+
+#include <memory_resource>
+#include <vector>
+
+#include "dasm/basic_block.h"
+#include "dasm/block_index.h"
+#include "dasm/function_cfg.h"
+#include "dasm/function_map.h"
+#include "dasm/ssa.h"
+#include "dasm/ssa_passes.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	codec::dec::inst make_inst(ZydisMnemonic mnemonic, ZydisInstructionCategory category = ZYDIS_CATEGORY_INVALID)
+	{
+		codec::dec::inst inst{};
+		inst.info.mnemonic = mnemonic;
+		inst.info.meta.category = category;
+		inst.info.length = 4;
+		return inst;
+	}
+
+	void add_reg(codec::dec::inst& inst, ZydisRegister reg, uint8_t actions)
+	{
+		codec::dec::operand& op = inst.operands[inst.info.operand_count];
+		op.type = ZYDIS_OPERAND_TYPE_REGISTER;
+		op.reg.value = reg;
+		op.size = 64;
+		op.actions = actions;
+		inst.info.operand_count_visible = ++inst.info.operand_count;
+	}
+
+	void add_imm(codec::dec::inst& inst, int64_t value, bool relative = false)
+	{
+		codec::dec::operand& op = inst.operands[inst.info.operand_count];
+		op.type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
+		op.imm.is_relative = relative;
+		op.imm.value.s = value;
+		inst.info.operand_count_visible = ++inst.info.operand_count;
+	}
+
+	codec::dec::inst binary(ZydisMnemonic mnemonic, ZydisRegister dst, int64_t imm)
+	{
+		codec::dec::inst inst = make_inst(mnemonic);
+		add_reg(inst, dst, mnemonic == ZYDIS_MNEMONIC_MOV ? ZYDIS_OPERAND_ACTION_WRITE : ZYDIS_OPERAND_ACTION_READ | ZYDIS_OPERAND_ACTION_WRITE);
+		add_imm(inst, imm);
+		return inst;
+	}
+
+	codec::dec::inst binary(ZydisMnemonic mnemonic, ZydisRegister dst, ZydisRegister src)
+	{
+		codec::dec::inst inst = make_inst(mnemonic);
+		add_reg(inst, dst, mnemonic == ZYDIS_MNEMONIC_MOV ? ZYDIS_OPERAND_ACTION_WRITE : ZYDIS_OPERAND_ACTION_READ | ZYDIS_OPERAND_ACTION_WRITE);
+		add_reg(inst, src, ZYDIS_OPERAND_ACTION_READ);
+		return inst;
+	}
+
+	codec::dec::inst jump(int64_t offset)
+	{
+		codec::dec::inst inst = make_inst(ZYDIS_MNEMONIC_JMP, ZYDIS_CATEGORY_UNCOND_BR);
+		add_imm(inst, offset, true);
+		return inst;
+	}
+
+	void add_block(block_list& blocks, uint32_t rva, std::vector<codec::dec::inst> insts,
+		uint32_t branch_one = no_branch, uint32_t branch_two = no_branch)
+	{
+		basic_block& block = blocks.emplace_back();
+		block.rva_begin = block.rva_end = rva;
+		block.branch_one = branch_one;
+		block.branch_two = branch_two;
+		for (const codec::dec::inst& inst : insts)
+		{
+			block.insts.push_back(inst);
+			block.regs.push_back(get_inst_regs(inst));
+			block.rva_end += inst.info.length;
+		}
+	}
+}
+
+int main()
+{
+	block_list blocks;
+
+	// 0x10: mov rcx, 0x1000; jz 0x20 else 0x30
+	add_block(blocks, 0x10, { binary(ZYDIS_MNEMONIC_MOV, ZYDIS_REGISTER_RCX, 0x1000), make_inst(ZYDIS_MNEMONIC_JMP, ZYDIS_CATEGORY_COND_BR) },
+		0x20, 0x30);
+
+	// 0x20: add rcx, 0; jmp 0x40
+	add_block(blocks, 0x20, { binary(ZYDIS_MNEMONIC_ADD, ZYDIS_REGISTER_RCX, 0), jump(0x18) }, 0x40);
+
+	// 0x30: mov rdx, 5; jmp 0x40
+	add_block(blocks, 0x30, { binary(ZYDIS_MNEMONIC_MOV, ZYDIS_REGISTER_RDX, 5), jump(0x8) }, 0x40);
+
+	// 0x40: add rcx, 0x234; mov rax, rdx; xor rbx, rbx; jmp rcx
+	codec::dec::inst indirect = make_inst(ZYDIS_MNEMONIC_JMP, ZYDIS_CATEGORY_UNCOND_BR);
+	add_reg(indirect, ZYDIS_REGISTER_RCX, ZYDIS_OPERAND_ACTION_READ);
+	add_block(blocks, 0x40, { binary(ZYDIS_MNEMONIC_ADD, ZYDIS_REGISTER_RCX, 0x234), binary(ZYDIS_MNEMONIC_MOV, ZYDIS_REGISTER_RAX, ZYDIS_REGISTER_RDX),
+		binary(ZYDIS_MNEMONIC_XOR, ZYDIS_REGISTER_RBX, ZYDIS_REGISTER_RBX), indirect });
+
+	const block_index index(blocks);
+	const uint32_t entries[] = { 0x10 };
+	const function_map functions(blocks, index, entries);
+	const function_cfg cfg(blocks, index, functions, 0);
+
+	auto local = [&](uint32_t rva)
+	{
+		for (uint32_t id = 0; id < cfg.size(); id++)
+		{
+			if (blocks[cfg.block(id)].rva_begin == rva)
+				return id;
+		}
+
+		return no_value;
+	};
+
+	std::pmr::monotonic_buffer_resource arena;
+	ssa_lifter lifter(blocks, cfg);
+	const ssa_function fn = lifter.lift(&arena);
+	EAGLE_CHECK(fn.blocks.size() == 4 && fn.insts.get_allocator().resource() == &arena);
+
+	// every value is listed once, the phis and entry values ahead of the bodies
+	EAGLE_CHECK(fn.order.size() == fn.insts.size());
+
+	// rdx is read at the join, it is the entry value on one path and 5 on the other
+	const uint32_t join = local(0x40);
+	uint32_t rdx_phi = no_value;
+	uint32_t rcx_phi = no_value;
+	for (uint32_t value : fn.phis(join))
+	{
+		EAGLE_CHECK(fn.insts[value].op == ssa_op::phi && fn.operands_of(value).size() == 2);
+		for (uint32_t operand : fn.operands_of(value))
+		{
+			if (fn.insts[operand].op == ssa_op::entry && fn.insts[operand].reg == 2)
+				rdx_phi = value;
+			if (fn.insts[operand].op == ssa_op::add)
+				rcx_phi = value;
+		}
+	}
+
+	EAGLE_CHECK(fn.phis(join).size() == 2 && rdx_phi != no_value && rcx_phi != no_value);
+	EAGLE_CHECK(fn.phis(local(0x20)).empty() && fn.phis(local(0x30)).empty());
+
+	// the join body is add, mov, the zeroing xor and the indirect branch
+	const std::span<const uint32_t> body = fn.body(join);
+	EAGLE_CHECK(!body.empty() && fn.insts[body.back()].op == ssa_op::branch && fn.insts[body.back()].rva == 0x4C);
+	EAGLE_CHECK(fn.operands_of(body.back()).size() == 1);
+
+	// rcx is 0x1000 on both paths, so the indirect jump folds while rax stays unknown
+	const ssa_constants constants(fn);
+	EAGLE_CHECK(constants.is_constant(rcx_phi) && constants.value(rcx_phi) == 0x1000);
+	EAGLE_CHECK(!constants.is_constant(rdx_phi));
+	EAGLE_CHECK(constants.pass_count() >= 1);
+
+	uint32_t zero = no_value;
+	for (uint32_t value : body)
+	{
+		if (fn.insts[value].op == ssa_op::constant && fn.insts[value].imm == 0 && fn.insts[value].rva == 0x48)
+			zero = value;
+	}
+
+	EAGLE_CHECK(zero != no_value && constants.is_constant(zero));
+
+	const std::vector<resolved_target> resolved = resolve_indirect_targets(fn, constants);
+	EAGLE_CHECK(resolved.size() == 1);
+	EAGLE_CHECK(resolved[0].rva == 0x4C && resolved[0].target == 0x1234 && resolved[0].op == ssa_op::branch);
+
+	{
+		// 0x100: cmp rax, rbx; inc rcx; jz 0x110 else 0x10C
+		block_list flag_blocks;
+		codec::dec::inst inc = make_inst(ZYDIS_MNEMONIC_INC);
+		add_reg(inc, ZYDIS_REGISTER_RCX, ZYDIS_OPERAND_ACTION_READ | ZYDIS_OPERAND_ACTION_WRITE);
+		add_block(flag_blocks, 0x100, { binary(ZYDIS_MNEMONIC_CMP, ZYDIS_REGISTER_RAX, ZYDIS_REGISTER_RBX), inc,
+			make_inst(ZYDIS_MNEMONIC_JMP, ZYDIS_CATEGORY_COND_BR) }, 0x110, 0x10C);
+		add_block(flag_blocks, 0x10C, { make_inst(ZYDIS_MNEMONIC_RET, ZYDIS_CATEGORY_RET) });
+		add_block(flag_blocks, 0x110, { make_inst(ZYDIS_MNEMONIC_RET, ZYDIS_CATEGORY_RET) });
+
+		const block_index flag_index(flag_blocks);
+		const uint32_t flag_entries[] = { 0x100 };
+		const function_map flag_functions(flag_blocks, flag_index, flag_entries);
+		const function_cfg flag_cfg(flag_blocks, flag_index, flag_functions, 0);
+
+		ssa_lifter flag_lifter(flag_blocks, flag_cfg);
+		const ssa_function flag_fn = flag_lifter.lift(&arena);
+
+		// the branch reads the flags written by inc, they depend on its result and the carry left by cmp
+		uint32_t branch = no_value;
+		for (uint32_t value : flag_fn.order)
+		{
+			if (flag_fn.insts[value].op == ssa_op::cond_branch)
+				branch = value;
+		}
+
+		EAGLE_CHECK(branch != no_value && flag_fn.operands_of(branch).size() == 1);
+		const uint32_t flags = flag_fn.operands_of(branch)[0];
+		EAGLE_CHECK(flag_fn.insts[flags].op == ssa_op::opaque && flag_fn.insts[flags].reg == 16);
+		EAGLE_CHECK(flag_fn.operands_of(flags).size() == 2);
+		EAGLE_CHECK(flag_fn.insts[flag_fn.operands_of(flags)[0]].op == ssa_op::add);
+		EAGLE_CHECK(flag_fn.insts[flag_fn.operands_of(flags)[1]].op == ssa_op::compare);
+	}
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+#include <cstdint>
+
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "dasm/block_index.h"
+#include "dasm/function_map.h"
+#include "dasm/string_index.h"
+#include "dasm/xref_index.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+int main()
+{
+	std::vector<uint8_t> data(200, 0xFF);
+	auto put = [&](size_t offset, const char* text) { std::memcpy(&data[offset], text, std::strlen(text) + 1); };
+	put(3, "hello world");
+	put(40, "a string long enough to cross several blocks of sixteen bytes");
+	put(120, "abc");
+
+	const char* wide = "wide";
+	for (size_t i = 0; wide[i]; i++)
+	{
+		data[150 + i * 2] = static_cast<uint8_t>(wide[i]);
+		data[150 + i * 2 + 1] = 0;
+	}
+
+	data[158] = 0;
+	data[159] = 0;
+
+	// the last string ends in the scalar tail behind the last full block
+	put(190, "tail!");
+	data.resize(196);
+
+	const std::vector<found_string> strings = scan_strings(data, 0x2000);
+	EAGLE_CHECK(strings.size() == 4);
+	EAGLE_CHECK(strings[0].rva == 0x2003 && strings[0].length == 11 && strings[0].encoding == string_encoding::ascii);
+	EAGLE_CHECK(strings[1].rva == 0x2028 && strings[1].encoding == string_encoding::ascii);
+	EAGLE_CHECK(strings[2].rva == 0x2096 && strings[2].length == 4 && strings[2].encoding == string_encoding::utf16);
+	EAGLE_CHECK(strings[3].rva == 0x20BE && strings[3].length == 5);
+
+	// shorter strings are skipped unless the minimum length allows them
+	EAGLE_CHECK(scan_strings(data, 0x2000, 3).size() == 5);
+
+	const image_section sections[] = { { 0x2000, data, false } };
+	block_list blocks;
+	basic_block block;
+	block.rva_begin = 0x1000;
+	block.rva_end = 0x1010;
+	blocks.push_back(block);
+
+	const block_index index(blocks);
+	const uint32_t entries[] = { 0x1000 };
+	const function_map functions(blocks, index, entries);
+	const xref_index xrefs;
+
+	const string_index lookup(strings, sections, xrefs, index, functions);
+	EAGLE_CHECK(lookup.size() == 4);
+	EAGLE_CHECK(lookup.string(lookup.find(0x2003)) == "hello world");
+	EAGLE_CHECK(lookup.find(0x2004) == string_index::npos);
+
+	const std::vector<uint32_t> found = lookup.find(std::string_view("wide"));
+	EAGLE_CHECK(found.size() == 1 && lookup.encoding(found[0]) == string_encoding::utf16);
+	EAGLE_CHECK(lookup.find_containing("sixteen").size() == 1);
+	EAGLE_CHECK(lookup.functions_referencing(std::string_view("wide")).empty());
+	return 0;
+}
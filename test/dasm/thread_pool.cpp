@@ -0,0 +1,74 @@
+#include <cstdint>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include "dasm/thread_pool.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	/// @brief every task spawns two children until the depth is reached, the tree exercises stealing
+	void spawn(thread_pool& pool, int depth, std::atomic<int>& ran, std::atomic<int>& left, std::promise<void>& done)
+	{
+		ran.fetch_add(1, std::memory_order_relaxed);
+		if (depth < 12)
+		{
+			left.fetch_add(2, std::memory_order_relaxed);
+			for (int child = 0; child < 2; child++)
+				pool.submit([&pool, depth, &ran, &left, &done] { spawn(pool, depth + 1, ran, left, done); });
+		}
+
+		if (left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			done.set_value();
+	}
+}
+
+int main()
+{
+	{
+		thread_pool pool(4);
+		EAGLE_CHECK(pool.size() == 4);
+
+		std::atomic<int> ran = 0;
+		std::atomic<int> left = 1;
+		std::promise<void> done;
+		pool.submit([&] { spawn(pool, 0, ran, left, done); });
+		done.get_future().wait();
+
+		EAGLE_CHECK(ran == (1 << 13) - 1);
+	}
+
+	{
+		// tasks still queued when the pool is destroyed never run and are released with their queue
+		auto pool = std::make_unique<thread_pool>(1);
+		std::atomic<bool> release = false;
+		std::atomic<int> ran = 0;
+		auto counted = std::make_shared<int>(0);
+
+		pool->submit([&]
+		{
+			while (!release)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		});
+
+		for (int i = 0; i < 100; i++)
+			pool->submit([&ran, counted] { ran++; });
+
+		EAGLE_CHECK(counted.use_count() > 1);
+
+		std::thread destroy([&] { pool.reset(); });
+		release = true;
+		destroy.join();
+
+		EAGLE_CHECK(ran <= 100);
+		EAGLE_CHECK(counted.use_count() == 1);
+	}
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include <cstdint>
+
+#include <cstring>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dasm/segment_dasm.h"
+#include "dasm/xref_index.h"
+#include "check.h"
+
+using namespace eagle::dasm;
+
+namespace
+{
+	std::optional<xref_index> load(const std::string& bytes)
+	{
+		std::istringstream in(bytes);
+		return xref_index::load(in);
+	}
+
+	template <typename type>
+	void patch(std::string& bytes, size_t offset, type value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(type));
+	}
+}
+
+int main()
+{
+	// 0x1000: nop, call 0x100C, jmp 0x100C, ret ... 0x100C: ret
+	const std::vector<uint8_t> code = { 0x90, 0xE8, 0x06, 0x00, 0x00, 0x00, 0xEB, 0x04, 0xC3, 0x90, 0x90, 0x90, 0xC3 };
+	segment_dasm dasm(code, 0x1000);
+
+	// the call decoded by two overlapping blocks is referenced once
+	xref_builder builder;
+	builder.add(dasm.get_block(0x1000));
+	builder.add(dasm.get_block(0x1001));
+	builder.add(dasm.get_block(0x1006));
+	const xref_index index = builder.build();
+
+	const std::span<const xref> refs = index.refs_to(0x100C);
+	EAGLE_CHECK(index.target_count() == 1 && refs.size() == 2);
+	EAGLE_CHECK(refs[0].source == 0x1001 && refs[0].kind == ref_kind::call);
+	EAGLE_CHECK(refs[1].source == 0x1006 && refs[1].kind == ref_kind::branch);
+	EAGLE_CHECK(index.refs_to(0x1000).empty());
+	EAGLE_CHECK(index.targets_in(0x1000, 0x2000).size() == 1);
+
+	std::ostringstream out;
+	EAGLE_CHECK(index.save(out));
+	const std::string bytes = out.str();
+
+	const std::optional<xref_index> loaded = load(bytes);
+	EAGLE_CHECK(loaded && loaded->size() == 2 && loaded->target_count() == 1);
+	EAGLE_CHECK(loaded->refs_to(0x100C)[1].source == 0x1006 && loaded->refs_to(0x100C)[1].kind == ref_kind::branch);
+
+	std::ostringstream again;
+	EAGLE_CHECK(loaded->save(again) && again.str() == bytes);
+
+	// an empty index round trips as well
+	std::ostringstream empty;
+	EAGLE_CHECK(xref_index().save(empty));
+	const std::optional<xref_index> empty_loaded = load(empty.str());
+	EAGLE_CHECK(empty_loaded && empty_loaded->size() == 0);
+
+	// the header is magic, version, target count and reference count, then targets, offsets, sources and kinds
+	std::string corrupt = bytes;
+	patch<uint32_t>(corrupt, 4, 0);
+	EAGLE_CHECK(!load(corrupt));
+
+	corrupt = bytes;
+	patch<uint32_t>(corrupt, 8, 0xFFFFFFF0);
+	patch<uint32_t>(corrupt, 12, 0xFFFFFFF0);
+	EAGLE_CHECK(!load(corrupt));
+
+	corrupt = bytes;
+	patch<uint32_t>(corrupt, 20, 1);
+	EAGLE_CHECK(!load(corrupt));
+
+	corrupt = bytes;
+	patch<uint8_t>(corrupt, bytes.size() - 1, 0xFF);
+	EAGLE_CHECK(!load(corrupt));
+
+	EAGLE_CHECK(!load(bytes.substr(0, bytes.size() - 1)));
+	return 0;
+}